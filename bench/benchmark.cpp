@@ -0,0 +1,576 @@
+// Micro and macro benchmarks for the ray tracer.
+// Results are written as JSON (median and percentiles per benchmark) so runs
+// can be compared across versions.
+#include <SFML/Graphics.hpp>
+#include "../include/scene.hpp"
+#include "../include/renderer.hpp"
+#include "../include/raytracer.hpp"
+#include "../include/scenefile.hpp"
+#include "../include/spheresoa.hpp"
+#include "../include/utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct BenchmarkResult {
+        std::string name;
+        std::string unit;
+        long long operationsPerSample;
+        std::vector<double> samples; // Time per operation in the given unit
+    };
+    
+    struct BenchmarkConfig {
+        int samples;
+        int frameSamples;
+        std::string filter;
+        std::string outputPath;
+    };
+    
+    // Keeps results observable so the optimizer cannot drop the measured work
+    volatile float benchmarkSink = 0.0f;
+    
+    double percentile(std::vector<double> values, double p) {
+        std::sort(values.begin(), values.end());
+        double rank = p * (values.size() - 1);
+        size_t lower = static_cast<size_t>(rank);
+        size_t upper = std::min(lower + 1, values.size() - 1);
+        double fraction = rank - lower;
+        return values[lower] * (1.0 - fraction) + values[upper] * fraction;
+    }
+    
+    class BenchmarkSuite {
+    public:
+        explicit BenchmarkSuite(const BenchmarkConfig& config) : config(config) {
+        }
+        
+        // Times `operations` calls of body per sample and records the per-operation cost
+        void run(const std::string& name, const std::string& unit, int sampleCount, long long operations,
+                 const std::function<void()>& body) {
+            if (!isSelected(name)) {
+                return;
+            }
+            
+            double scale = unit == "ms" ? 1e3 : 1e9;
+            BenchmarkResult result;
+            result.name = name;
+            result.unit = unit;
+            result.operationsPerSample = operations;
+            
+            body(); // Warm-up
+            for (int i = 0; i < sampleCount; ++i) {
+                auto start = std::chrono::steady_clock::now();
+                body();
+                auto end = std::chrono::steady_clock::now();
+                double seconds = std::chrono::duration<double>(end - start).count();
+                result.samples.push_back(seconds * scale / operations);
+            }
+            
+            std::cerr << name << ": " << percentile(result.samples, 0.5) << " " << unit << "/op" << std::endl;
+            results.push_back(result);
+        }
+        
+        std::string toJson() const {
+            std::ostringstream out;
+            out << "{\n";
+            out << "  \"simd\": \"" << SphereSoA::getSimdLevelName(SphereSoA::getSimdLevel()) << "\",\n";
+            out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+            out << "  \"benchmarks\": [\n";
+            for (size_t i = 0; i < results.size(); ++i) {
+                const BenchmarkResult& r = results[i];
+                double sum = 0.0;
+                for (double s : r.samples) {
+                    sum += s;
+                }
+                out << "    {\"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "/op\""
+                    << ", \"ops_per_sample\": " << r.operationsPerSample
+                    << ", \"samples\": " << r.samples.size()
+                    << ", \"median\": " << percentile(r.samples, 0.5)
+                    << ", \"p10\": " << percentile(r.samples, 0.1)
+                    << ", \"p90\": " << percentile(r.samples, 0.9)
+                    << ", \"p99\": " << percentile(r.samples, 0.99)
+                    << ", \"min\": " << percentile(r.samples, 0.0)
+                    << ", \"max\": " << percentile(r.samples, 1.0)
+                    << ", \"mean\": " << sum / r.samples.size() << "}"
+                    << (i + 1 < results.size() ? "," : "") << "\n";
+            }
+            out << "  ]\n}\n";
+            return out.str();
+        }
+        
+        bool isSelected(const std::string& name) const {
+            return config.filter.empty() || name.find(config.filter) != std::string::npos;
+        }
+        
+        const BenchmarkConfig& getConfig() const {
+            return config;
+        }
+        
+    private:
+        BenchmarkConfig config;
+        std::vector<BenchmarkResult> results;
+    };
+    
+    std::vector<Sphere> makeRandomSpheres(int count, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> x(0.f, static_cast<float>(Utils::WINDOW_WIDTH));
+        std::uniform_real_distribution<float> y(0.f, static_cast<float>(Utils::WINDOW_HEIGHT));
+        std::uniform_real_distribution<float> radius(2.f, 12.f);
+        
+        std::vector<Sphere> spheres;
+        for (int i = 0; i < count; ++i) {
+            spheres.emplace_back(sf::Vector2f(x(rng), y(rng)), radius(rng));
+        }
+        return spheres;
+    }
+    
+    // Rays aimed at the sphere with probability hitRatio, otherwise pointed away from it
+    std::vector<Ray> makeIntersectionRays(const Sphere& sphere, float hitRatio, int count, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::uniform_real_distribution<float> angle(0.f, 2.0f * static_cast<float>(M_PI));
+        
+        std::vector<Ray> rays;
+        for (int i = 0; i < count; ++i) {
+            float a = angle(rng);
+            sf::Vector2f origin = sphere.getPosition() + sf::Vector2f(std::cos(a), std::sin(a)) * (sphere.getRadius() * 3.0f);
+            sf::Vector2f toCenter = sphere.getPosition() - origin;
+            if (unit(rng) < hitRatio) {
+                // Jitter inside the silhouette so the ray still hits
+                sf::Vector2f side(-toCenter.y, toCenter.x);
+                rays.emplace_back(origin, toCenter + side * ((unit(rng) - 0.5f) * 0.5f));
+            } else {
+                rays.emplace_back(origin, -toCenter);
+            }
+        }
+        return rays;
+    }
+    
+    void benchmarkIntersection(BenchmarkSuite& suite) {
+        Sphere sphere(sf::Vector2f(640.f, 360.f), Utils::SPHERE_RADIUS);
+        const int rayCount = 100000;
+        
+        const float hitRatios[] = { 0.0f, 0.5f, 1.0f };
+        for (float hitRatio : hitRatios) {
+            std::vector<Ray> rays = makeIntersectionRays(sphere, hitRatio, rayCount, 7);
+            std::string name = "sphere_intersect/hit_" + std::to_string(static_cast<int>(hitRatio * 100)) + "pct";
+            suite.run(name, "ns", suite.getConfig().samples, rayCount, [&]() {
+                float sum = 0.0f;
+                for (const Ray& ray : rays) {
+                    sum += sphere.intersect(ray).distance;
+                }
+                benchmarkSink = sum;
+            });
+        }
+    }
+    
+    void benchmarkRayTracer(BenchmarkSuite& suite) {
+        const int objectCounts[] = { 1, 100, 10000 };
+        const int rayCount = 20000;
+        
+        for (int objects : objectCounts) {
+            Scene scene;
+            scene.setSpherePosition(sf::Vector2f(640.f, 360.f));
+            scene.addSpheres(makeRandomSpheres(objects - 1, 11));
+            RayTracer rayTracer;
+            
+            std::mt19937 rng(3);
+            std::uniform_real_distribution<float> x(0.f, static_cast<float>(Utils::WINDOW_WIDTH));
+            std::uniform_real_distribution<float> y(0.f, static_cast<float>(Utils::WINDOW_HEIGHT));
+            std::vector<Ray> rays;
+            std::vector<sf::Vector2f> points;
+            for (int i = 0; i < rayCount; ++i) {
+                sf::Vector2f target(x(rng), y(rng));
+                rays.emplace_back(sf::Vector2f(0.f, 0.f), target);
+                points.push_back(target);
+            }
+            
+            std::string suffix = "/objects_" + std::to_string(objects);
+            suite.run("raytracer_trace_ray" + suffix, "ns", suite.getConfig().samples, rayCount, [&]() {
+                float sum = 0.0f;
+                for (const Ray& ray : rays) {
+                    sum += rayTracer.traceRay(ray, scene).r;
+                }
+                benchmarkSink = sum;
+            });
+            std::vector<LinearColor> colors(rays.size());
+            suite.run("raytracer_trace_rays" + suffix, "ns", suite.getConfig().samples, rayCount, [&]() {
+                rayTracer.traceRays(scene, rays, colors);
+                float sum = 0.0f;
+                for (const LinearColor& color : colors) {
+                    sum += color.r;
+                }
+                benchmarkSink = sum;
+            });
+            suite.run("raytracer_is_in_shadow" + suffix, "ns", suite.getConfig().samples, rayCount, [&]() {
+                int sum = 0;
+                for (const sf::Vector2f& point : points) {
+                    sum += rayTracer.isInShadow(point, scene.getLight(), scene) ? 1 : 0;
+                }
+                benchmarkSink = static_cast<float>(sum);
+            });
+            suite.run("raytracer_light_visibility" + suffix, "ns", suite.getConfig().samples, rayCount, [&]() {
+                float sum = 0.0f;
+                for (const sf::Vector2f& point : points) {
+                    sum += rayTracer.calculateLightVisibility(point, scene.getLight(), scene);
+                }
+                benchmarkSink = sum;
+            });
+        }
+    }
+    
+    void benchmark2DLighting(BenchmarkSuite& suite) {
+        Scene scene;
+        scene.setSpherePosition(sf::Vector2f(640.f, 360.f));
+        Renderer renderer;
+        
+        std::vector<sf::Vector2f> points;
+        for (int y = 0; y < Utils::WINDOW_HEIGHT; y += 4) {
+            for (int x = 0; x < Utils::WINDOW_WIDTH; x += 4) {
+                points.emplace_back(static_cast<float>(x), static_cast<float>(y));
+            }
+        }
+        
+        suite.run("renderer_is_point_in_shadow", "ns", suite.getConfig().samples, static_cast<long long>(points.size()), [&]() {
+            int sum = 0;
+            for (const sf::Vector2f& point : points) {
+                sum += renderer.isPointInShadow(point, scene.getLight(), scene.getSphere()) ? 1 : 0;
+            }
+            benchmarkSink = static_cast<float>(sum);
+        });
+        suite.run("renderer_calculate_2d_lighting", "ns", suite.getConfig().samples, static_cast<long long>(points.size()), [&]() {
+            int sum = 0;
+            for (const sf::Vector2f& point : points) {
+                sum += renderer.calculate2DLighting(point, scene.getLight(), scene.getSphere()).r;
+            }
+            benchmarkSink = static_cast<float>(sum);
+        });
+    }
+    
+    void benchmarkFrames(BenchmarkSuite& suite) {
+        struct Resolution {
+            unsigned width;
+            unsigned height;
+        };
+        const Resolution resolutions[] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+        const int objectCounts[] = { 1, 1000 };
+        
+        for (const Resolution& resolution : resolutions) {
+            for (int objects : objectCounts) {
+                Scene scene;
+                scene.setSpherePosition(sf::Vector2f(resolution.width * 0.5f, resolution.height * 0.5f));
+                scene.addSpheres(makeRandomSpheres(objects - 1, 5));
+                
+                std::string suffix = "/" + std::to_string(resolution.width) + "x" + std::to_string(resolution.height)
+                                   + "/objects_" + std::to_string(objects);
+                
+                // Full frames every sample; the incremental path is measured separately
+                Renderer rayTracingRenderer;
+                rayTracingRenderer.setResolution(resolution.width, resolution.height);
+                rayTracingRenderer.setIncrementalRendering(false);
+                rayTracingRenderer.toggleRealRayTracing();
+                suite.run("frame_raytracing" + suffix, "ms", suite.getConfig().frameSamples, 1, [&]() {
+                    rayTracingRenderer.traceFrame(scene);
+                });
+                
+                // The 2D mode only shades against the main sphere, so one object count is enough
+                if (objects == 1) {
+                    Renderer lightingRenderer;
+                    lightingRenderer.setResolution(resolution.width, resolution.height);
+                    lightingRenderer.setIncrementalRendering(false);
+                    lightingRenderer.toggle2DMode();
+                    suite.run("frame_2d" + suffix, "ms", suite.getConfig().frameSamples, 1, [&]() {
+                        lightingRenderer.traceFrame(scene);
+                    });
+                }
+            }
+        }
+    }
+    
+    void benchmarkSpecularFrames(BenchmarkSuite& suite) {
+        const unsigned width = 1280;
+        const unsigned height = 720;
+        
+        // A glass main sphere, and a third each of mirror and glass among the rest
+        std::vector<Sphere> spheres = makeRandomSpheres(999, 5);
+        for (size_t i = 0; i < spheres.size(); ++i) {
+            if (i % 3 == 1) {
+                spheres[i].setSurface(SurfaceType::MIRROR);
+            } else if (i % 3 == 2) {
+                spheres[i].setSurface(SurfaceType::GLASS);
+            }
+        }
+        Scene scene;
+        scene.setSpherePosition(sf::Vector2f(width * 0.5f, height * 0.5f));
+        scene.setSphereSurface(SurfaceType::GLASS);
+        scene.addSpheres(spheres);
+        
+        // Depth 1 traces camera rays only; deeper wavefronts add the secondary bounces
+        for (int depth : { 1, 3, 6 }) {
+            const std::string suffix = "/depth_" + std::to_string(depth) + "/objects_1000";
+            Renderer renderer;
+            renderer.setResolution(width, height);
+            renderer.setIncrementalRendering(false);
+            renderer.toggleRealRayTracing();
+            renderer.getRayTracer().setMaxDepth(depth);
+            suite.run("frame_raytracing_specular" + suffix, "ms", suite.getConfig().frameSamples, 1, [&]() {
+                renderer.traceFrame(scene);
+            });
+        }
+    }
+    
+    void benchmarkParticleFrames(BenchmarkSuite& suite) {
+        const unsigned width = 1280;
+        const unsigned height = 720;
+        
+        for (int objects : { 1000, 10000 }) {
+            const std::vector<Sphere> particles = makeRandomSpheres(objects - 1, 9);
+            std::vector<sf::Vector2f> positions(objects);
+            const std::string suffix = "/objects_" + std::to_string(objects);
+            
+            for (AccelerationStructure structure : { AccelerationStructure::BVH, AccelerationStructure::GRID }) {
+                const std::string name = structure == AccelerationStructure::GRID ? "grid" : "bvh";
+                Renderer renderer;
+                renderer.setResolution(width, height);
+                renderer.setIncrementalRendering(false);
+                renderer.toggleRealRayTracing();
+                Scene scene;
+                scene.setThreadPool(&renderer.getThreadPool());
+                scene.setAccelerationStructure(structure);
+                scene.setSpherePosition(sf::Vector2f(width * 0.5f, height * 0.5f));
+                scene.addSpheres(particles);
+                
+                // Every sphere drifts a little each frame, so the structure is rebuilt every time
+                int frame = 0;
+                auto moveParticles = [&]() {
+                    ++frame;
+                    const std::vector<Sphere>& spheres = scene.getSpheres();
+                    positions[0] = spheres[0].getPosition();
+                    for (int i = 1; i < objects; ++i) {
+                        const float phase = static_cast<float>(i) * 0.618f + static_cast<float>(frame) * 0.1f;
+                        positions[i] = particles[i - 1].getPosition() + sf::Vector2f(std::cos(phase), std::sin(phase)) * 3.0f;
+                    }
+                    scene.setSpherePositions(positions);
+                };
+                suite.run("accel_rebuild/" + name + suffix, "ms", suite.getConfig().frameSamples, 1, moveParticles);
+                suite.run("frame_particles/" + name + suffix, "ms", suite.getConfig().frameSamples, 1, [&]() {
+                    moveParticles();
+                    renderer.traceFrame(scene);
+                });
+            }
+        }
+    }
+    
+    void benchmarkSphereMove(BenchmarkSuite& suite) {
+        const unsigned width = 1280;
+        const unsigned height = 720;
+        
+        for (int objects : { 1000, 10000 }) {
+            const std::string suffix = "/objects_" + std::to_string(objects);
+            Renderer renderer;
+            renderer.setResolution(width, height);
+            renderer.setIncrementalRendering(false);
+            renderer.toggleRealRayTracing();
+            Scene scene;
+            scene.setSpherePosition(sf::Vector2f(width * 0.5f, height * 0.5f));
+            scene.addSpheres(makeRandomSpheres(objects - 1, 9));
+            
+            // Only the interactive sphere moves, sweeping across the frame like a dragged mouse
+            int frame = 0;
+            auto moveSphere = [&]() {
+                ++frame;
+                const float phase = static_cast<float>(frame) * 0.05f;
+                scene.setSpherePosition(sf::Vector2f(width * (0.5f + 0.4f * std::cos(phase)),
+                                                     height * (0.5f + 0.4f * std::sin(phase * 1.3f))));
+            };
+            suite.run("accel_update/bvh" + suffix, "ms", suite.getConfig().frameSamples, 1, moveSphere);
+            suite.run("frame_sphere_move/bvh" + suffix, "ms", suite.getConfig().frameSamples, 1, [&]() {
+                moveSphere();
+                renderer.traceFrame(scene);
+            });
+        }
+    }
+    
+    void benchmarkDebugRays(BenchmarkSuite& suite) {
+        Scene scene;
+        scene.setSpherePosition(sf::Vector2f(640.f, 360.f));
+        scene.addSpheres(makeRandomSpheres(999, 17));
+        Renderer renderer;
+        renderer.setRayDisplayMode(RayDisplayMode::BOTH);
+        
+        // Tracing the rays against the scene and filling the vertex array; the draw is one call
+        for (int rays : { Utils::MIN_DEBUG_RAYS, 10000, Utils::MAX_DEBUG_RAYS }) {
+            renderer.setDebugRayCount(rays);
+            suite.run("debug_rays/rays_" + std::to_string(rays), "ms", suite.getConfig().frameSamples, 1, [&]() {
+                renderer.buildDebugRays(scene);
+                benchmarkSink = static_cast<float>(renderer.getDebugRays().getSegmentCount());
+            });
+        }
+    }
+    
+    void benchmarkSceneLoad(BenchmarkSuite& suite) {
+        const int objects = 100000;
+        Scene source;
+        source.addSpheres(makeRandomSpheres(objects - 1, 13));
+        
+        for (bool includeBVH : { true, false }) {
+            const std::string name = includeBVH ? "stored_bvh" : "build_bvh";
+            const std::filesystem::path path = std::filesystem::temp_directory_path() / ("benchmark_" + name + ".rtscene");
+            std::string error;
+            if (!SceneFile::save(path.string(), source, includeBVH, error)) {
+                std::cerr << error << std::endl;
+                continue;
+            }
+            
+            // Opening plus everything needed before the first ray can be traced
+            Scene scene;
+            suite.run("scene_load/" + name + "/objects_" + std::to_string(objects), "ms", suite.getConfig().frameSamples, 1, [&]() {
+                if (!SceneFile::load(path.string(), scene, error)) {
+                    std::cerr << error << std::endl;
+                }
+            });
+            std::filesystem::remove(path);
+        }
+    }
+    
+    void benchmarkAdaptiveFrames(BenchmarkSuite& suite) {
+        const unsigned width = 1280;
+        const unsigned height = 720;
+        
+        for (int objects : { 1, 1000 }) {
+            Scene scene;
+            scene.setSpherePosition(sf::Vector2f(width * 0.5f, height * 0.5f));
+            scene.addSpheres(makeRandomSpheres(objects - 1, 5));
+            const std::string suffix = "/objects_" + std::to_string(objects);
+            
+            for (bool use2DMode : { false, true }) {
+                if (use2DMode && objects > 1) {
+                    continue;
+                }
+                Renderer renderer;
+                renderer.setResolution(width, height);
+                renderer.setIncrementalRendering(false);
+                renderer.setAdaptiveSampling(true);
+                if (use2DMode) {
+                    renderer.toggle2DMode();
+                } else {
+                    renderer.toggleRealRayTracing();
+                }
+                suite.run(std::string("frame_adaptive_") + (use2DMode ? "2d" : "raytracing") + suffix, "ms",
+                          suite.getConfig().frameSamples, 1, [&]() {
+                    renderer.traceFrame(scene);
+                });
+            }
+        }
+    }
+    
+    void benchmarkIncrementalFrames(BenchmarkSuite& suite) {
+        const unsigned width = 1280;
+        const unsigned height = 720;
+        const sf::Vector2f center(width * 0.5f, height * 0.5f);
+        
+        for (bool use2DMode : { false, true }) {
+            const std::string mode = use2DMode ? "2d" : "raytracing";
+            Scene scene;
+            scene.setSpherePosition(center);
+            
+            Renderer renderer;
+            renderer.setResolution(width, height);
+            if (use2DMode) {
+                renderer.toggle2DMode();
+            } else {
+                renderer.toggleRealRayTracing();
+            }
+            renderer.traceFrame(scene);
+            
+            // Nothing changed, so only the change detection runs
+            suite.run("frame_incremental_" + mode + "/static", "ms", suite.getConfig().frameSamples, 1, [&]() {
+                renderer.traceFrame(scene);
+            });
+            
+            // A small sphere move, as when following the mouse
+            int frame = 0;
+            suite.run("frame_incremental_" + mode + "/sphere_move", "ms", suite.getConfig().frameSamples, 1, [&]() {
+                scene.setSpherePosition(center + sf::Vector2f(static_cast<float>(++frame % 2) * 4.0f, 0.0f));
+                renderer.traceFrame(scene);
+            });
+        }
+    }
+    
+    void benchmarkProgressiveFrames(BenchmarkSuite& suite) {
+        const unsigned width = 1280;
+        const unsigned height = 720;
+        
+        Scene scene;
+        scene.setSpherePosition(sf::Vector2f(width * 0.5f, height * 0.5f));
+        FrameBuffer frameBuffer(width, height);
+        AccumulationBuffer accumulation;
+        accumulation.resize(width, height, Utils::RENDER_TILE_SIZE);
+        RayTracer rayTracer;
+        ThreadPool threadPool;
+        
+        // One jittered pass over every tile; converged buffers start over so
+        // each sample does the same amount of work
+        suite.run("frame_progressive_raytracing/pass", "ms", suite.getConfig().frameSamples, 1, [&]() {
+            if (!rayTracer.accumulateFrame(scene, frameBuffer, accumulation, &threadPool)) {
+                accumulation.reset();
+                rayTracer.accumulateFrame(scene, frameBuffer, accumulation, &threadPool);
+            }
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    config.samples = 30;
+    config.frameSamples = 20;
+    
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--quick") {
+            config.samples = 5;
+            config.frameSamples = 3;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            config.filter = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            config.outputPath = argv[++i];
+        } else {
+            std::cerr << "Usage: benchmark [--quick] [--filter NAME] [--output FILE.json]" << std::endl;
+            return 1;
+        }
+    }
+    
+    BenchmarkSuite suite(config);
+    benchmarkIntersection(suite);
+    benchmarkRayTracer(suite);
+    benchmark2DLighting(suite);
+    benchmarkFrames(suite);
+    benchmarkSpecularFrames(suite);
+    benchmarkParticleFrames(suite);
+    benchmarkSphereMove(suite);
+    benchmarkSceneLoad(suite);
+    benchmarkDebugRays(suite);
+    benchmarkAdaptiveFrames(suite);
+    benchmarkIncrementalFrames(suite);
+    benchmarkProgressiveFrames(suite);
+    
+    std::string json = suite.toJson();
+    if (config.outputPath.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream file(config.outputPath);
+        file << json;
+    }
+    return 0;
+}
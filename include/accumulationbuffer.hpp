@@ -0,0 +1,49 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include "framebuffer.hpp"
+#include "linearcolor.hpp"
+#include "radiancebuffer.hpp"
+
+// Running per-pixel sums of jittered samples, used to refine a static frame
+// progressively. Sample counts are kept per tile, so tiles a scene change
+// does not reach keep converging while the rest start over.
+class AccumulationBuffer {
+public:
+    AccumulationBuffer();
+    
+    // Matches the framebuffer layout; any size change resets every tile
+    void resize(unsigned width, unsigned height, int tileSize);
+    void reset();
+    void resetTile(int tileIndex);
+    
+    void addSample(unsigned x, unsigned y, const LinearColor& color, bool firstSample);
+    // Counts the pass just added to the tile and writes its average to the radiance buffer
+    void finishTile(RadianceBuffer& radiance, const Tile& tile, int tileIndex);
+    
+    int getSampleCount(int tileIndex) const;
+    int getTileCount() const;
+    int getTileSize() const;
+
+private:
+    unsigned width;
+    unsigned height;
+    int tileSize;
+    std::vector<float> sums; // RGB per pixel
+    std::vector<int> tileSamples;
+};
+
+// Sample accumulation runs once per pixel per pass, so it is kept inline.
+inline void AccumulationBuffer::addSample(unsigned x, unsigned y, const LinearColor& color, bool firstSample) {
+    float* sum = &sums[(static_cast<size_t>(y) * width + x) * 3];
+    if (firstSample) {
+        // A reset only clears the tile counts; the first pass overwrites stale sums
+        sum[0] = color.r;
+        sum[1] = color.g;
+        sum[2] = color.b;
+        return;
+    }
+    sum[0] += color.r;
+    sum[1] += color.g;
+    sum[2] += color.b;
+}
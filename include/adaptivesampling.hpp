@@ -0,0 +1,194 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include "framebuffer.hpp"
+#include "linearcolor.hpp"
+#include "radiancebuffer.hpp"
+#include "profiler.hpp"
+
+// Quadtree refinement shared by the CPU render paths. The corners of coarse
+// blocks are sampled first; a block whose corners agree on their hit/shadow
+// state and differ in colour by at most the threshold is filled by bilinear
+// interpolation, and any other block is split until single pixels are traced.
+namespace AdaptiveSampling {
+    // Coarsest block; features narrower than this can fall between its corners
+    constexpr int BLOCK_SIZE = 8;
+    constexpr int DEFAULT_THRESHOLD = 12;
+    static_assert((BLOCK_SIZE & (BLOCK_SIZE - 1)) == 0, "blocks are halved down to single pixels");
+    
+    template <typename Color>
+    struct BasicSample {
+        Color color;
+        uint32_t state; // Blocks only merge when all corners report the same state
+    };
+    // Display colours for the 2D mode, linear radiance for the ray tracer
+    typedef BasicSample<sf::Color> Sample;
+    typedef BasicSample<LinearColor> LinearSample;
+    
+    // Largest per-channel spread of the four corner colours
+    inline int colorSpread(const Sample* corners) {
+        int spread = 0;
+        const sf::Uint8 sf::Color::* channels[3] = { &sf::Color::r, &sf::Color::g, &sf::Color::b };
+        for (const sf::Uint8 sf::Color::* channel : channels) {
+            int low = corners[0].color.*channel;
+            int high = low;
+            for (int i = 1; i < 4; ++i) {
+                low = std::min(low, static_cast<int>(corners[i].color.*channel));
+                high = std::max(high, static_cast<int>(corners[i].color.*channel));
+            }
+            spread = std::max(spread, high - low);
+        }
+        return spread;
+    }
+    
+    // Same measure for linear colours, taken on the displayed (tonemapped, sRGB-encoded)
+    // values, so the threshold means the same in both modes and in dark regions as in bright ones
+    inline int colorSpread(const LinearSample* corners) {
+        Sample displayed[4];
+        for (int i = 0; i < 4; ++i) {
+            displayed[i].color = RadianceBuffer::resolveColor(corners[i].color);
+            displayed[i].state = corners[i].state;
+        }
+        return colorSpread(displayed);
+    }
+    
+    // Corners are ordered top-left, top-right, bottom-left, bottom-right
+    inline void fillBlock(FrameBuffer& frameBuffer, const Tile& tile, int x, int y, int size, const Sample* corners) {
+        const int width = std::min(size, tile.width - x);
+        const int height = std::min(size, tile.height - y);
+        
+        if (corners[0].color == corners[1].color && corners[0].color == corners[2].color
+            && corners[0].color == corners[3].color) {
+            frameBuffer.fillRect(tile.x + x, tile.y + y, width, height, corners[0].color);
+            return;
+        }
+        
+        // Fixed-point bilinear weights; sizes are powers of two, so the
+        // normalisation by size * size is a shift
+        int shift = 0;
+        while ((1 << shift) < size) {
+            ++shift;
+        }
+        shift *= 2;
+        const int rounding = 1 << (shift - 1);
+        const sf::Uint8 sf::Color::* channels[3] = { &sf::Color::r, &sf::Color::g, &sf::Color::b };
+        
+        for (int py = 0; py < height; ++py) {
+            // Left and right edge values of this row, scaled by size
+            int left[3];
+            int right[3];
+            for (int c = 0; c < 3; ++c) {
+                left[c] = corners[0].color.*channels[c] * (size - py) + corners[2].color.*channels[c] * py;
+                right[c] = corners[1].color.*channels[c] * (size - py) + corners[3].color.*channels[c] * py;
+            }
+            for (int px = 0; px < width; ++px) {
+                sf::Uint8 value[3];
+                for (int c = 0; c < 3; ++c) {
+                    value[c] = static_cast<sf::Uint8>((left[c] * (size - px) + right[c] * px + rounding) >> shift);
+                }
+                frameBuffer.setPixel(tile.x + x + px, tile.y + y + py, sf::Color(value[0], value[1], value[2]));
+            }
+        }
+    }
+    
+    inline void fillBlock(RadianceBuffer& radiance, const Tile& tile, int x, int y, int size, const LinearSample* corners) {
+        const int width = std::min(size, tile.width - x);
+        const int height = std::min(size, tile.height - y);
+        
+        if (corners[0].color == corners[1].color && corners[0].color == corners[2].color
+            && corners[0].color == corners[3].color) {
+            radiance.fillRect(tile.x + x, tile.y + y, width, height, corners[0].color);
+            return;
+        }
+        
+        const float step = 1.0f / static_cast<float>(size);
+        for (int py = 0; py < height; ++py) {
+            const float v = static_cast<float>(py) * step;
+            const LinearColor left = corners[0].color * (1.0f - v) + corners[2].color * v;
+            const LinearColor right = corners[1].color * (1.0f - v) + corners[3].color * v;
+            for (int px = 0; px < width; ++px) {
+                const float u = static_cast<float>(px) * step;
+                radiance.setPixel(tile.x + x + px, tile.y + y + py, left * (1.0f - u) + right * u);
+            }
+        }
+    }
+    
+    // sampleAt(x, y) returns the Sample (or LinearSample, matching the buffer) for
+    // the pixel at buffer position (x, y)
+    template <typename Buffer, typename SampleFunction>
+    void renderTile(Buffer& buffer, const Tile& tile, int threshold, SampleFunction sampleAt) {
+        typedef decltype(sampleAt(0, 0)) SampleType;
+        
+        // Corners are shared between neighbouring blocks, so each grid point is traced once.
+        // The grid is reused per thread so refinement does not allocate every tile.
+        const int gridWidth = ((tile.width + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE + 1;
+        const int gridHeight = ((tile.height + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE + 1;
+        thread_local std::vector<SampleType> grid;
+        thread_local std::vector<char> traced;
+        grid.resize(static_cast<size_t>(gridWidth) * gridHeight);
+        traced.assign(static_cast<size_t>(gridWidth) * gridHeight, 0);
+        uint64_t sampleCount = 0;
+        
+        auto corner = [&](int x, int y) {
+            const size_t index = static_cast<size_t>(y) * gridWidth + x;
+            if (!traced[index]) {
+                grid[index] = sampleAt(tile.x + x, tile.y + y);
+                traced[index] = 1;
+                ++sampleCount;
+            }
+            return grid[index];
+        };
+        
+        struct Block {
+            int x;
+            int y;
+            int size;
+        };
+        
+        for (int blockY = 0; blockY < tile.height; blockY += BLOCK_SIZE) {
+            for (int blockX = 0; blockX < tile.width; blockX += BLOCK_SIZE) {
+                // Depth-first; three levels of four children never exceed this
+                Block stack[16];
+                int stackSize = 0;
+                stack[stackSize++] = { blockX, blockY, BLOCK_SIZE };
+                
+                while (stackSize > 0) {
+                    const Block block = stack[--stackSize];
+                    if (block.x >= tile.width || block.y >= tile.height) {
+                        continue;
+                    }
+                    
+                    const SampleType topLeft = corner(block.x, block.y);
+                    if (block.size == 1) {
+                        buffer.setPixel(tile.x + block.x, tile.y + block.y, topLeft.color);
+                        continue;
+                    }
+                    
+                    const SampleType corners[4] = {
+                        topLeft,
+                        corner(block.x + block.size, block.y),
+                        corner(block.x, block.y + block.size),
+                        corner(block.x + block.size, block.y + block.size)
+                    };
+                    bool sameState = corners[1].state == topLeft.state && corners[2].state == topLeft.state
+                                  && corners[3].state == topLeft.state;
+                    if (sameState && colorSpread(corners) <= threshold) {
+                        fillBlock(buffer, tile, block.x, block.y, block.size, corners);
+                        continue;
+                    }
+                    
+                    const int half = block.size / 2;
+                    stack[stackSize++] = { block.x + half, block.y + half, half };
+                    stack[stackSize++] = { block.x, block.y + half, half };
+                    stack[stackSize++] = { block.x + half, block.y, half };
+                    stack[stackSize++] = { block.x, block.y, half };
+                }
+            }
+        }
+        
+        PROFILE_COUNT(ProfileCounter::PIXELS_SHADED, sampleCount);
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "ray.hpp"
+#include "sphere.hpp"
+#include "spheresoa.hpp"
+
+// Node of a 2D bounding volume hierarchy.
+// Internal nodes store the index of their first child (the second child
+// follows it directly); leaves store a range into the primitive index list.
+struct BVHNode {
+    sf::Vector2f boundsMin;
+    sf::Vector2f boundsMax;
+    int leftOrFirst;
+    int count; // 0 for internal nodes
+};
+
+// Bounding volume hierarchy over the scene spheres, built with binned SAH.
+// Traversal is iterative with an explicit stack and visits the nearer child first.
+// Leaves hold up to eight spheres, stored in leaf order in a SphereSoA so
+// each leaf is a single vectorized one-ray-against-eight-spheres test. Depth is
+// capped to fit the traversal stack; leaves at the cap may hold more spheres.
+class BVH {
+public:
+    BVH();
+    
+    void build(const std::vector<Sphere>& spheres);
+    // Traverses arrays saved from a BVH over the same spheres in place instead of
+    // building one; storage keeps them alive in every copy. Returns false (and
+    // leaves the BVH unchanged) when the nodes do not form a traversable tree
+    // over sphereCount spheres.
+    bool view(const BVHNode* nodes, int nodeCount, const int* primitiveIndices, int sphereCount,
+              const SphereSoA& sphereData, std::shared_ptr<const void> storage);
+    // Updates a moved sphere in place: its leaf and every ancestor get tight bounds
+    // again while the topology stays as built, so a saved tree is copied on the first
+    // refit. Returns false once the nodes' summed half perimeter exceeds
+    // REFIT_COST_LIMIT times its value when the tree was built; build() pays off again.
+    bool refit(int sphereIndex, const std::vector<Sphere>& spheres);
+    RayHit intersect(const Ray& ray, const std::vector<Sphere>& spheres) const;
+    bool isOccluded(const Ray& ray) const;
+    // Calls visit(sphereIndex) for each sphere in the leaves within radius of the
+    // ray segment (a fat shadow ray); the query stops as soon as visit returns false
+    template <typename Visitor>
+    void queryAlongRay(const Ray& ray, float radius, Visitor visit) const;
+    
+    int getNodeCount() const;
+    const BVHNode* getNodes() const;
+    // Sphere index of each leaf-order slot
+    const int* getPrimitiveIndices() const;
+    const SphereSoA& getSphereData() const;
+    
+private:
+    static constexpr int TRAVERSAL_STACK_SIZE = 64;
+    static constexpr double REFIT_COST_LIMIT = 1.5;
+    
+    void prepareRefit();
+    void updateBounds(int nodeIndex, const std::vector<Sphere>& spheres);
+    void subdivide(int nodeIndex, int depth, const std::vector<Sphere>& spheres);
+    float findBestSplit(const BVHNode& node, const std::vector<Sphere>& spheres, int& axis, float& splitPos) const;
+    
+    std::vector<BVHNode> nodes;
+    std::vector<int> primitiveIndices;
+    SphereSoA sphereData;
+    // Set while viewing saved arrays instead of the vectors above
+    const BVHNode* viewNodes;
+    const int* viewPrimitiveIndices;
+    int viewNodeCount;
+    std::shared_ptr<const void> viewStorage;
+    // Filled by the first refit after a build
+    std::vector<int> parentIndices;
+    std::vector<int> sphereLeaves; // Leaf node holding each sphere
+    std::vector<int> sphereSlots; // Leaf-order slot of each sphere
+    double builtCost;
+    double refitCost;
+};
+
+template <typename Visitor>
+void BVH::queryAlongRay(const Ray& ray, float radius, Visitor visit) const {
+    if (getNodeCount() == 0) {
+        return;
+    }
+    const BVHNode* nodeData = getNodes();
+    const int* primitiveData = getPrimitiveIndices();
+    
+    const sf::Vector2f invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y);
+    
+    // Slab test against the node grown by the radius; negative on a miss
+    auto entryDistance = [&](const BVHNode& node) {
+        float tx1 = (node.boundsMin.x - radius - ray.origin.x) * invDir.x;
+        float tx2 = (node.boundsMax.x + radius - ray.origin.x) * invDir.x;
+        float ty1 = (node.boundsMin.y - radius - ray.origin.y) * invDir.y;
+        float ty2 = (node.boundsMax.y + radius - ray.origin.y) * invDir.y;
+        float tMin = std::max(std::min(tx1, tx2), std::min(ty1, ty2));
+        float tMax = std::min(std::max(tx1, tx2), std::max(ty1, ty2));
+        if (tMax < tMin || tMax < 0 || tMin > ray.maxDistance) {
+            return -1.0f;
+        }
+        return std::max(tMin, 0.0f);
+    };
+    if (entryDistance(nodeData[0]) < 0) {
+        return;
+    }
+    
+    int stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    
+    // Nearer children first, so the spheres most likely to cover the query are
+    // visited before the visitor can stop it
+    while (stackSize > 0) {
+        const BVHNode& node = nodeData[stack[--stackSize]];
+        if (node.count > 0) {
+            for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                if (!visit(primitiveData[i])) {
+                    return;
+                }
+            }
+            continue;
+        }
+        
+        const int first = node.leftOrFirst;
+        const float firstDistance = entryDistance(nodeData[first]);
+        const float secondDistance = entryDistance(nodeData[first + 1]);
+        const bool firstIsNear = firstDistance <= secondDistance;
+        const int nearChild = firstIsNear ? first : first + 1;
+        const int farChild = firstIsNear ? first + 1 : first;
+        if (std::max(firstDistance, secondDistance) >= 0) {
+            stack[stackSize++] = farChild;
+        }
+        if (std::min(firstDistance, secondDistance) >= 0) {
+            stack[stackSize++] = nearChild;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include "framebuffer.hpp"
+#include "radiancebuffer.hpp"
+#include "sphere.hpp"
+#include "threadpool.hpp"
+
+// Analytic pixel coverage for anti-aliasing at one sample per pixel.
+//
+// A pixel is the unit box around its sample. Where a straight edge crosses the
+// box, the area on each side follows exactly from the edge's normal and the
+// signed distance of the sample to it, so hard edges can be blended by the
+// fraction of the pixel they cover instead of being supersampled.
+namespace Coverage {
+    // Fraction of the pixel on the inner side of a straight edge, given the signed
+    // distance of its centre inside the edge and the edge's unit normal
+    float halfPlane(float distance, const sf::Vector2f& normal);
+    // Distance beyond which an edge with this normal no longer crosses the pixel
+    float halfWidth(const sf::Vector2f& normal);
+    
+    // Tangent line from the camera along which a sphere's silhouette runs; length is
+    // the distance to the tangent point
+    struct SilhouetteEdge {
+        sf::Vector2f direction;
+        float length;
+    };
+    
+    // Every camera ray runs straight from the camera, so a sphere's silhouette is the
+    // pair of tangent lines from the camera. Replaces edges with those of every sphere
+    // the camera is outside of.
+    void findSilhouettes(const std::vector<Sphere>& spheres, const sf::Vector2f& camera,
+                         std::vector<SilhouetteEdge>& edges);
+    // Each pixel of rows [top, bottom) that an edge crosses is blended with its neighbour
+    // across it by the pixel area beyond the line, reading the unblended samples and
+    // writing the resolved result to target. Bands of rows run on the pool when one is
+    // given, with the same result. Silhouettes seen in mirrors and through glass are
+    // left as traced.
+    void blendSilhouettes(const RadianceBuffer& radiance, FrameBuffer& target, const std::vector<SilhouetteEdge>& edges,
+                          const sf::Vector2f& camera, int top, int bottom, ThreadPool* threadPool);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+
+// Debug ray segments collected into one vertex array and drawn with a single call.
+// Each segment becomes a quad offset along its normal by half its thickness, so a
+// ray needs one square root instead of a shape with an angle and a transform. The
+// array keeps its capacity between frames; 100k rays stay interactive.
+class DebugRays {
+public:
+    DebugRays();
+    
+    void clear();
+    // Room for count more segments, four vertices each, to be filled with makeQuad;
+    // separate segments can be written from different threads
+    sf::Vertex* appendSegments(int count);
+    void draw(sf::RenderTarget& target) const;
+    
+    int getSegmentCount() const;
+    const sf::VertexArray& getVertices() const;
+    
+    // Writes the four corners of one segment's quad
+    static void makeQuad(const sf::Vector2f& start, const sf::Vector2f& end, const sf::Color& color, float thickness,
+                         sf::Vertex* quad);
+
+private:
+    sf::VertexArray vertices;
+};
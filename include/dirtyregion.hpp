@@ -0,0 +1,54 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include "framebuffer.hpp"
+
+// Set of framebuffer tiles that must be re-traced this frame.
+// Shapes are added as conservative screen-space bounds; every tile they
+// touch is marked, and untouched tiles keep their cached pixels.
+class DirtyRegion {
+public:
+    DirtyRegion();
+    
+    // Clears the region and matches its tile grid to the framebuffer
+    void reset(const FrameBuffer& frameBuffer, int tileSize);
+    void markAll();
+    
+    void addRect(float left, float top, float right, float bottom);
+    void addCircle(const sf::Vector2f& center, float radius);
+    
+    // Everything seen from apex through the circle, out to the screen edge
+    void addCameraWedge(const sf::Vector2f& apex, const sf::Vector2f& center, float radius);
+    // Shadow cast by the circle from a point light: the tangent wedge beyond the circle's center distance
+    void addShadowWedge(const sf::Vector2f& light, const sf::Vector2f& center, float radius);
+    
+    // Whether the occluder can block any part of a disk light for any point on the receiver circle
+    static bool canShadow(const sf::Vector2f& light, float lightRadius,
+                          const sf::Vector2f& occluderCenter, float occluderRadius,
+                          const sf::Vector2f& receiverCenter, float receiverRadius);
+    
+    bool isEmpty() const;
+    bool isFull() const;
+    int getTileSize() const;
+    // Indices usable with FrameBuffer::getTile, in row-major order
+    const std::vector<int>& getTiles();
+    // Pixel rows [top, bottom) covered by dirty tiles; false when nothing is dirty
+    bool getRowSpan(int& top, int& bottom);
+
+private:
+    void addPolygon(const std::vector<sf::Vector2f>& points);
+    
+    int width;
+    int height;
+    int tileSize;
+    int tilesX;
+    int tilesY;
+    int dirtyCount;
+    std::vector<char> dirtyTiles;
+    std::vector<int> tileList;
+    // Scratch polygons, reused so adding shapes does not allocate once they have grown
+    std::vector<sf::Vector2f> polygon;
+    std::vector<sf::Vector2f> clippedPolygon;
+    std::vector<sf::Vector2f> bandPolygon;
+    std::vector<sf::Vector2f> clipScratch;
+};
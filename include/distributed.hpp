@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "socket.hpp"
+#include "scene.hpp"
+#include "raytracer.hpp"
+#include "framebuffer.hpp"
+#include "radiancebuffer.hpp"
+#include "threadpool.hpp"
+
+// Ray tracer settings the workers render a frame with
+struct DistributedRenderSettings {
+    unsigned width;
+    unsigned height;
+    bool antiAliasing;
+    int maxDepth;
+    int adaptiveThreshold; // Quadtree sampling error threshold, -1 for fixed pixel steps
+    
+    DistributedRenderSettings();
+    bool operator==(const DistributedRenderSettings& other) const;
+};
+
+struct DistributedFrameStats {
+    int jobs;
+    int reissuedJobs; // Assignments beyond the first per job: lost with a worker or raced against a slow one
+    int lostWorkers;
+    int workers; // Connected when the frame finished
+};
+
+// Splits frames into DISTRIBUTED_TILE_SIZE jobs and renders them on worker processes.
+//
+// Workers connect to the coordinator's address and receive the scene and settings,
+// again whenever either changes, then job rectangles. Each worker holds at most
+// MAX_OUTSTANDING_JOBS, so faster workers come back for more and take a larger share
+// of the frame. When no unassigned job is left, an idle worker is given a copy of a
+// job still running elsewhere and the first result wins, so a slow worker cannot
+// hold the frame back. A worker whose connection fails loses its jobs to the others.
+// New workers can join between or during frames.
+//
+// Workers resolve their pixels the same way RadianceBuffer::resolve does for a local
+// frame, so the assembled image matches a local render of the same settings exactly.
+class RenderCoordinator {
+public:
+    static constexpr int MAX_OUTSTANDING_JOBS = 2;
+    
+    RenderCoordinator();
+    
+    bool listen(const std::string& address, std::string& error);
+    // Blocks until count workers are connected
+    bool waitForWorkers(int count, std::string& error);
+    // Fails only when every worker is gone before the frame completes
+    bool traceFrame(const Scene& scene, const DistributedRenderSettings& settings, FrameBuffer& frameBuffer,
+                    std::string& error);
+    
+    int getWorkerCount() const;
+    const DistributedFrameStats& getLastFrameStats() const;
+
+private:
+    struct Assignment {
+        uint32_t frame;
+        int job;
+    };
+    
+    struct Worker {
+        Socket socket;
+        uint32_t sceneVersion; // Scene message the worker last received, 0 for none
+        std::vector<Assignment> outstanding;
+    };
+    
+    bool acceptWorker();
+    bool sendJob(Worker& worker, int job);
+    // Picks the next job for the worker, or -1 when it should stay idle
+    int selectJob(const Worker& worker);
+    void receiveResult(size_t workerIndex, FrameBuffer& frameBuffer);
+    void removeWorker(size_t workerIndex);
+    
+    Socket listener;
+    std::vector<Worker> workers;
+    
+    // The current scene message, rebuilt when the scene or settings change
+    std::vector<unsigned char> sceneMessage;
+    uint32_t sceneVersion;
+    const Scene* encodedScene;
+    uint64_t encodedRevision;
+    AccelerationStructure encodedStructure;
+    DistributedRenderSettings encodedSettings;
+    
+    // State of the frame being traced
+    uint32_t frame;
+    std::vector<Tile> jobs;
+    std::vector<char> jobDone;
+    std::vector<int> jobCopies; // Workers currently holding each job
+    std::vector<int> jobAssignments; // Times each job was sent this frame
+    std::vector<int> pendingJobs; // Unassigned or lost jobs, taken from the back
+    int remainingJobs;
+    DistributedFrameStats stats;
+    std::vector<unsigned char> messageBuffer;
+};
+
+// Worker process side: connects to a coordinator and renders the jobs it is sent with
+// the ray tracer's tile path on a local thread pool until the coordinator disconnects.
+class RenderWorker {
+public:
+    explicit RenderWorker(unsigned threadCount = 0);
+    
+    // Retries the connection for a while, so workers can be started before the coordinator.
+    // Returns true when the coordinator closed the connection after the work was done.
+    bool run(const std::string& address, std::string& error);
+    int getRenderedJobCount() const;
+
+private:
+    // Both read the message just received; false for a malformed one
+    bool applyScene(std::string& error);
+    bool renderJob(std::string& error);
+    
+    ThreadPool threadPool;
+    Scene scene;
+    RayTracer rayTracer;
+    RadianceBuffer radiance;
+    FrameBuffer frameBuffer;
+    Socket socket;
+    std::vector<unsigned char> messageBuffer;
+    std::vector<unsigned char> resultBuffer;
+    bool hasScene;
+    int renderedJobs;
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+
+// Rectangular region of the framebuffer rendered as one unit of work
+struct Tile {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Persistent RGBA8 pixel buffer shared by the CPU render paths.
+// Pixels are written on the CPU and uploaded to a single reused texture
+// once per frame, instead of issuing one draw call per sample.
+class FrameBuffer {
+public:
+    FrameBuffer(unsigned width, unsigned height);
+    
+    void resize(unsigned width, unsigned height);
+    void clear(const sf::Color& color);
+    // Uploads only the rows marked dirty since the last present, then draws the cached texture
+    void present(sf::RenderWindow& window);
+    void markDirty();
+    void markDirty(int top, int bottom);
+    // Hands the rows marked dirty since the last present or take to another consumer
+    // and clears them; false when no row is dirty
+    bool takeDirtyRows(int& top, int& bottom);
+    
+    // Writes binary PPM for .ppm paths and lets sf::Image handle PNG and other formats
+    bool saveToFile(const std::string& path) const;
+    
+    void setPixel(unsigned x, unsigned y, const sf::Color& color);
+    void fillRect(int x, int y, int w, int h, const sf::Color& color);
+    sf::Color getPixel(unsigned x, unsigned y) const;
+    
+    // Tiles cover the buffer row by row; edge tiles are clipped
+    int getTileCount(int tileSize) const;
+    Tile getTile(int index, int tileSize) const;
+    
+    unsigned getWidth() const;
+    unsigned getHeight() const;
+    const sf::Uint8* getPixels() const;
+    // Direct access for bulk writers; callers mark the rows they change dirty
+    sf::Uint8* getPixels();
+    
+private:
+    unsigned width;
+    unsigned height;
+    std::vector<sf::Uint8> pixels;
+    sf::Texture texture;
+    sf::Sprite sprite;
+    bool textureReady;
+    int dirtyTop;
+    int dirtyBottom;
+};
+
+// Pixel reads and writes sit in the innermost render loops, so they are kept inline.
+inline sf::Color FrameBuffer::getPixel(unsigned x, unsigned y) const {
+    const sf::Uint8* p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+    return sf::Color(p[0], p[1], p[2], p[3]);
+}
+
+inline void FrameBuffer::setPixel(unsigned x, unsigned y, const sf::Color& color) {
+    sf::Uint8* p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+    p[0] = color.r;
+    p[1] = color.g;
+    p[2] = color.b;
+    p[3] = color.a;
+}
+
+inline void FrameBuffer::fillRect(int x, int y, int w, int h, const sf::Color& color) {
+    // Clip the block against the buffer edges
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + w > static_cast<int>(width) ? static_cast<int>(width) : x + w;
+    int y1 = y + h > static_cast<int>(height) ? static_cast<int>(height) : y + h;
+    
+    for (int py = y0; py < y1; ++py) {
+        for (int px = x0; px < x1; ++px) {
+            setPixel(px, py, color);
+        }
+    }
+}
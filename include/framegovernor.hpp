@@ -0,0 +1,64 @@
+#pragma once
+#include "utils.hpp"
+
+// Trace modes with a frame time budget of their own
+enum class GovernedMode {
+    MODE_2D,
+    RAY_TRACING,
+    COUNT
+};
+
+// Picks the sampling step of each trace mode from its recent trace times, so the
+// mode keeps to a target frame time where the configured step is too slow.
+//
+// Each doubling of the step traces a quarter of the samples. The step doubles, up to
+// MAX_STEP, once HISTORY_FRAMES frames at it average over the target, or sooner when
+// the last two take more than twice the target. It halves again, down to the mode's
+// configured step, once they average under REFINE_HEADROOM of the target. The full
+// frame every change forces is left out of the average. A halving undone within the
+// frames it waited for doubles the wait before the next one, so under a steady load
+// the step settles instead of alternating between two values.
+class FrameGovernor {
+public:
+    static constexpr int MAX_STEP = 8; // RENDER_TILE_SIZE must stay a multiple of it
+    static constexpr int HISTORY_FRAMES = 8;
+    // A step a quarter the cost should stay under the target despite per-frame overheads
+    static constexpr float REFINE_HEADROOM = 0.35f;
+    static constexpr float DEFAULT_2D_TARGET_MS = 1000.0f / Utils::FRAME_RATE_LIMIT;
+    static constexpr float DEFAULT_RAY_TRACING_TARGET_MS = 1000.0f / 60.0f;
+    static constexpr float MIN_TARGET_MS = 1.0f;
+    static constexpr float MAX_TARGET_MS = 1000.0f;
+    static constexpr int MAX_REFINE_DELAY = 512;
+    
+    FrameGovernor();
+    
+    // Clamped to [MIN_TARGET_MS, MAX_TARGET_MS]
+    void setTargetMs(GovernedMode mode, float milliseconds);
+    float getTargetMs(GovernedMode mode) const;
+    // Step for the next frame of the mode; never finer than the configured step
+    int getStep(GovernedMode mode, int configuredStep) const;
+    // Takes the trace time of a frame traced at getStep(mode, configuredStep)
+    void addFrame(GovernedMode mode, float milliseconds, int configuredStep);
+    // Step changes since construction, across all modes
+    int getStepChanges() const;
+    // Every mode starts over from its configured step
+    void reset();
+
+private:
+    struct ModeState {
+        float targetMs;
+        int step; // 1 until the governor first coarsens the mode
+        float history[HISTORY_FRAMES]; // Ring of trace times at the current step
+        int frames;
+        int next;
+        bool skipFrame; // The full frame a step change forces
+        int framesAtStep;
+        int refineDelay; // Frames at a step before it may be halved
+        bool refined; // The current step came from halving
+    };
+    
+    void changeStep(ModeState& state, int step);
+    
+    ModeState modes[static_cast<int>(GovernedMode::COUNT)];
+    int stepChanges;
+};
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct RenderSettings;
+
+// Timing of one frame, for comparing renderer changes on the same replayed input
+struct FrameTiming {
+    int frame;
+    float deltaTime; // Input time step, seconds
+    double updateMs; // Input toggles, Scene::handleInput and Scene::update
+    double renderMs; // Tracing or drawing the frame, without presenting it
+    const char* mode; // "2d", "rt" or "shapes"
+    uint64_t revision; // Scene revision the frame was rendered from
+    uint64_t raysCast;
+    uint64_t pixelsShaded;
+};
+
+// Per-frame timings written as CSV, one row per frame, plus a one-line summary
+class FrameTimingReport {
+public:
+    void clear();
+    void add(const FrameTiming& timing);
+    const std::vector<FrameTiming>& getFrames() const;
+    
+    bool save(const std::string& path, std::string& error) const;
+    // Average, median, 95th percentile and worst render time over all frames
+    void printSummary() const;
+    
+    static const char* getModeName(const RenderSettings& settings);
+
+private:
+    std::vector<FrameTiming> frames;
+};
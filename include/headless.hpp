@@ -0,0 +1,52 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+#include "sphere.hpp"
+
+// Settings for rendering frames offline, without a window or GL context
+struct HeadlessOptions {
+    bool hasMode; // Set by --mode; replays take their modes from the recording
+    bool use2DMode;
+    unsigned width;
+    unsigned height;
+    int pixelStep;
+    bool antiAliasing;
+    bool coverageAntiAliasing; // One sample per pixel with analytically blended edges
+    bool incremental; // Reuse unchanged pixels between frames instead of tracing each one fully
+    bool progressive; // Refine a static ray-traced frame with one jittered pass per frame
+    int reprojectionInterval; // Moving frames between full traces with temporal reprojection, 0 to disable
+    int adaptiveThreshold; // Quadtree sampling error threshold, -1 for fixed pixel steps
+    float targetMs; // Frame governor target for both trace modes, 0 to disable
+    int maxDepth; // Ray tracing bounces per camera ray, including the first hit
+    bool useGrid; // Uniform grid instead of the BVH
+    unsigned threadCount; // 0 selects the number of hardware threads
+    int frameCount;
+    std::string outputPath;
+    std::string tracePath; // Chrome trace output, empty to disable
+    std::string replayPath; // Input recording driving the frames, empty for a static scene
+    std::string reportPath; // Per-frame timing CSV, empty to disable
+    std::string scenePath; // Binary scene file, or a text scene for .txt paths
+    std::string saveScenePath; // Write the scene as a binary file instead of rendering
+    bool saveSceneBVH;
+    std::string coordinatorAddress; // Render frames on worker processes connecting here
+    int workerCount; // Workers the coordinator waits for before the first frame
+    std::string workerAddress; // Run as a render worker for the coordinator at this address
+    
+    bool hasSpherePosition;
+    sf::Vector2f spherePosition;
+    bool hasSphereSurface;
+    SurfaceType sphereSurface;
+    bool hasLightPosition;
+    sf::Vector2f lightPosition;
+    std::vector<sf::Vector3f> extraSpheres; // x, y, radius
+    std::vector<sf::Vector2f> extraLights;
+    
+    HeadlessOptions();
+};
+
+// Returns true when the arguments ask for headless rendering
+bool isHeadlessRequested(int argc, char* argv[]);
+bool parseHeadlessOptions(int argc, char* argv[], HeadlessOptions& options, std::string& error);
+int runHeadless(const HeadlessOptions& options);
+void printHeadlessUsage();
@@ -0,0 +1,79 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Scene;
+class Renderer;
+
+// Keys the interactive loop reacts to, one bit each in FrameInput::keys.
+// Recordings store the bits, so new keys go at the end.
+enum class InputKey {
+    LEFT,
+    RIGHT,
+    UP,
+    DOWN,
+    DEBUG_MODE, // R
+    RAY_DISPLAY_MODE, // T
+    MORE_DEBUG_RAYS, // Page Up
+    FEWER_DEBUG_RAYS, // Page Down
+    MODE_2D, // 2
+    REAL_RAY_TRACING, // 3
+    PARALLEL_RENDERING, // M
+    INCREMENTAL_RENDERING, // I
+    ADAPTIVE_SAMPLING, // A
+    PROGRESSIVE_RENDERING, // F
+    SPHERE_SURFACE, // G
+    ACCELERATION_STRUCTURE, // B
+    RENDER_THREAD, // D
+    PROFILER_OVERLAY, // P
+    TRACE_CAPTURE, // C
+    TEMPORAL_REPROJECTION, // E
+    FRAME_GOVERNOR, // Q
+    COVERAGE_ANTI_ALIASING, // V
+    COUNT
+};
+
+// Everything one frame of the interactive loop reads from the user
+struct FrameInput {
+    sf::Vector2i mousePosition;
+    uint32_t keys; // Held keys, bit i for InputKey i
+    float deltaTime; // Seconds since the previous frame
+    
+    FrameInput();
+    bool isDown(InputKey key) const;
+    void setDown(InputKey key, bool down);
+    
+    // Reads the keyboard and the mouse relative to the window
+    static FrameInput poll(const sf::RenderWindow& window, float deltaTime);
+};
+
+// Applies frame inputs to a scene and renderer the same way live or replayed.
+// Toggles act on the frame a key goes down, so holding one flips it once.
+class InputHandler {
+public:
+    InputHandler();
+    
+    // Applies the toggles pressed this frame, then the mouse and movement keys through
+    // Scene::handleInput and Scene::update. Keys that only mean something with a
+    // window (render thread, overlay, capture) are left to the caller via wasPressed.
+    void apply(const FrameInput& input, Scene& scene, Renderer& renderer);
+    // True when the key went down in the last applied frame
+    bool wasPressed(InputKey key) const;
+
+private:
+    uint32_t heldKeys;
+    uint32_t pressedKeys;
+};
+
+// Input recordings are text files with a version line, then one frame per line:
+//   DELTA_TIME MOUSE_X MOUSE_Y KEYS
+// where KEYS is the FrameInput::keys bit mask. Times are written with enough digits
+// to read back the exact float, so a replay takes the recorded steps bit for bit.
+namespace InputRecording {
+    constexpr int VERSION = 1;
+    
+    bool save(const std::string& path, const std::vector<FrameInput>& frames, std::string& error);
+    bool load(const std::string& path, std::vector<FrameInput>& frames, std::string& error);
+}
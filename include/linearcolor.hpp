@@ -0,0 +1,65 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cmath>
+
+// Colour in linear light with unbounded float channels, used for all shading
+// in the ray tracer. Values above 1 are kept until the final tonemap, so
+// several lights add up instead of clipping at every step.
+struct LinearColor {
+    float r;
+    float g;
+    float b;
+    
+    LinearColor() : r(0.f), g(0.f), b(0.f) {}
+    explicit LinearColor(float value) : r(value), g(value), b(value) {}
+    LinearColor(float r, float g, float b) : r(r), g(g), b(b) {}
+    
+    // Decodes an sRGB colour such as a material or the background
+    static LinearColor fromColor(const sf::Color& color);
+    
+    LinearColor& operator+=(const LinearColor& other) {
+        r += other.r;
+        g += other.g;
+        b += other.b;
+        return *this;
+    }
+};
+
+inline LinearColor operator+(const LinearColor& a, const LinearColor& b) {
+    return LinearColor(a.r + b.r, a.g + b.g, a.b + b.b);
+}
+
+inline LinearColor operator*(const LinearColor& a, const LinearColor& b) {
+    return LinearColor(a.r * b.r, a.g * b.g, a.b * b.b);
+}
+
+inline LinearColor operator*(const LinearColor& color, float scale) {
+    return LinearColor(color.r * scale, color.g * scale, color.b * scale);
+}
+
+inline bool operator==(const LinearColor& a, const LinearColor& b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+namespace ColorSpace {
+    // sRGB transfer function of all 256 channel values, built once
+    struct DecodeTable {
+        float values[256];
+        
+        DecodeTable() {
+            for (int i = 0; i < 256; ++i) {
+                float c = static_cast<float>(i) / 255.0f;
+                values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+        }
+    };
+    
+    inline float decode(sf::Uint8 value) {
+        static const DecodeTable table;
+        return table.values[value];
+    }
+}
+
+inline LinearColor LinearColor::fromColor(const sf::Color& color) {
+    return LinearColor(ColorSpace::decode(color.r), ColorSpace::decode(color.g), ColorSpace::decode(color.b));
+}
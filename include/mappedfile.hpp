@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file (mmap, or MapViewOfFile on Windows).
+// Pages are loaded on first access and shared with the OS file cache, so mapping
+// a large file is near-instant and costs no private memory.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    // Replaces any previous mapping; empty files cannot be mapped
+    bool open(const std::string& path, std::string& error);
+    void close();
+    
+    const unsigned char* getData() const;
+    size_t getSize() const;
+
+private:
+    const unsigned char* data;
+    size_t size;
+#if defined(_WIN32)
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
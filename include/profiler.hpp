@@ -0,0 +1,100 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Lightweight instrumentation: scoped timing zones, per-thread counters,
+// Chrome/Perfetto trace export and a live in-window overlay.
+//
+// Define RT_ENABLE_PROFILER=0 to compile every zone and counter out entirely.
+#ifndef RT_ENABLE_PROFILER
+#define RT_ENABLE_PROFILER 1
+#endif
+
+enum class ProfileCounter {
+    RAYS_CAST,
+    SHADOW_RAYS,
+    HITS,
+    PIXELS_SHADED,
+    PIXELS_REPROJECTED, // Samples that reused the previous frame's shading
+    COUNT
+};
+
+struct ProfileZoneStats {
+    const char* name; // The name the zone was registered with
+    double totalMs; // Summed over all threads
+    uint64_t calls;
+};
+
+struct ProfileFrameStats {
+    double frameMs;
+    std::vector<ProfileZoneStats> zones;
+    uint64_t counters[static_cast<int>(ProfileCounter::COUNT)];
+};
+
+namespace Profiler {
+    // Zones only take timestamps while profiling is enabled; counters always count
+    void setEnabled(bool enabled);
+    bool isEnabled();
+    
+    void beginFrame();
+    void endFrame();
+    const ProfileFrameStats& getLastFrame();
+    
+    // While capturing, coarse zones are kept as trace events for export
+    void setCapturing(bool capturing);
+    bool isCapturing();
+    bool exportChromeTrace(const std::string& path);
+    
+    void toggleOverlay();
+    bool isOverlayVisible();
+    void drawOverlay(sf::RenderWindow& window);
+    
+    const char* getCounterName(ProfileCounter counter);
+    
+    // Used by the macros below; name must outlive the profiler, as a string literal does
+    int registerZone(const char* name);
+    uint64_t now();
+    void recordZone(int zoneId, uint64_t start, uint64_t end, bool traceEvent);
+    void addCount(ProfileCounter counter, uint64_t amount);
+}
+
+class ProfileScope {
+public:
+    ProfileScope(int zoneId, bool traceEvent)
+        : zoneId(zoneId)
+        , traceEvent(traceEvent)
+        , start(Profiler::isEnabled() ? Profiler::now() : 0) {
+    }
+    
+    ~ProfileScope() {
+        if (start != 0) {
+            Profiler::recordZone(zoneId, start, Profiler::now(), traceEvent);
+        }
+    }
+    
+private:
+    int zoneId;
+    bool traceEvent;
+    uint64_t start;
+};
+
+#define RT_PROFILE_CONCAT_INNER(a, b) a##b
+#define RT_PROFILE_CONCAT(a, b) RT_PROFILE_CONCAT_INNER(a, b)
+
+#if RT_ENABLE_PROFILER
+// Coarse zone: aggregated per frame and emitted as a trace event while capturing
+#define PROFILE_ZONE(name) \
+    static const int RT_PROFILE_CONCAT(profileZoneId, __LINE__) = Profiler::registerZone(name); \
+    ProfileScope RT_PROFILE_CONCAT(profileScope, __LINE__)(RT_PROFILE_CONCAT(profileZoneId, __LINE__), true)
+// Hot-path zone (per ray or per pixel): aggregated only, never emitted as an event
+#define PROFILE_ZONE_HOT(name) \
+    static const int RT_PROFILE_CONCAT(profileZoneId, __LINE__) = Profiler::registerZone(name); \
+    ProfileScope RT_PROFILE_CONCAT(profileScope, __LINE__)(RT_PROFILE_CONCAT(profileZoneId, __LINE__), false)
+#define PROFILE_COUNT(counter, amount) Profiler::addCount(counter, amount)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_ZONE_HOT(name) ((void)0)
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#endif
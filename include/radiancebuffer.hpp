@@ -0,0 +1,64 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include "framebuffer.hpp"
+#include "linearcolor.hpp"
+
+// Float framebuffer of linear radiance written by the ray tracer.
+// Nothing is clamped or quantized while shading; resolve() converts the
+// rows of a frame to display colours in one pass at the end.
+class RadianceBuffer {
+public:
+    RadianceBuffer();
+    
+    // Keeps the contents when the size is unchanged, so incremental frames can reuse them
+    void resize(unsigned width, unsigned height);
+    
+    void setPixel(unsigned x, unsigned y, const LinearColor& color);
+    void fillRect(int x, int y, int w, int h, const LinearColor& color);
+    LinearColor getPixel(unsigned x, unsigned y) const;
+    
+    // Tonemaps, sRGB-encodes and quantizes rows [top, bottom) into the
+    // framebuffer and marks them dirty for the next upload
+    void resolve(FrameBuffer& target, int top, int bottom) const;
+    // Resolves one rectangle the same way; each pixel converts on its own, so the
+    // result matches resolving the rows it lies in
+    void resolve(FrameBuffer& target, const Tile& tile) const;
+    // Resolves a single colour, such as a blend of pixels, exactly as resolve() would
+    static sf::Color resolveColor(const LinearColor& color);
+    
+    unsigned getWidth() const;
+    unsigned getHeight() const;
+
+private:
+    unsigned width;
+    unsigned height;
+    std::vector<float> pixels; // RGBx; the padding channel keeps pixels 16-byte sized for SIMD
+};
+
+// Pixel reads and writes sit in the innermost render loops, so they are kept inline.
+inline LinearColor RadianceBuffer::getPixel(unsigned x, unsigned y) const {
+    const float* p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+    return LinearColor(p[0], p[1], p[2]);
+}
+
+inline void RadianceBuffer::setPixel(unsigned x, unsigned y, const LinearColor& color) {
+    float* p = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+    p[0] = color.r;
+    p[1] = color.g;
+    p[2] = color.b;
+}
+
+inline void RadianceBuffer::fillRect(int x, int y, int w, int h, const LinearColor& color) {
+    // Clip the block against the buffer edges
+    int x0 = x < 0 ? 0 : x;
+    int y0 = y < 0 ? 0 : y;
+    int x1 = x + w > static_cast<int>(width) ? static_cast<int>(width) : x + w;
+    int y1 = y + h > static_cast<int>(height) ? static_cast<int>(height) : y + h;
+    
+    for (int py = y0; py < y1; ++py) {
+        for (int px = x0; px < x1; ++px) {
+            setPixel(px, py, color);
+        }
+    }
+}
@@ -9,8 +9,36 @@ struct Ray {
     
     Ray(const sf::Vector2f& origin, const sf::Vector2f& direction, float maxDistance = 1000.0f);
     
+    // Skips the normalization; for directions already of unit length, such as
+    // reflections of unit vectors or those filled in by RayBatch
+    static Ray fromUnitDirection(const sf::Vector2f& origin, const sf::Vector2f& unitDirection,
+                                 float maxDistance = 1000.0f);
+    
     sf::Vector2f getPointAtDistance(float distance) const;
     void normalize();
+
+private:
+    struct UnitDirection {};
+    Ray(const sf::Vector2f& origin, const sf::Vector2f& direction, float maxDistance, UnitDirection);
+};
+
+// Caller-owned rays in structure-of-arrays layout. Generators write origins and raw
+// directions, then normalize them all in one loop the compiler can vectorize; the
+// arrays keep their capacity, so refilling a batch of the same size never allocates.
+struct RayBatch {
+    std::vector<float> originX;
+    std::vector<float> originY;
+    std::vector<float> directionX;
+    std::vector<float> directionY;
+    std::vector<float> maxDistance;
+    
+    int size() const;
+    void resize(int count);
+    void set(int index, const sf::Vector2f& origin, const sf::Vector2f& direction, float distance = 1000.0f);
+    // Same rounding as Ray::normalize, so a batch ray matches the one the constructor makes
+    void normalizeDirections();
+    // Directions must already be normalized
+    Ray getRay(int index) const;
 };
 
 struct RayHit {
@@ -18,6 +46,7 @@ struct RayHit {
     sf::Vector2f normal;
     float distance;
     bool hit;
+    int objectIndex; // Index of the hit sphere in the scene, -1 if unknown
     
     RayHit();
     RayHit(const sf::Vector2f& point, const sf::Vector2f& normal, float distance);
@@ -1,39 +1,162 @@
 #pragma once
 #include <SFML/Graphics.hpp>
+#include <cstdint>
 #include <vector>
 #include "ray.hpp"
+#include "span.hpp"
 #include "sphere.hpp"
 #include "light.hpp"
 #include "utils.hpp"
+#include "framebuffer.hpp"
+#include "threadpool.hpp"
+#include "dirtyregion.hpp"
+#include "accumulationbuffer.hpp"
+#include "linearcolor.hpp"
+#include "radiancebuffer.hpp"
+#include "coverage.hpp"
 
 class Scene;
+class ReprojectionCache;
 
 class RayTracer {
 public:
     RayTracer();
     
-    void renderScene(sf::RenderWindow& window, const Scene& scene);
-    sf::Color traceRay(const Ray& ray, const Scene& scene, int depth = 0);
-    sf::Color calculateLighting(const sf::Vector2f& point, const sf::Vector2f& normal, const Scene& scene);
+    // Renders serially when threadPool is null, otherwise tile by tile on the pool.
+    // A dirty region limits tracing to its tiles; the rest of the buffer is reused.
+    void renderScene(sf::RenderWindow& window, const Scene& scene, FrameBuffer& frameBuffer,
+                     ThreadPool* threadPool = nullptr, DirtyRegion* dirtyRegion = nullptr);
+    // CPU-only part of renderScene; needs no window or GL context. Tiles are shaded
+    // into the float radiance buffer, and the changed rows are resolved into the
+    // framebuffer in one tonemapping pass at the end.
+    void traceFrame(const Scene& scene, FrameBuffer& frameBuffer,
+                    ThreadPool* threadPool = nullptr, DirtyRegion* dirtyRegion = nullptr);
+    void renderTile(const Scene& scene, RadianceBuffer& target, const Tile& tile);
+    // traceFrame that shades diffuse hits with the light visibilities of the previous
+    // frame's samples where the cache allows it and traces the rest; a frame the cache
+    // cannot reuse is traced in full, whatever the dirty region. Adaptive sampling has no
+    // fixed sample grid, so it falls back to traceFrame.
+    void reprojectFrame(const Scene& scene, FrameBuffer& frameBuffer, ReprojectionCache& cache,
+                        ThreadPool* threadPool = nullptr, DirtyRegion* dirtyRegion = nullptr);
+    void reprojectTile(const Scene& scene, RadianceBuffer& target, ReprojectionCache& cache, const Tile& tile);
+    // Light and sphere markers drawn over the traced image
+    void drawSceneMarkers(sf::RenderWindow& window, const Scene& scene);
+    
+    // Adds one jittered full-resolution pass to every tile that has not converged yet
+    // and resolves those tiles into the framebuffer; returns false once all have
+    bool accumulateFrame(const Scene& scene, FrameBuffer& frameBuffer, AccumulationBuffer& accumulation,
+                         ThreadPool* threadPool = nullptr);
+    void accumulateTile(const Scene& scene, AccumulationBuffer& accumulation, const Tile& tile, int tileIndex);
+    // sampleState, when given, receives an id of the hit objects and their shadowing lights
+    // Shading is done in linear light without clamping; see RadianceBuffer::resolve
+    LinearColor traceRay(const Ray& ray, const Scene& scene, uint32_t* sampleState = nullptr);
+    // Batched traceRay: colors (and sampleStates, unless empty) receive one entry per ray.
+    // Rays are traced in wavefronts of bounded size, and all working memory is kept per
+    // thread, so tracing allocates nothing once the buffers have grown. firstHits, unless
+    // empty, holds each ray's closest hit, found already, and spares the first bounce.
+    void traceRays(const Scene& scene, Span<const Ray> rays, Span<LinearColor> colors,
+                   Span<uint32_t> sampleStates = Span<uint32_t>(), Span<const RayHit> firstHits = Span<const RayHit>());
+    void traceRays(const Scene& scene, const RayBatch& rays, Span<LinearColor> colors,
+                   Span<uint32_t> sampleStates = Span<uint32_t>());
+    LinearColor calculateLighting(const sf::Vector2f& point, const sf::Vector2f& normal, const Scene& scene,
+                                  uint32_t* shadowMask = nullptr);
+    // Visible fraction of the light's disk (radius LIGHT_RADIUS) from point, in [0, 1]:
+    // the angle the disk subtends minus the angles of the spheres in front of it
+    float calculateLightVisibility(const sf::Vector2f& point, const Light& light, const Scene& scene);
     bool isInShadow(const sf::Vector2f& point, const Light& light, const Scene& scene);
+    bool isOccluded(const sf::Vector2f& point, const sf::Vector2f& target, const Scene& scene);
     RayHit findClosestHit(const Ray& ray, const Scene& scene);
+    // Selects the acceleration structure once for the whole batch
+    void findClosestHits(Span<const Ray> rays, Span<RayHit> hits, const Scene& scene);
+    // The same for rays [first, first + hits.size()) of a batch, read in place
+    void findClosestHits(const RayBatch& rays, int first, Span<RayHit> hits, const Scene& scene);
     
-    // Ray generation
-    std::vector<Ray> generateRaysFromLight(const Light& light, int numRays);
-    std::vector<Ray> generateRaysFromCamera(const sf::Vector2f& cameraPos, int numRays);
+    // Ray generation; the batch generators refill the caller's buffers with unit directions
+    Ray generateCameraRay(const sf::Vector2f& pixelPos);
+    // One ray per pixelStep sample of the tile, in row-major order
+    void generateCameraRays(const Tile& tile, int pixelStep, RayBatch& rays);
+    void generateRaysFromLight(const Light& light, int numRays, RayBatch& rays, float maxDistance = 1000.0f);
+    void generateRaysFromCamera(const sf::Vector2f& cameraPos, int numRays, RayBatch& rays, float maxDistance = 1000.0f);
     
     // Settings
     void setMaxDepth(int depth);
-    void setShadowRays(int rays);
     void setAntiAliasing(bool enabled);
+    // Step the frame is traced at: the override when set, else the anti-aliasing one
+    int getPixelStep() const;
+    int getBasePixelStep() const;
+    // A step above 0 overrides the anti-aliasing one; 0 follows anti-aliasing again
+    void setPixelStep(int step);
+    // Interpolates the pixels between samples edge-aware when the step is above 1;
+    // see Upscaling
+    void setEdgeAwareUpscaling(bool enabled);
+    bool isEdgeAwareUpscaling() const;
+    // Traces one sample per pixel and blends the pixels sphere silhouettes cross by the
+    // area on each side; see Coverage. Progressive and adaptive sampling leave it out.
+    void setCoverageAntiAliasing(bool enabled);
+    bool isCoverageAntiAliasing() const;
+    // Adaptive sampling replaces the fixed pixel step with quadtree refinement
+    void setAdaptiveSampling(bool enabled);
+    bool isAdaptiveSampling() const;
+    void setAdaptiveThreshold(int threshold);
+    int getAdaptiveThreshold() const;
+    
+    // Every camera ray starts here, so a sphere only ever covers the wedge seen from it
+    sf::Vector2f getCameraPosition() const;
     
 private:
+    // Settings the shading kernels are compiled for, one bit each. The kernel matching
+    // the current settings is picked once per batch, so no per-ray or per-light loop
+    // tests them.
+    enum ShadingFeature : unsigned {
+        TRACK_SAMPLE_STATES = 1u << 0,
+        SECONDARY_RAYS = 1u << 1, // maxDepth above 1
+        UNIFORM_GRID = 1u << 2, // Grid queries instead of BVH ones
+        SHADING_FEATURE_SETS = 1u << 3
+    };
+    typedef void (RayTracer::*WavefrontKernel)(const Scene&, LinearColor*, uint32_t*, const RayHit*);
+    
+    unsigned getShadingFeatures(const Scene& scene, bool trackSampleStates) const;
+    static WavefrontKernel getWavefrontKernel(unsigned features);
+    // Traces the rays seeded into this thread's queues breadth-first: each bounce
+    // intersects its whole queue, then shades it, and the reflected and refracted rays
+    // it spawns form the next queue, up to maxDepth bounces. firstHits, when given,
+    // replaces the intersection of the first bounce.
+    template <unsigned Features>
+    void traceWavefront(const Scene& scene, LinearColor* colors, uint32_t* sampleStates, const RayHit* firstHits);
+    template <unsigned Features>
+    LinearColor calculateLightingWith(const sf::Vector2f& point, const sf::Vector2f& normal, const Scene& scene,
+                                      uint32_t& shadowMask);
+    template <unsigned Features>
+    float calculateLightVisibilityWith(const sf::Vector2f& point, const Light& light, const Scene& scene);
+    // Diffuse term of one light at the given visibility, added to lighting
+    template <unsigned Features>
+    void addDiffuseLight(LinearColor& lighting, const sf::Vector2f& point, const sf::Vector2f& normal,
+                         const Light& light, float visibility) const;
+    // Shades a camera ray's hit on a diffuse sphere the way traceRays does, with one
+    // visibility per light either given or, unless knownVisibilities, computed into visibilities
+    typedef LinearColor (RayTracer::*DiffuseShader)(const RayHit&, const Scene&, float*, bool, uint32_t&);
+    DiffuseShader getDiffuseShader(const Scene& scene) const;
+    template <unsigned Features>
+    LinearColor shadeDiffuseHitWith(const RayHit& hit, const Scene& scene, float* visibilities, bool knownVisibilities,
+                                    uint32_t& shadowMask);
+    // Upscales the traced radiance rows [top, bottom) when enabled, resolves them and
+    // blends the silhouettes crossing them when coverage anti-aliasing is on
+    void resolveRows(const Scene& scene, FrameBuffer& frameBuffer, int top, int bottom, ThreadPool* threadPool);
+    // Drops the silhouette edges another sphere blocks before their tangent point: the
+    // blocker lies on both sides of such a line, so there is no edge to blend
+    void cullHiddenSilhouettes(const Scene& scene, const sf::Vector2f& camera, ThreadPool* threadPool);
     void renderLight(sf::RenderWindow& window, const Light& light);
     void renderSphereOutline(sf::RenderWindow& window, const Sphere& sphere);
     
+    RadianceBuffer radiance;
+    std::vector<Coverage::SilhouetteEdge> silhouetteEdges; // Reused by every resolve
     int maxDepth;
-    int shadowRays;
     bool antiAliasing;
+    int pixelStepOverride;
+    bool edgeAwareUpscaling;
+    bool coverageAntiAliasing;
+    bool adaptiveSampling;
+    int adaptiveThreshold;
     float ambientIntensity;
     float diffuseIntensity;
     float specularIntensity;
@@ -4,9 +4,51 @@
 #include "light.hpp"
 #include "utils.hpp"
 #include "raytracer.hpp"
+#include "framebuffer.hpp"
+#include "threadpool.hpp"
+#include "dirtyregion.hpp"
+#include "accumulationbuffer.hpp"
+#include "reprojectioncache.hpp"
+#include "debugrays.hpp"
+#include "framegovernor.hpp"
+#include <cstdint>
+#include <vector>
 
 class Scene;
 
+// Shadow of the sphere in the 2D mode, precomputed once per frame.
+// A point is shadowed when it lies inside both tangent lines from the light
+// and at least as far from the light as the sphere center, so classifying a
+// pixel needs only multiply-adds and sign tests.
+struct ShadowWedge {
+    sf::Vector2f apex; // Light position
+    sf::Vector2f firstEdgeNormal; // Outward normals of the two tangent lines
+    sf::Vector2f secondEdgeNormal;
+    float nearDistanceSquared;
+    bool castsShadow; // False when the light is inside the sphere
+};
+
+// Mode and quality switches of a renderer, copied as a whole to configure
+// another renderer the same way
+struct RenderSettings {
+    bool is2DMode;
+    bool isRealRayTracing;
+    bool isParallelRendering;
+    bool isIncrementalRendering;
+    bool isAdaptiveSampling;
+    bool isProgressiveRendering;
+    bool isTemporalReprojection;
+    int reprojectionRefreshInterval;
+    int adaptiveThreshold;
+    int pixelStep;
+    bool isFrameGovernor;
+    bool isCoverageAntiAliasing;
+    float frameTargetMs2D;
+    float frameTargetMsRayTracing;
+    
+    bool operator==(const RenderSettings& other) const;
+};
+
 enum class RayDisplayMode {
     NONE,
     SPHERE_ONLY,
@@ -22,17 +64,39 @@ public:
     void renderSphere(sf::RenderWindow& window, const Sphere& sphere, const Light& light);
     void renderLight(sf::RenderWindow& window, const Light& light);
     void render2DScene(sf::RenderWindow& window, const Scene& scene);
+    void render2DTile(const Scene& scene, const Tile& tile, const ShadowWedge& wedge);
     void renderRealRayTracing(sf::RenderWindow& window, const Scene& scene);
+    // Outlines and markers drawn over a traced frame, for whichever trace mode is active
+    void drawTraceOverlays(sf::RenderWindow& window, const Scene& scene);
+    
+    // CPU-only rendering of the active trace mode (2D or ray tracing) into the
+    // framebuffer; needs no window or GL context
+    void traceFrame(const Scene& scene);
+    void trace2DFrame(const Scene& scene);
+    const FrameBuffer& getFrameBuffer() const;
+    FrameBuffer& getFrameBuffer();
+    RayTracer& getRayTracer();
+    // Also lent to the scene for parallel acceleration structure builds
+    ThreadPool& getThreadPool();
     
     float calculateLighting(const sf::Vector2f& point, const Light& light);
     sf::Color calculateSphereColor(const Sphere& sphere, const Light& light);
     bool isPointInShadow(const sf::Vector2f& point, const Light& light, const Sphere& sphere);
     sf::Color calculate2DLighting(const sf::Vector2f& point, const Light& light, const Sphere& sphere);
+    ShadowWedge computeShadowWedge(const Light& light, const Sphere& sphere) const;
+    bool isInShadowWedge(const sf::Vector2f& point, const ShadowWedge& wedge) const;
     
     void clearWindow(sf::RenderWindow& window);
     void drawDebugInfo(sf::RenderWindow& window, const sf::Vector2f& mousePos, const Light& light);
-    void drawRays(sf::RenderWindow& window, const Light& light, const Sphere& sphere);
-    void drawAllRays(sf::RenderWindow& window, const Light& light);
+    // Collects the rays of the display mode, each cut at its first hit in the scene,
+    // and draws them as one vertex array
+    void drawDebugRays(sf::RenderWindow& window, const Scene& scene);
+    void buildDebugRays(const Scene& scene);
+    // Rays from the light to the sphere center and around its outline
+    void addSphereRays(const Scene& scene, const Light& light, const Sphere& sphere);
+    // getDebugRayCount() rays in all directions, out to the light's reach
+    void addAllRays(const Scene& scene, const Light& light);
+    const DebugRays& getDebugRays() const;
     void drawLightRays(sf::RenderWindow& window, const Light& light, const sf::Vector2f& target, const sf::Color& color);
     void drawLightRadius(sf::RenderWindow& window, const Light& light);
     
@@ -41,18 +105,133 @@ public:
     void setRayDisplayMode(RayDisplayMode mode);
     RayDisplayMode getRayDisplayMode() const;
     void cycleRayDisplayMode();
+    // Clamped to [MIN_DEBUG_RAYS, MAX_DEBUG_RAYS]
+    void setDebugRayCount(int count);
+    int getDebugRayCount() const;
     void toggle2DMode();
     bool is2DMode() const;
     void toggleRealRayTracing();
     bool isRealRayTracing() const;
+    void toggleParallelRendering();
+    bool isParallelRendering() const;
+    void setThreadCount(unsigned threadCount);
+    unsigned getThreadCount() const;
+    void setResolution(unsigned width, unsigned height);
+    void setPixelStep(int step);
+    int getPixelStep() const;
+    // Step the last frame of the active trace mode was traced at
+    int getSamplingStep() const;
+    
+    RenderSettings getSettings() const;
+    // Only settings that differ are changed, so unchanged ones keep the frame cache
+    void applySettings(const RenderSettings& settings);
+    
+    // Adaptive sampling refines a quadtree per tile instead of sampling every pixelStep;
+    // the threshold is the largest per-channel colour spread a block may be filled across
+    void toggleAdaptiveSampling();
+    void setAdaptiveSampling(bool enabled);
+    bool isAdaptiveSampling() const;
+    void setAdaptiveThreshold(int threshold);
+    int getAdaptiveThreshold() const;
+    
+    // Incremental rendering re-traces only pixels a scene change can affect
+    void toggleIncrementalRendering();
+    void setIncrementalRendering(bool enabled);
+    bool isIncrementalRendering() const;
+    // Forces the next traced frame to cover the whole buffer
+    void invalidateFrameCache();
+    
+    // Progressive rendering keeps refining a static ray-traced frame with jittered
+    // anti-aliasing and area-light samples, and starts over whenever the scene changes
+    void toggleProgressiveRendering();
+    void setProgressiveRendering(bool enabled);
+    bool isProgressiveRendering() const;
+    
+    // Temporal reprojection reuses the previous frame's light visibilities for samples whose
+    // surface point has only moved with its sphere, and traces the rest; adaptive sampling
+    // and progressive refinement of a static frame take precedence over it
+    void toggleTemporalReprojection();
+    void setTemporalReprojection(bool enabled);
+    bool isTemporalReprojection() const;
+    // Moving frames between two full traces; see ReprojectionCache
+    void setReprojectionRefreshInterval(int frames);
+    int getReprojectionRefreshInterval() const;
+    
+    // The frame governor coarsens each trace mode's sampling step while its trace times
+    // run over the mode's target and upscales the samples edge-aware; see FrameGovernor.
+    // Adaptive sampling and progressive refinement of a static frame are left alone.
+    void toggleFrameGovernor();
+    void setFrameGovernor(bool enabled);
+    bool isFrameGovernor() const;
+    void setFrameTargetMs(GovernedMode mode, float milliseconds);
+    float getFrameTargetMs(GovernedMode mode) const;
+    const FrameGovernor& getFrameGovernor() const;
+    
+    // Coverage anti-aliasing traces one sample per pixel and blends the pixels a hard edge
+    // crosses by the area on each side: the shadow wedge in the 2D mode, computed exactly
+    // per pixel, and sphere silhouettes in ray tracing; see Coverage
+    void toggleCoverageAntiAliasing();
+    void setCoverageAntiAliasing(bool enabled);
+    bool isCoverageAntiAliasing() const;
     
 private:
+    void traceRealRayTracingFrame(const Scene& scene);
+    void updateDirtyRegion(const Scene& scene);
+    void addRayTracingChanges(const Scene& scene);
+    void add2DChanges(const Scene& scene);
+    void cacheSceneState(const Scene& scene);
+    sf::Color calculate2DLitColor(float distance) const;
+    // Redraws the pixels of row y the wedge's edges cross, blending lit and shadow colours
+    // by the pixel area inside the wedge
+    void blendShadowEdges(const ShadowWedge& wedge, const Tile& tile, int y, const sf::Vector2f& lightPos,
+                          const sf::Color& shadowColor);
+    int findShadowSpans(const ShadowWedge& wedge, int y, int firstX, int sampleCount, int* spanStart, int* spanEnd) const;
+    // Intersects the rays in debugRayBatch as one batch and adds them to debugRays,
+    // coloured by rayColor(index, end)
+    template <typename RayColor>
+    void addTracedRays(const Scene& scene, float thickness, RayColor rayColor);
+    
+
     float ambientLight;
     float diffuseIntensity;
     float maxLightDistance;
+    int pixelStep;
+    int frameStep; // pixelStep, or the governed step, for the 2D frame being traced
     bool showDebugInfo;
     bool is2DModeEnabled;
     bool isRealRayTracingEnabled;
+    bool isParallelRenderingEnabled;
+    bool isIncrementalRenderingEnabled;
+    bool isAdaptiveSamplingEnabled;
+    bool isProgressiveRenderingEnabled;
+    bool isTemporalReprojectionEnabled;
+    bool isFrameGovernorEnabled;
+    bool isCoverageAntiAliasingEnabled;
+    int adaptiveThreshold;
     RayDisplayMode rayDisplayMode;
+    int debugRayCount;
     RayTracer rayTracer;
+    FrameBuffer frameBuffer;
+    ThreadPool threadPool;
+    DirtyRegion dirtyRegion;
+    AccumulationBuffer accumulation;
+    ReprojectionCache reprojection;
+    FrameGovernor governor;
+    // Reused every frame the debug rays are shown
+    RayBatch debugRayBatch;
+    std::vector<RayHit> debugHits;
+    DebugRays debugRays;
+    
+    // State the framebuffer contents were traced from
+    bool hasCachedFrame;
+    bool sceneChanged; // Since the previous traced frame, regardless of the incremental setting
+    bool cachedRealRayTracing;
+    int cachedPixelStep;
+    int cachedAdaptiveThreshold; // -1 when the frame used fixed steps
+    unsigned cachedWidth;
+    unsigned cachedHeight;
+    uint64_t cachedRevision;
+    std::vector<sf::Vector3f> cachedSpheres; // x, y, radius
+    std::vector<SurfaceType> cachedSurfaces;
+    std::vector<sf::Vector2f> cachedLights;
 }; 
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "framebuffer.hpp"
+#include "renderer.hpp"
+#include "scene.hpp"
+
+// Traces frames on a dedicated thread so a slow trace never blocks the event loop.
+// The main thread submits copies of the scene and render settings and keeps running;
+// the render thread always traces the newest submission into its own renderer.
+// Finished frames are handed over through three framebuffers: the render thread
+// fills one, one holds the newest finished frame, and the main thread shows the
+// third, so neither side ever waits for the other.
+class RenderThread {
+public:
+    RenderThread(unsigned width, unsigned height);
+    ~RenderThread();
+    
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+    
+    // Copies the scene as an immutable snapshot for the next trace and returns at once;
+    // a snapshot the render thread has not started yet is replaced. Repeating the last
+    // revision with the same settings costs nothing.
+    void submit(const Scene& scene, const RenderSettings& settings);
+    // Draws the newest finished frame; false while no frame has finished yet
+    bool present(sf::RenderWindow& window);
+    
+    uint64_t getCompletedFrameCount() const;
+
+private:
+    void run();
+    // Copies the rows each buffer is missing into the write buffer and swaps it with the
+    // ready one; true when the trace changed any pixels
+    bool publishFrame();
+    
+    // Owned by the render thread
+    Renderer renderer;
+    Scene workingScene;
+    RenderSettings workingSettings;
+    int dirtyTop[3]; // Rows each buffer lacks compared to the renderer's framebuffer
+    int dirtyBottom[3];
+    int writeSlot;
+    bool isRefining; // Progressive passes are still improving the working scene
+    
+    // Owned by the main thread
+    int displaySlot;
+    bool hasDisplayFrame;
+    bool hasSubmitted;
+    uint64_t submittedRevision;
+    RenderSettings submittedSettings;
+    
+    // Shared, guarded by the mutex
+    mutable std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::vector<FrameBuffer> slots;
+    Scene pendingScene;
+    RenderSettings pendingSettings;
+    int readySlot;
+    bool hasPendingScene;
+    bool hasReadyFrame;
+    bool stopping;
+    uint64_t completedFrames;
+    
+    std::thread thread;
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+#include "ray.hpp"
+#include "sphere.hpp"
+#include "light.hpp"
+
+class Scene;
+
+// Light visibilities of the previous frame's samples, kept so a moving frame can reuse them.
+//
+// Visibility (the soft shadow query against the acceleration structure) is the costly
+// part of shading a diffuse hit; the rest only needs the hit and the light positions.
+// Each frame the camera rays are still intersected and every hit is shaded with the
+// current positions, but a diffuse hit takes its visibilities from the previous frame's
+// sample of the same surface point, found by moving the point back with its sphere, when:
+// - the point was not on an object or shadow edge;
+// - no light has turned by more than MAX_LIGHT_DRIFT radians as seen from it since the
+//   visibilities were computed, and no partly visible light has moved relative to it;
+// - the moving sphere's silhouette has turned by less than the rest of that angle, or
+//   cannot have shadowed it then or now; for a point on the moving sphere, every other
+//   sphere has turned as little or could not shadow it then or now.
+// Other samples (disoccluded, edge, specular or failing a test) are traced again.
+//
+// Only the first sphere and the lights are expected to move; any other scene change
+// starts over. Reused visibilities lag behind while the lights move, so the whole frame
+// is traced again after refreshInterval moving frames, and once the scene comes to rest.
+class ReprojectionCache {
+public:
+    static constexpr int DEFAULT_REFRESH_INTERVAL = 30;
+    static constexpr int MAX_REFRESH_INTERVAL = 240;
+    // Shadow edges shift with the angle a light or occluder turns by as seen from a point;
+    // within this many radians they move less than the edge test's one-sample margin in most scenes
+    static constexpr float MAX_LIGHT_DRIFT = 0.01f;
+    
+    struct Sample {
+        sf::Vector2f hitOffset; // Hit point relative to the hit sphere's center
+        int object; // Hit sphere, -1 for a miss
+        uint32_t state; // Sample state of the shading; differs across object and shadow edges
+        int tracedStep; // Motion step the visibilities were computed at
+    };
+    
+    ReprojectionCache();
+    
+    // Clamped to [1, MAX_REFRESH_INTERVAL]
+    void setRefreshInterval(int frames);
+    int getRefreshInterval() const;
+    // The next frame is traced in full
+    void invalidate();
+    
+    // Starts a frame on a grid of one sample per pixelStep block, seen from cameraPosition.
+    // shadingKey identifies the tracer settings shading depends on. Returns false when
+    // nothing can be reused, so every sample must be traced.
+    bool beginFrame(const Scene& scene, unsigned width, unsigned height, int pixelStep,
+                    const sf::Vector2f& cameraPosition, uint32_t shadingKey);
+    
+    // The current frame's sample and its visibility per light; tiles write disjoint
+    // samples, so threads may share the cache
+    Sample& getSample(int sampleX, int sampleY);
+    float* getVisibilities(int sampleX, int sampleY);
+    // Previous frame's sample whose visibilities hold for the diffuse hit of the camera ray
+    // at (sampleX, sampleY); null when they must be computed again
+    const Sample* findReusable(const RayHit& hit, int sampleX, int sampleY, const Scene& scene) const;
+    const float* getPreviousVisibilities(const Sample& previous) const;
+    int getPixelStep() const;
+    // Motion step to record in samples whose visibilities are computed this frame
+    int getCurrentStep() const;
+
+private:
+    // Positions at one motion step, in motionPositions from first: the first sphere's
+    // center, then every light
+    struct MotionState {
+        size_t first;
+        bool sphereExposed; // No other sphere could shadow the first one from any light
+        float occluderGap; // Between the first sphere's surface and the nearest other one
+    };
+    
+    bool hasStructuralChange(const Scene& scene) const;
+    void recordMotion(const Scene& scene);
+    bool isEdge(const Sample& sample, int sampleX, int sampleY) const;
+    bool isLightingValid(const RayHit& hit, const Sample& previous, const Scene& scene) const;
+    
+    int refreshInterval;
+    bool hasFrame;
+    bool canReuse; // This frame
+    unsigned width;
+    unsigned height;
+    int pixelStep;
+    int columns;
+    int rows;
+    size_t lightCount;
+    sf::Vector2f cameraPosition;
+    uint32_t shadingKey;
+    std::vector<Sample> samples;
+    std::vector<Sample> previousSamples;
+    std::vector<float> visibilities; // lightCount per sample
+    std::vector<float> previousVisibilities;
+    
+    // Scene the samples were traced from
+    const Scene* cachedScene;
+    uint64_t cachedRevision;
+    std::vector<Sphere> cachedSpheres;
+    std::vector<Light> cachedLights;
+    sf::Vector2f sphereMotion; // Of the first sphere since the previous frame
+    
+    // One entry per frame the scene moved since the last full trace; the first is that trace
+    std::vector<MotionState> motionSteps;
+    std::vector<sf::Vector2f> motionPositions;
+};
+
+inline ReprojectionCache::Sample& ReprojectionCache::getSample(int sampleX, int sampleY) {
+    return samples[static_cast<size_t>(sampleY) * columns + sampleX];
+}
+
+inline float* ReprojectionCache::getVisibilities(int sampleX, int sampleY) {
+    return visibilities.data() + (static_cast<size_t>(sampleY) * columns + sampleX) * lightCount;
+}
@@ -1,8 +1,20 @@
 #pragma once
 #include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
 #include "sphere.hpp"
 #include "light.hpp"
 #include "utils.hpp"
+#include "bvh.hpp"
+#include "uniformgrid.hpp"
+#include "threadpool.hpp"
+
+// Spatial index the ray tracer queries; the BVH suits mostly static scenes, the
+// grid scenes where many spheres move every frame
+enum class AccelerationStructure {
+    BVH,
+    GRID
+};
 
 class Scene {
 public:
@@ -12,14 +24,49 @@ public:
     void handleInput(const sf::Vector2i& mousePos, bool leftPressed, bool rightPressed, 
                      bool upPressed, bool downPressed);
     
+    // Scene construction; the first sphere and light are the interactive ones
+    void addSphere(const Sphere& sphere);
+    void addSpheres(const std::vector<Sphere>& newSpheres); // Rebuilds the BVH once
+    void addLight(const Light& light);
+    // Replaces every sphere and light. A BVH already built over the new spheres is
+    // adopted instead of building one when the BVH is the selected structure.
+    void setContents(std::vector<Sphere> newSpheres, std::vector<Light> newLights, const BVH* prebuiltBVH = nullptr);
+    void setSpherePosition(const sf::Vector2f& position);
+    void setLightPosition(const sf::Vector2f& position);
+    void setSphereSurface(SurfaceType surface);
+    // Moves every sphere at once, rebuilding the acceleration structure once
+    void setSpherePositions(const std::vector<sf::Vector2f>& positions);
+    
+    // Only the selected structure is kept up to date; switching rebuilds it
+    void setAccelerationStructure(AccelerationStructure structure);
+    AccelerationStructure getAccelerationStructure() const;
+    // Pool used to rebuild the grid in parallel; null builds it serially
+    void setThreadPool(ThreadPool* pool);
+    
     // Getter methods for renderer access
     const Sphere& getSphere() const;
     const Light& getLight() const;
+    const std::vector<Sphere>& getSpheres() const;
+    const std::vector<Light>& getLights() const;
+    const BVH& getBVH() const;
+    const UniformGrid& getGrid() const;
+    
+    // Increases whenever a sphere or light changes, so renderers can cache results
+    uint64_t getRevision() const;
     
 private:
-    Sphere sphere;
-    Light light;
+    void rebuildAccelerationStructure();
+    // After one sphere moved; refits the BVH until its quality calls for a rebuild
+    void updateAccelerationStructure(int sphereIndex);
+    
+    std::vector<Sphere> spheres;
+    std::vector<Light> lights;
+    AccelerationStructure accelerationStructure;
+    BVH bvh;
+    UniformGrid grid;
+    ThreadPool* threadPool;
     float moveSpeed;
     float smoothness;
     sf::Vector2f targetPosition;
-}; 
\ No newline at end of file
+    uint64_t revision;
+};
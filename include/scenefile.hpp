@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "sphere.hpp"
+#include "light.hpp"
+#include "scene.hpp"
+
+// Versioned binary scene files, opened through a read-only memory mapping.
+//
+// A fixed little-endian header is followed by 64-byte aligned sections:
+// - sphere centers x, centers y and radii, one float per sphere each
+// - sphere materials, four bytes each: sRGB red, green and blue, then the SurfaceType
+// - lights, twelve bytes each: x and y as floats, then sRGB red, green, blue and alpha
+// - optionally a BVH: its nodes, the sphere index of each leaf slot, and the leaf-order
+//   centers and squared radii padded as SphereSoA keeps them
+// This is a binary loader, not a zero-copy one: every sphere and light is copied into
+// the scene's objects, which the shading reads. Only a stored BVH is used from the
+// mapping, saving the build, until the interactive sphere first moves and the refit
+// copies it into owned arrays.
+//
+// Text scenes, the source format for conversion, have one item per line, '#' starting a comment:
+//   sphere X Y RADIUS [diffuse|mirror|glass] [R G B]
+//   light X Y [R G B]
+namespace SceneFile {
+    constexpr uint32_t VERSION = 1;
+    
+    // Stores the scene's BVH with it when includeBVH is set, building one if the scene uses the grid
+    bool save(const std::string& path, const Scene& scene, bool includeBVH, std::string& error);
+    // Replaces the scene's contents; the mapping lives as long as the scene's BVH, or a copy, uses it.
+    // A stored BVH that is not a traversable tree is ignored and a new one built.
+    bool load(const std::string& path, Scene& scene, std::string& error);
+    
+    // Scenes need at least one sphere and one light; the first of each is the interactive one
+    bool parseText(const std::string& path, std::vector<Sphere>& spheres, std::vector<Light>& lights, std::string& error);
+}
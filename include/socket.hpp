@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Blocking stream socket over TCP or a Unix domain socket (BSD sockets, or Winsock
+// on Windows). Addresses are "tcp:HOST:PORT", where an empty or "*" host listens on
+// every interface, or "unix:PATH"; Unix sockets are not available on Windows.
+class Socket {
+public:
+    Socket();
+    ~Socket();
+    
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+    Socket(Socket&& other) noexcept;
+    Socket& operator=(Socket&& other) noexcept;
+    
+    // Replace any open socket; listening on a Unix path removes a stale socket file first
+    bool listen(const std::string& address, std::string& error);
+    bool connect(const std::string& address, std::string& error);
+    bool accept(Socket& client, std::string& error);
+    void close();
+    bool isOpen() const;
+    
+    // Sends or receives exactly size bytes; false on error, timeout or a closed peer
+    bool sendAll(const void* data, size_t size);
+    bool receiveAll(void* data, size_t size);
+    // Limits how long one send or receive may block, 0 for no limit
+    void setTimeout(int milliseconds);
+    
+    // Waits until at least one socket is readable (or a listening socket has a pending
+    // connection, or a peer closed) or the timeout passes; -1 waits forever.
+    // readable receives one flag per socket; returns false when none became ready.
+    static bool waitReadable(const std::vector<Socket*>& sockets, int timeoutMs, std::vector<char>& readable);
+
+private:
+#if defined(_WIN32)
+    typedef unsigned long long Handle; // SOCKET
+#else
+    typedef int Handle;
+#endif
+
+    Handle handle;
+    std::string unixPath; // Socket file to remove when a listening Unix socket closes
+};
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Non-owning view of contiguous elements, standing in for std::span (C++20).
+// Batched APIs take spans so callers keep ownership of, and reuse, their buffers.
+template <typename T>
+class Span {
+public:
+    Span() : first(nullptr), count(0) {}
+    Span(T* data, size_t size) : first(data), count(size) {}
+    
+    // Vectors and spans of U convert when U* converts to T*, e.g. to a span of const
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    Span(std::vector<U>& values) : first(values.data()), count(values.size()) {}
+    template <typename U, typename = std::enable_if_t<std::is_convertible<const U*, T*>::value>>
+    Span(const std::vector<U>& values) : first(values.data()), count(values.size()) {}
+    template <typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    Span(const Span<U>& other) : first(other.data()), count(other.size()) {}
+    
+    T* data() const { return first; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t index) const { return first[index]; }
+    T* begin() const { return first; }
+    T* end() const { return first + count; }
+    
+    Span subspan(size_t offset, size_t length) const {
+        return Span(first + offset, length);
+    }
+
+private:
+    T* first;
+    size_t count;
+};
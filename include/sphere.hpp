@@ -3,6 +3,13 @@
 #include "utils.hpp"
 #include "ray.hpp"
 
+// How a sphere's surface responds to light in the ray tracing mode
+enum class SurfaceType {
+    DIFFUSE,
+    MIRROR,
+    GLASS
+};
+
 class Sphere {
 public:
     Sphere(const sf::Vector2f& position, float radius);
@@ -15,9 +22,24 @@ public:
     RayHit intersect(const Ray& ray) const;
     sf::Vector2f getNormal(const sf::Vector2f& point) const;
     sf::Color getMaterial() const;
+    void setMaterial(const sf::Color& color);
     
+    // Reflectivity and transparency are the fractions of light mirrored and
+    // transmitted (before Fresnel); the rest is lit diffusely
+    void setSurface(SurfaceType type);
+    SurfaceType getSurface() const;
+    float getReflectivity() const;
+    float getTransparency() const;
+    float getRefractiveIndex() const;
+    // Whether rays hitting the sphere spawn secondary rays
+    bool isSpecular() const;
+
 private:
     float radius;
     sf::Vector2f position;
     sf::Color material; // Material properties for ray tracing
+    SurfaceType surface;
+    float reflectivity;
+    float transparency;
+    float refractiveIndex;
 };
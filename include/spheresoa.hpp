@@ -0,0 +1,57 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "ray.hpp"
+#include "sphere.hpp"
+
+enum class SimdLevel {
+    SCALAR,
+    SSE,
+    AVX2
+};
+
+// Structure-of-arrays copy of sphere geometry for the vectorized intersection kernels.
+// Spheres are stored in the order given at assignment (BVH leaf order), and the
+// arrays are padded by one full vector so kernels can always load eight lanes.
+// All kernels assume unit ray directions, which the Ray constructor guarantees.
+class SphereSoA {
+public:
+    static constexpr int LANES = 8;
+    
+    SphereSoA();
+    
+    void assign(const std::vector<Sphere>& spheres, const std::vector<int>& order);
+    // Uses arrays laid out as assign() leaves them, padding included, in place
+    // instead of copying them; storage keeps their memory alive in every copy
+    void view(const float* centerX, const float* centerY, const float* radiusSquared, int count,
+              std::shared_ptr<const void> storage);
+    // Overwrites one entry; a view is copied into owned arrays first
+    void set(int index, const Sphere& sphere);
+    int size() const;
+    // Arrays of size() + LANES entries, for saving and viewing
+    const float* getCenterX() const;
+    const float* getCenterY() const;
+    const float* getRadiusSquared() const;
+    
+    // One ray against spheres [first, first + count), count <= LANES.
+    // Returns the offset of the closest hit with distance in (0, maxDistance], or -1.
+    int intersectClosest(const Ray& ray, int first, int count, float maxDistance, float& distance) const;
+    bool intersectAny(const Ray& ray, int first, int count, float maxDistance) const;
+    
+    // Kernel selection; defaults to the best level the CPU supports
+    static SimdLevel detectSimdLevel();
+    static SimdLevel getSimdLevel();
+    static void setSimdLevel(SimdLevel level);
+    static const char* getSimdLevelName(SimdLevel level);
+    
+private:
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> radiusSquared;
+    // Set while viewing external arrays instead of the vectors above
+    const float* viewCenterX;
+    const float* viewCenterY;
+    const float* viewRadiusSquared;
+    std::shared_ptr<const void> viewStorage;
+    int count;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent work-stealing thread pool.
+// Each worker owns a queue of work items; idle workers steal from the back
+// of other queues so uneven tiles (e.g. around the sphere) balance out.
+// The calling thread takes part in the work as worker 0.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // Runs task(i) for every i in [0, count) and blocks until all are done.
+    // The task is only referenced, never copied, so a call does not allocate.
+    template <typename Task>
+    void parallelFor(int count, const Task& task);
+    
+    // 0 selects the number of hardware threads
+    void setThreadCount(unsigned threadCount);
+    unsigned getThreadCount() const;
+    // Largest thread count worth asking for: a few threads per hardware thread
+    static unsigned getMaxThreadCount();
+    
+private:
+    static constexpr unsigned MAX_THREADS_PER_CORE = 4;
+    
+    // Type-erased reference to the caller's task
+    struct TaskReference {
+        const void* task;
+        void (*invoke)(const void* task, int index);
+    };
+    
+    struct WorkQueue {
+        std::mutex mutex;
+        // Remaining items [next, end); the owner takes the front, thieves the back
+        int next;
+        int end;
+    };
+    
+    void run(int count, const TaskReference& task);
+    void startWorkers(unsigned threadCount);
+    void stopWorkers();
+    void workerLoop(unsigned index);
+    void drainQueues(unsigned index);
+    bool popOrSteal(unsigned index, int& item);
+    
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    
+    std::mutex stateMutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    const TaskReference* currentTask;
+    std::atomic<int> pendingItems;
+    uint64_t generation;
+    bool stopping;
+};
+
+template <typename Task>
+void ThreadPool::parallelFor(int count, const Task& task) {
+    const TaskReference reference = { &task, [](const void* erased, int index) {
+        (*static_cast<const Task*>(erased))(index);
+    } };
+    run(count, reference);
+}
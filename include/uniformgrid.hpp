@@ -0,0 +1,127 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "ray.hpp"
+#include "sphere.hpp"
+#include "spheresoa.hpp"
+#include "threadpool.hpp"
+
+// Uniform 2D grid over the scene spheres, an alternative to the BVH for scenes
+// where most spheres move every frame. Building is a counting sort into square
+// cells, O(n) and without any tree to refit. Each sphere is listed in every cell
+// its bounding box overlaps; the cell lists are stored back to back, with the
+// sphere geometry copied in the same order into a SphereSoA for the SIMD kernels.
+class UniformGrid {
+public:
+    UniformGrid();
+    
+    // The counting and scatter passes run in chunks on the pool when one is given;
+    // the cell lists keep sphere order either way
+    void build(const std::vector<Sphere>& spheres, ThreadPool* threadPool = nullptr);
+    // Walks the cells along the ray (Amanatides-Woo DDA) and stops at the first
+    // cell that ends beyond the closest hit found so far
+    RayHit intersect(const Ray& ray, const std::vector<Sphere>& spheres) const;
+    // Stops at the first cell holding a blocking sphere
+    bool isOccluded(const Ray& ray) const;
+    // Same contract as BVH::queryAlongRay: visit(sphereIndex) once for each sphere
+    // in the cells within radius of the ray segment, rows nearest the origin first
+    template <typename Visitor>
+    void queryAlongRay(const Ray& ray, float radius, Visitor visit) const;
+    
+    int getCellCount() const;
+    // Cell list entries, counting a sphere once per cell it overlaps
+    int getEntryCount() const;
+
+private:
+    // Per-thread record of the spheres a query has already visited
+    struct VisitMarks {
+        std::vector<uint32_t> stamps;
+        uint32_t query;
+    };
+    static VisitMarks& beginQuery(int sphereCount);
+    
+    // Slab test against the grid bounds, limited to [0, maxDistance]
+    bool clipRay(const Ray& ray, float maxDistance, float& tEnter, float& tExit) const;
+    template <typename CellVisitor>
+    void walkCells(const Ray& ray, float tEnter, float tExit, CellVisitor visit) const;
+    int cellColumn(float x) const;
+    int cellRow(float y) const;
+    
+    sf::Vector2f boundsMin;
+    sf::Vector2f boundsMax;
+    float cellSize;
+    float inverseCellSize;
+    int cellsX;
+    int cellsY;
+    int sphereCount;
+    std::vector<int> cellStart; // Entry range of cell i is [cellStart[i], cellStart[i + 1])
+    std::vector<int> cellSpheres;
+    std::vector<int> chunkCounts; // Build scratch: per-chunk cell counts, then write cursors
+    SphereSoA sphereData;
+};
+
+template <typename Visitor>
+void UniformGrid::queryAlongRay(const Ray& ray, float radius, Visitor visit) const {
+    if (cellSpheres.empty()) {
+        return;
+    }
+    VisitMarks& marks = beginQuery(sphereCount);
+    
+    // Rows the capsule around the segment can reach, walked away from the origin
+    const sf::Vector2f end = ray.getPointAtDistance(ray.maxDistance);
+    const float top = std::min(ray.origin.y, end.y) - radius;
+    const float bottom = std::max(ray.origin.y, end.y) + radius;
+    if (bottom < boundsMin.y || top > boundsMax.y) {
+        return;
+    }
+    const int firstRow = cellRow(top);
+    const int lastRow = cellRow(bottom);
+    const bool rowsUp = ray.direction.y < 0.0f;
+    const bool columnsLeft = ray.direction.x < 0.0f;
+    
+    for (int i = 0; i <= lastRow - firstRow; ++i) {
+        const int row = rowsUp ? lastRow - i : firstRow + i;
+        
+        // Part of the segment within radius of the row, widened by the radius
+        const float rowTop = boundsMin.y + static_cast<float>(row) * cellSize - radius;
+        const float rowBottom = rowTop + cellSize + 2.0f * radius;
+        float tLow = 0.0f;
+        float tHigh = ray.maxDistance;
+        if (ray.direction.y != 0.0f) {
+            const float t1 = (rowTop - ray.origin.y) / ray.direction.y;
+            const float t2 = (rowBottom - ray.origin.y) / ray.direction.y;
+            tLow = std::max(tLow, std::min(t1, t2));
+            tHigh = std::min(tHigh, std::max(t1, t2));
+        } else if (ray.origin.y < rowTop || ray.origin.y > rowBottom) {
+            continue;
+        }
+        if (tLow > tHigh) {
+            continue;
+        }
+        const float x1 = ray.origin.x + ray.direction.x * tLow;
+        const float x2 = ray.origin.x + ray.direction.x * tHigh;
+        const float left = std::min(x1, x2) - radius;
+        const float right = std::max(x1, x2) + radius;
+        if (right < boundsMin.x || left > boundsMax.x) {
+            continue;
+        }
+        const int firstColumn = cellColumn(left);
+        const int lastColumn = cellColumn(right);
+        
+        for (int j = 0; j <= lastColumn - firstColumn; ++j) {
+            const int cell = row * cellsX + (columnsLeft ? lastColumn - j : firstColumn + j);
+            for (int entry = cellStart[cell]; entry < cellStart[cell + 1]; ++entry) {
+                const int sphere = cellSpheres[entry];
+                if (marks.stamps[sphere] == marks.query) {
+                    continue; // Already visited through another cell
+                }
+                marks.stamps[sphere] = marks.query;
+                if (!visit(sphere)) {
+                    return;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "framebuffer.hpp"
+#include "radiancebuffer.hpp"
+#include "threadpool.hpp"
+
+// Edge-aware upscaling of frames traced at one sample per step x step block.
+//
+// The trace paths fill each block with the colour of the sample at its top-left
+// pixel. Upscaling replaces the other pixels with a bilinear interpolation of the
+// four samples around them, leaving out samples whose colour differs from the
+// nearest one by more than EDGE_THRESHOLD. Gradients come out smooth, while
+// silhouettes and shadow edges stay sharp and move halfway between their samples
+// instead of to the block border. Only sample pixels are read, so rows can be
+// upscaled again at any time with the same result.
+namespace Upscaling {
+    // Per-channel difference in 0-255 steps, measured like AdaptiveSampling::colorSpread
+    constexpr int EDGE_THRESHOLD = 16;
+    
+    // Upscales every block that covers or interpolates from rows [top, bottom) and
+    // widens the range to the rows it changed, for the caller to resolve or upload
+    void upscaleRows(RadianceBuffer& buffer, int step, int& top, int& bottom, ThreadPool* threadPool = nullptr);
+    void upscaleRows(FrameBuffer& buffer, int step, int& top, int& bottom, ThreadPool* threadPool = nullptr);
+}
@@ -5,15 +5,26 @@ namespace Utils {
     constexpr int WINDOW_WIDTH = 1280;
     constexpr int WINDOW_HEIGHT = 720;
     constexpr int FRAME_RATE_LIMIT = 120;
+    constexpr int RENDER_TILE_SIZE = 32; // Must stay a multiple of every pixelStep
+    constexpr int MAX_FRAME_SIZE = 16384; // Pixels per side of a rendered frame
+    constexpr int DISTRIBUTED_TILE_SIZE = 128; // One job for a render worker; a multiple of RENDER_TILE_SIZE
     
     constexpr float DEFAULT_MOVE_SPEED = 5.0f;
     constexpr float DEFAULT_SMOOTHNESS = 0.1f;
     constexpr float LIGHT_RADIUS = 30.0f;
     constexpr float SPHERE_RADIUS = 100.0f;
+    constexpr float SHADOW_BIAS = 0.01f; // Lifts shadow rays off the surface they start on
+    constexpr int MAX_ACCUMULATED_SAMPLES = 64; // Progressive passes before a tile counts as converged
+    constexpr int MIN_DEBUG_RAYS = 36; // Range of the all-directions debug ray count
+    constexpr int MAX_DEBUG_RAYS = 100000;
     
     const sf::Color BACKGROUND_COLOR = sf::Color::Black;
     const sf::Color LIGHT_COLOR = sf::Color(255, 255, 200);
     
     float calculateDistance(const sf::Vector2f& pos1, const sf::Vector2f& pos2);
     float clamp(float value, float min, float max);
+    // Unit directions of the two tangent lines from apex to the circle, and of its axis;
+    // false, with only distance set, when the apex is inside the circle
+    bool getTangentDirections(const sf::Vector2f& apex, const sf::Vector2f& center, float radius,
+                              sf::Vector2f& first, sf::Vector2f& second, sf::Vector2f& axis, float& distance);
 } 
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "../include/accumulationbuffer.hpp"
+#include <algorithm>
+
+AccumulationBuffer::AccumulationBuffer()
+    : width(0)
+    , height(0)
+    , tileSize(1) {
+}
+
+void AccumulationBuffer::resize(unsigned newWidth, unsigned newHeight, int newTileSize) {
+    if (newWidth == width && newHeight == height && newTileSize == tileSize) {
+        return;
+    }
+    width = newWidth;
+    height = newHeight;
+    tileSize = newTileSize;
+    sums.assign(static_cast<size_t>(width) * height * 3, 0.0f);
+    
+    int tilesX = (static_cast<int>(width) + tileSize - 1) / tileSize;
+    int tilesY = (static_cast<int>(height) + tileSize - 1) / tileSize;
+    tileSamples.assign(static_cast<size_t>(tilesX) * tilesY, 0);
+}
+
+void AccumulationBuffer::reset() {
+    std::fill(tileSamples.begin(), tileSamples.end(), 0);
+}
+
+void AccumulationBuffer::resetTile(int tileIndex) {
+    tileSamples[tileIndex] = 0;
+}
+
+void AccumulationBuffer::finishTile(RadianceBuffer& radiance, const Tile& tile, int tileIndex) {
+    const int samples = ++tileSamples[tileIndex];
+    const float scale = 1.0f / static_cast<float>(samples);
+    
+    for (int y = tile.y; y < tile.y + tile.height; ++y) {
+        const float* sum = &sums[(static_cast<size_t>(y) * width + tile.x) * 3];
+        for (int x = tile.x; x < tile.x + tile.width; ++x, sum += 3) {
+            // Averaged in linear light; tonemapping happens once per frame on the result
+            radiance.setPixel(x, y, LinearColor(sum[0] * scale, sum[1] * scale, sum[2] * scale));
+        }
+    }
+}
+
+int AccumulationBuffer::getSampleCount(int tileIndex) const {
+    return tileSamples[tileIndex];
+}
+
+int AccumulationBuffer::getTileCount() const {
+    return static_cast<int>(tileSamples.size());
+}
+
+int AccumulationBuffer::getTileSize() const {
+    return tileSize;
+}
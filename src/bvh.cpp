@@ -0,0 +1,451 @@
+#include "../include/bvh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace {
+    constexpr int SAH_BINS = 12;
+    constexpr int MAX_LEAF_SIZE = SphereSoA::LANES;
+    
+    struct StackEntry {
+        int node;
+        float distance;
+    };
+    
+    struct Bin {
+        sf::Vector2f boundsMin;
+        sf::Vector2f boundsMax;
+        int count;
+    };
+    
+    // Half perimeter is the 2D analogue of surface area for SAH costs
+    float halfPerimeter(const sf::Vector2f& boundsMin, const sf::Vector2f& boundsMax) {
+        sf::Vector2f extent = boundsMax - boundsMin;
+        return extent.x + extent.y;
+    }
+    
+    float axisOf(const sf::Vector2f& v, int axis) {
+        return axis == 0 ? v.x : v.y;
+    }
+    
+    // Slab test; returns the entry distance or infinity on a miss
+    float intersectBounds(const BVHNode& node, const sf::Vector2f& origin, const sf::Vector2f& invDir, float maxDistance) {
+        float tx1 = (node.boundsMin.x - origin.x) * invDir.x;
+        float tx2 = (node.boundsMax.x - origin.x) * invDir.x;
+        float tMin = std::min(tx1, tx2);
+        float tMax = std::max(tx1, tx2);
+        
+        float ty1 = (node.boundsMin.y - origin.y) * invDir.y;
+        float ty2 = (node.boundsMax.y - origin.y) * invDir.y;
+        tMin = std::max(tMin, std::min(ty1, ty2));
+        tMax = std::min(tMax, std::max(ty1, ty2));
+        
+        if (tMax >= tMin && tMax > 0 && tMin < maxDistance) {
+            return tMin;
+        }
+        return std::numeric_limits<float>::infinity();
+    }
+}
+
+BVH::BVH()
+    : viewNodes(nullptr)
+    , viewPrimitiveIndices(nullptr)
+    , viewNodeCount(0)
+    , builtCost(0.0)
+    , refitCost(0.0) {
+}
+
+void BVH::build(const std::vector<Sphere>& spheres) {
+    viewNodes = nullptr;
+    viewPrimitiveIndices = nullptr;
+    viewNodeCount = 0;
+    viewStorage.reset();
+    parentIndices.clear();
+    nodes.clear();
+    primitiveIndices.resize(spheres.size());
+    for (size_t i = 0; i < spheres.size(); ++i) {
+        primitiveIndices[i] = static_cast<int>(i);
+    }
+    
+    if (spheres.empty()) {
+        sphereData.assign(spheres, primitiveIndices);
+        return;
+    }
+    
+    nodes.reserve(spheres.size() * 2);
+    nodes.push_back({ sf::Vector2f(), sf::Vector2f(), 0, static_cast<int>(spheres.size()) });
+    updateBounds(0, spheres);
+    subdivide(0, 0, spheres);
+    
+    // Leaf ranges index the SoA copy directly
+    sphereData.assign(spheres, primitiveIndices);
+}
+
+void BVH::updateBounds(int nodeIndex, const std::vector<Sphere>& spheres) {
+    BVHNode& node = nodes[nodeIndex];
+    float inf = std::numeric_limits<float>::infinity();
+    node.boundsMin = sf::Vector2f(inf, inf);
+    node.boundsMax = sf::Vector2f(-inf, -inf);
+    
+    for (int i = 0; i < node.count; ++i) {
+        const Sphere& sphere = spheres[primitiveIndices[node.leftOrFirst + i]];
+        sf::Vector2f center = sphere.getPosition();
+        float radius = sphere.getRadius();
+        node.boundsMin.x = std::min(node.boundsMin.x, center.x - radius);
+        node.boundsMin.y = std::min(node.boundsMin.y, center.y - radius);
+        node.boundsMax.x = std::max(node.boundsMax.x, center.x + radius);
+        node.boundsMax.y = std::max(node.boundsMax.y, center.y + radius);
+    }
+}
+
+float BVH::findBestSplit(const BVHNode& node, const std::vector<Sphere>& spheres, int& axis, float& splitPos) const {
+    float bestCost = std::numeric_limits<float>::infinity();
+    
+    for (int a = 0; a < 2; ++a) {
+        // Bin by centroid, so the centroid extent defines the bin range
+        float centroidMin = std::numeric_limits<float>::infinity();
+        float centroidMax = -std::numeric_limits<float>::infinity();
+        for (int i = 0; i < node.count; ++i) {
+            float c = axisOf(spheres[primitiveIndices[node.leftOrFirst + i]].getPosition(), a);
+            centroidMin = std::min(centroidMin, c);
+            centroidMax = std::max(centroidMax, c);
+        }
+        if (centroidMin == centroidMax) {
+            continue;
+        }
+        
+        float inf = std::numeric_limits<float>::infinity();
+        Bin bins[SAH_BINS];
+        for (Bin& bin : bins) {
+            bin = { sf::Vector2f(inf, inf), sf::Vector2f(-inf, -inf), 0 };
+        }
+        
+        float scale = SAH_BINS / (centroidMax - centroidMin);
+        for (int i = 0; i < node.count; ++i) {
+            const Sphere& sphere = spheres[primitiveIndices[node.leftOrFirst + i]];
+            sf::Vector2f center = sphere.getPosition();
+            float radius = sphere.getRadius();
+            int binIndex = std::min(SAH_BINS - 1, static_cast<int>((axisOf(center, a) - centroidMin) * scale));
+            
+            Bin& bin = bins[binIndex];
+            bin.count++;
+            bin.boundsMin.x = std::min(bin.boundsMin.x, center.x - radius);
+            bin.boundsMin.y = std::min(bin.boundsMin.y, center.y - radius);
+            bin.boundsMax.x = std::max(bin.boundsMax.x, center.x + radius);
+            bin.boundsMax.y = std::max(bin.boundsMax.y, center.y + radius);
+        }
+        
+        // Sweep from both sides to get the cost of every bin boundary
+        float leftArea[SAH_BINS - 1];
+        float rightArea[SAH_BINS - 1];
+        int leftCount[SAH_BINS - 1];
+        int rightCount[SAH_BINS - 1];
+        
+        sf::Vector2f leftMin(inf, inf), leftMax(-inf, -inf);
+        sf::Vector2f rightMin(inf, inf), rightMax(-inf, -inf);
+        int leftSum = 0;
+        int rightSum = 0;
+        for (int i = 0; i < SAH_BINS - 1; ++i) {
+            const Bin& left = bins[i];
+            leftSum += left.count;
+            leftMin = sf::Vector2f(std::min(leftMin.x, left.boundsMin.x), std::min(leftMin.y, left.boundsMin.y));
+            leftMax = sf::Vector2f(std::max(leftMax.x, left.boundsMax.x), std::max(leftMax.y, left.boundsMax.y));
+            leftCount[i] = leftSum;
+            leftArea[i] = leftSum > 0 ? halfPerimeter(leftMin, leftMax) : 0.0f;
+            
+            const Bin& right = bins[SAH_BINS - 1 - i];
+            rightSum += right.count;
+            rightMin = sf::Vector2f(std::min(rightMin.x, right.boundsMin.x), std::min(rightMin.y, right.boundsMin.y));
+            rightMax = sf::Vector2f(std::max(rightMax.x, right.boundsMax.x), std::max(rightMax.y, right.boundsMax.y));
+            rightCount[SAH_BINS - 2 - i] = rightSum;
+            rightArea[SAH_BINS - 2 - i] = rightSum > 0 ? halfPerimeter(rightMin, rightMax) : 0.0f;
+        }
+        
+        for (int i = 0; i < SAH_BINS - 1; ++i) {
+            float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+            if (cost < bestCost) {
+                bestCost = cost;
+                axis = a;
+                splitPos = centroidMin + (i + 1) / scale;
+            }
+        }
+    }
+    
+    return bestCost;
+}
+
+void BVH::subdivide(int nodeIndex, int depth, const std::vector<Sphere>& spheres) {
+    BVHNode node = nodes[nodeIndex];
+    
+    // A full leaf is one vector test, which is cheaper than visiting two children
+    if (node.count <= MAX_LEAF_SIZE) {
+        return;
+    }
+    // Traversal keeps at most one pending sibling per level; deeper nodes stay
+    // oversized leaves, the same limit view checks saved trees against
+    if (depth >= TRAVERSAL_STACK_SIZE - 2) {
+        return;
+    }
+    
+    int axis = 0;
+    float splitPos = 0.0f;
+    float splitCost = findBestSplit(node, spheres, axis, splitPos);
+    if (!std::isfinite(splitCost)) {
+        return; // All centroids coincide
+    }
+    
+    // Partition the primitive range around the split plane
+    int i = node.leftOrFirst;
+    int j = i + node.count - 1;
+    while (i <= j) {
+        if (axisOf(spheres[primitiveIndices[i]].getPosition(), axis) < splitPos) {
+            ++i;
+        } else {
+            std::swap(primitiveIndices[i], primitiveIndices[j--]);
+        }
+    }
+    
+    int leftCount = i - node.leftOrFirst;
+    if (leftCount == 0 || leftCount == node.count) {
+        return;
+    }
+    
+    int leftChild = static_cast<int>(nodes.size());
+    nodes.push_back({ sf::Vector2f(), sf::Vector2f(), node.leftOrFirst, leftCount });
+    nodes.push_back({ sf::Vector2f(), sf::Vector2f(), i, node.count - leftCount });
+    
+    nodes[nodeIndex].leftOrFirst = leftChild;
+    nodes[nodeIndex].count = 0;
+    
+    updateBounds(leftChild, spheres);
+    updateBounds(leftChild + 1, spheres);
+    subdivide(leftChild, depth + 1, spheres);
+    subdivide(leftChild + 1, depth + 1, spheres);
+}
+
+bool BVH::view(const BVHNode* newNodes, int nodeCount, const int* newPrimitiveIndices, int sphereCount,
+               const SphereSoA& newSphereData, std::shared_ptr<const void> storage) {
+    if (nodeCount < 0 || sphereCount < 0 || newSphereData.size() != sphereCount || (nodeCount == 0) != (sphereCount == 0)) {
+        return false;
+    }
+    for (int i = 0; i < sphereCount; ++i) {
+        if (newPrimitiveIndices[i] < 0 || newPrimitiveIndices[i] >= sphereCount) {
+            return false;
+        }
+    }
+    
+    // Children must come after their parent, so every path ends, and no deeper than
+    // the traversal stack can hold; depths are filled in parent-first order
+    std::vector<int> depth(nodeCount, 0);
+    for (int i = 0; i < nodeCount; ++i) {
+        const BVHNode& node = newNodes[i];
+        if (node.count > 0) {
+            if (node.leftOrFirst < 0 || node.leftOrFirst > sphereCount - node.count) {
+                return false;
+            }
+            continue;
+        }
+        if (node.count < 0 || node.leftOrFirst <= i || node.leftOrFirst >= nodeCount - 1
+            || depth[i] + 1 >= TRAVERSAL_STACK_SIZE - 1) {
+            return false;
+        }
+        depth[node.leftOrFirst] = std::max(depth[node.leftOrFirst], depth[i] + 1);
+        depth[node.leftOrFirst + 1] = std::max(depth[node.leftOrFirst + 1], depth[i] + 1);
+    }
+    
+    std::vector<BVHNode>().swap(nodes);
+    std::vector<int>().swap(primitiveIndices);
+    viewNodes = newNodes;
+    viewPrimitiveIndices = newPrimitiveIndices;
+    viewNodeCount = nodeCount;
+    viewStorage = std::move(storage);
+    sphereData = newSphereData;
+    parentIndices.clear();
+    return true;
+}
+
+void BVH::prepareRefit() {
+    // Refits write the nodes, so a viewed tree becomes an owned copy
+    if (viewNodes) {
+        nodes.assign(viewNodes, viewNodes + viewNodeCount);
+        primitiveIndices.assign(viewPrimitiveIndices, viewPrimitiveIndices + sphereData.size());
+        viewNodes = nullptr;
+        viewPrimitiveIndices = nullptr;
+        viewNodeCount = 0;
+        viewStorage.reset();
+    }
+    
+    parentIndices.assign(nodes.size(), -1);
+    sphereLeaves.resize(primitiveIndices.size());
+    sphereSlots.resize(primitiveIndices.size());
+    builtCost = 0.0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const BVHNode& node = nodes[i];
+        builtCost += halfPerimeter(node.boundsMin, node.boundsMax);
+        if (node.count == 0) {
+            parentIndices[node.leftOrFirst] = static_cast<int>(i);
+            parentIndices[node.leftOrFirst + 1] = static_cast<int>(i);
+            continue;
+        }
+        for (int slot = node.leftOrFirst; slot < node.leftOrFirst + node.count; ++slot) {
+            sphereLeaves[primitiveIndices[slot]] = static_cast<int>(i);
+            sphereSlots[primitiveIndices[slot]] = slot;
+        }
+    }
+    refitCost = builtCost;
+}
+
+bool BVH::refit(int sphereIndex, const std::vector<Sphere>& spheres) {
+    if (getNodeCount() == 0) {
+        return false;
+    }
+    if (parentIndices.empty()) {
+        prepareRefit();
+    }
+    
+    sphereData.set(sphereSlots[sphereIndex], spheres[sphereIndex]);
+    
+    // Leaf bounds come from its spheres, so they shrink as well as grow
+    int nodeIndex = sphereLeaves[sphereIndex];
+    refitCost -= halfPerimeter(nodes[nodeIndex].boundsMin, nodes[nodeIndex].boundsMax);
+    updateBounds(nodeIndex, spheres);
+    refitCost += halfPerimeter(nodes[nodeIndex].boundsMin, nodes[nodeIndex].boundsMax);
+    
+    for (nodeIndex = parentIndices[nodeIndex]; nodeIndex >= 0; nodeIndex = parentIndices[nodeIndex]) {
+        BVHNode& node = nodes[nodeIndex];
+        const BVHNode& left = nodes[node.leftOrFirst];
+        const BVHNode& right = nodes[node.leftOrFirst + 1];
+        refitCost -= halfPerimeter(node.boundsMin, node.boundsMax);
+        node.boundsMin = sf::Vector2f(std::min(left.boundsMin.x, right.boundsMin.x),
+                                      std::min(left.boundsMin.y, right.boundsMin.y));
+        node.boundsMax = sf::Vector2f(std::max(left.boundsMax.x, right.boundsMax.x),
+                                      std::max(left.boundsMax.y, right.boundsMax.y));
+        refitCost += halfPerimeter(node.boundsMin, node.boundsMax);
+    }
+    
+    return refitCost <= builtCost * REFIT_COST_LIMIT;
+}
+
+RayHit BVH::intersect(const Ray& ray, const std::vector<Sphere>& spheres) const {
+    RayHit closest;
+    if (getNodeCount() == 0) {
+        return closest;
+    }
+    const BVHNode* nodeData = getNodes();
+    const int* primitiveData = getPrimitiveIndices();
+    
+    sf::Vector2f invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y);
+    float closestDistance = ray.maxDistance;
+    int closestIndex = -1;
+    
+    // Entry distances are kept on the stack so nodes are culled without a second slab test
+    StackEntry stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    float rootDistance = intersectBounds(nodeData[0], ray.origin, invDir, closestDistance);
+    if (rootDistance == std::numeric_limits<float>::infinity()) {
+        return closest;
+    }
+    stack[stackSize++] = { 0, rootDistance };
+    
+    while (stackSize > 0) {
+        StackEntry entry = stack[--stackSize];
+        if (entry.distance > closestDistance) {
+            continue; // A closer hit was found after this node was pushed
+        }
+        const BVHNode& node = nodeData[entry.node];
+        
+        if (node.count > 0) {
+            // Oversized leaves only occur when centroids coincide; test them in groups
+            for (int first = node.leftOrFirst; first < node.leftOrFirst + node.count; first += SphereSoA::LANES) {
+                int laneCount = std::min(SphereSoA::LANES, node.leftOrFirst + node.count - first);
+                float distance;
+                int lane = sphereData.intersectClosest(ray, first, laneCount, closestDistance, distance);
+                if (lane >= 0) {
+                    closestIndex = first + lane;
+                    closestDistance = distance;
+                }
+            }
+            continue;
+        }
+        
+        // Push the far child first so the near child is popped next
+        int nearChild = node.leftOrFirst;
+        int farChild = node.leftOrFirst + 1;
+        float nearDistance = intersectBounds(nodeData[nearChild], ray.origin, invDir, closestDistance);
+        float farDistance = intersectBounds(nodeData[farChild], ray.origin, invDir, closestDistance);
+        if (farDistance < nearDistance) {
+            std::swap(nearChild, farChild);
+            std::swap(nearDistance, farDistance);
+        }
+        
+        if (farDistance != std::numeric_limits<float>::infinity()) {
+            stack[stackSize++] = { farChild, farDistance };
+        }
+        if (nearDistance != std::numeric_limits<float>::infinity()) {
+            stack[stackSize++] = { nearChild, nearDistance };
+        }
+    }
+    
+    // Only the winning hit pays for the hit point and normal
+    if (closestIndex >= 0) {
+        int index = primitiveData[closestIndex];
+        sf::Vector2f hitPoint = ray.getPointAtDistance(closestDistance);
+        closest = RayHit(hitPoint, spheres[index].getNormal(hitPoint), closestDistance);
+        closest.objectIndex = index;
+    }
+    
+    return closest;
+}
+
+bool BVH::isOccluded(const Ray& ray) const {
+    if (getNodeCount() == 0) {
+        return false;
+    }
+    const BVHNode* nodeData = getNodes();
+    
+    sf::Vector2f invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y);
+    
+    int stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    
+    // Any hit before maxDistance blocks the ray, so order does not matter
+    while (stackSize > 0) {
+        const BVHNode& node = nodeData[stack[--stackSize]];
+        if (intersectBounds(node, ray.origin, invDir, ray.maxDistance) == std::numeric_limits<float>::infinity()) {
+            continue;
+        }
+        
+        if (node.count > 0) {
+            for (int first = node.leftOrFirst; first < node.leftOrFirst + node.count; first += SphereSoA::LANES) {
+                int laneCount = std::min(SphereSoA::LANES, node.leftOrFirst + node.count - first);
+                if (sphereData.intersectAny(ray, first, laneCount, ray.maxDistance)) {
+                    return true;
+                }
+            }
+            continue;
+        }
+        
+        stack[stackSize++] = node.leftOrFirst;
+        stack[stackSize++] = node.leftOrFirst + 1;
+    }
+    
+    return false;
+}
+
+int BVH::getNodeCount() const {
+    return viewNodes ? viewNodeCount : static_cast<int>(nodes.size());
+}
+
+const BVHNode* BVH::getNodes() const {
+    return viewNodes ? viewNodes : nodes.data();
+}
+
+const int* BVH::getPrimitiveIndices() const {
+    return viewPrimitiveIndices ? viewPrimitiveIndices : primitiveIndices.data();
+}
+
+const SphereSoA& BVH::getSphereData() const {
+    return sphereData;
+}
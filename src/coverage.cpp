@@ -0,0 +1,149 @@
+#include "../include/coverage.hpp"
+#include "../include/profiler.hpp"
+#include "../include/utils.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Blends the source sample at (x, y) with the one at (otherX, otherY) by the given
+    // fraction of the pixel lying beyond the edge
+    void blendPixel(const RadianceBuffer& radiance, FrameBuffer& target, int x, int y, int otherX, int otherY,
+                    float beyond) {
+        const LinearColor own = radiance.getPixel(x, y);
+        const LinearColor other = radiance.getPixel(otherX, otherY);
+        target.setPixel(x, y, RadianceBuffer::resolveColor(own * (1.0f - beyond) + other * beyond));
+    }
+    
+    // One tangent line, starting at the camera. It is walked along its major axis; at
+    // each step the two pixels whose centres straddle it are the only ones it can cross.
+    void blendEdge(const RadianceBuffer& radiance, FrameBuffer& target, const sf::Vector2f& camera,
+                   const sf::Vector2f& direction, int top, int bottom) {
+        const int width = static_cast<int>(radiance.getWidth());
+        const int height = static_cast<int>(radiance.getHeight());
+        const sf::Vector2f normal(-direction.y, direction.x);
+        auto distanceTo = [&](int x, int y) {
+            const sf::Vector2f offset(static_cast<float>(x) - camera.x, static_cast<float>(y) - camera.y);
+            return std::abs(normal.x * offset.x + normal.y * offset.y);
+        };
+        
+        if (std::abs(direction.x) >= std::abs(direction.y)) {
+            const float slope = direction.y / direction.x;
+            // Only the columns where the line passes rows [top - 1, bottom] can reach the
+            // band; the line moves at most one row per column, so a column of margin is enough
+            int firstX = 0;
+            int endX = width;
+            if (slope != 0.0f) {
+                const float enter = camera.x + (static_cast<float>(top - 1) - camera.y) / slope;
+                const float leave = camera.x + (static_cast<float>(bottom + 1) - camera.y) / slope;
+                firstX = static_cast<int>(std::max(0.0f, std::floor(std::min(enter, leave)) - 1.0f));
+                endX = static_cast<int>(std::min(static_cast<float>(width), std::ceil(std::max(enter, leave)) + 2.0f));
+            }
+            for (int x = firstX; x < endX; ++x) {
+                const float offset = static_cast<float>(x) - camera.x;
+                if (offset * direction.x < 0.0f) {
+                    continue;
+                }
+                const int above = static_cast<int>(std::floor(camera.y + offset * slope));
+                if (above + 1 < top || above >= bottom || above < 0 || above + 1 >= height) {
+                    continue;
+                }
+                for (int y = above; y <= above + 1; ++y) {
+                    const float beyond = Coverage::halfPlane(-distanceTo(x, y), normal);
+                    if (y >= top && y < bottom && beyond > 0.0f) {
+                        blendPixel(radiance, target, x, y, x, y == above ? above + 1 : above, beyond);
+                    }
+                }
+            }
+            return;
+        }
+        
+        const float slope = direction.x / direction.y;
+        for (int y = std::max(top, 0); y < std::min(bottom, height); ++y) {
+            const float offset = static_cast<float>(y) - camera.y;
+            if (offset * direction.y < 0.0f) {
+                continue;
+            }
+            const int left = static_cast<int>(std::floor(camera.x + offset * slope));
+            if (left < 0 || left + 1 >= width) {
+                continue;
+            }
+            for (int x = left; x <= left + 1; ++x) {
+                const float beyond = Coverage::halfPlane(-distanceTo(x, y), normal);
+                if (beyond > 0.0f) {
+                    blendPixel(radiance, target, x, y, x == left ? left + 1 : left, y, beyond);
+                }
+            }
+        }
+    }
+}
+
+namespace Coverage {
+    float halfPlane(float distance, const sf::Vector2f& normal) {
+        const float major = std::max(std::abs(normal.x), std::abs(normal.y));
+        const float minor = std::min(std::abs(normal.x), std::abs(normal.y));
+        const float outer = 0.5f * (major + minor);
+        if (distance >= outer) {
+            return 1.0f;
+        }
+        if (distance <= -outer) {
+            return 0.0f;
+        }
+        // Between the two pixel corners the edge meets first, the covered width grows
+        // linearly; past them the uncovered corner is a right triangle
+        if (std::abs(distance) <= 0.5f * (major - minor)) {
+            return 0.5f + distance / major;
+        }
+        const float corner = outer - std::abs(distance);
+        const float triangle = corner * corner / (2.0f * major * minor);
+        return distance > 0.0f ? 1.0f - triangle : triangle;
+    }
+    
+    float halfWidth(const sf::Vector2f& normal) {
+        return 0.5f * (std::abs(normal.x) + std::abs(normal.y));
+    }
+    
+    void findSilhouettes(const std::vector<Sphere>& spheres, const sf::Vector2f& camera,
+                         std::vector<SilhouetteEdge>& edges) {
+        edges.clear();
+        for (const Sphere& sphere : spheres) {
+            sf::Vector2f first, second, axis;
+            float distance;
+            // A camera inside the sphere sees it everywhere
+            if (!Utils::getTangentDirections(camera, sphere.getPosition(), sphere.getRadius(), first, second, axis,
+                                             distance)) {
+                continue;
+            }
+            const float length = std::sqrt(distance * distance - sphere.getRadius() * sphere.getRadius());
+            edges.push_back({ first, length });
+            edges.push_back({ second, length });
+        }
+    }
+    
+    void blendSilhouettes(const RadianceBuffer& radiance, FrameBuffer& target, const std::vector<SilhouetteEdge>& edges,
+                          const sf::Vector2f& camera, int top, int bottom, ThreadPool* threadPool) {
+        PROFILE_ZONE("Coverage::blendSilhouettes");
+        top = std::max(top, 0);
+        bottom = std::min(bottom, static_cast<int>(radiance.getHeight()));
+        if (edges.empty() || top >= bottom) {
+            return;
+        }
+        
+        // A band only writes its own rows and reads the unblended samples, so bands are independent
+        const int bandHeight = Utils::RENDER_TILE_SIZE;
+        auto blendBand = [&](int index) {
+            const int bandTop = top + index * bandHeight;
+            const int bandBottom = std::min(bandTop + bandHeight, bottom);
+            for (const SilhouetteEdge& edge : edges) {
+                blendEdge(radiance, target, camera, edge.direction, bandTop, bandBottom);
+            }
+        };
+        const int bandCount = (bottom - top + bandHeight - 1) / bandHeight;
+        if (threadPool) {
+            threadPool->parallelFor(bandCount, blendBand);
+        } else {
+            for (int i = 0; i < bandCount; ++i) {
+                blendBand(i);
+            }
+        }
+    }
+}
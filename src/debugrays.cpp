@@ -0,0 +1,46 @@
+#include "../include/debugrays.hpp"
+#include "../include/profiler.hpp"
+#include <cmath>
+
+DebugRays::DebugRays()
+    : vertices(sf::Quads) {
+}
+
+void DebugRays::clear() {
+    vertices.clear();
+}
+
+sf::Vertex* DebugRays::appendSegments(int count) {
+    const size_t first = vertices.getVertexCount();
+    vertices.resize(first + static_cast<size_t>(count) * 4);
+    return &vertices[first];
+}
+
+void DebugRays::draw(sf::RenderTarget& target) const {
+    PROFILE_ZONE("DebugRays::draw");
+    if (vertices.getVertexCount() > 0) {
+        target.draw(vertices);
+    }
+}
+
+int DebugRays::getSegmentCount() const {
+    return static_cast<int>(vertices.getVertexCount() / 4);
+}
+
+const sf::VertexArray& DebugRays::getVertices() const {
+    return vertices;
+}
+
+void DebugRays::makeQuad(const sf::Vector2f& start, const sf::Vector2f& end, const sf::Color& color, float thickness,
+                         sf::Vertex* quad) {
+    const sf::Vector2f along = end - start;
+    const float length = std::sqrt(along.x * along.x + along.y * along.y);
+    // A zero-length segment still gets a valid, if empty, quad
+    const float scale = length > 0.0f ? 0.5f * thickness / length : 0.0f;
+    const sf::Vector2f offset(-along.y * scale, along.x * scale);
+    
+    quad[0] = sf::Vertex(start + offset, color);
+    quad[1] = sf::Vertex(end + offset, color);
+    quad[2] = sf::Vertex(end - offset, color);
+    quad[3] = sf::Vertex(start - offset, color);
+}
@@ -0,0 +1,295 @@
+#include "../include/dirtyregion.hpp"
+#include "../include/utils.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Covers sample blocks that straddle a shape edge and float rounding at the boundary
+    const float EDGE_MARGIN = 4.0f;
+    
+    // Writes the part of a convex polygon on the inside of one clip edge to output
+    template <typename Inside, typename Intersect>
+    void clipEdge(const std::vector<sf::Vector2f>& input, std::vector<sf::Vector2f>& output, Inside inside, Intersect intersect) {
+        output.clear();
+        for (size_t i = 0; i < input.size(); ++i) {
+            const sf::Vector2f& current = input[i];
+            const sf::Vector2f& previous = input[(i + input.size() - 1) % input.size()];
+            bool currentInside = inside(current);
+            bool previousInside = inside(previous);
+            
+            if (currentInside != previousInside) {
+                output.push_back(intersect(previous, current));
+            }
+            if (currentInside) {
+                output.push_back(current);
+            }
+        }
+    }
+    
+    // Far side of a convex polygon enclosing the sector of radius reach between
+    // first and second. A single chord would cut off most of a wide wedge, so
+    // the arc is bounded by tangent lines at its ends and at its middle.
+    void appendFarArc(std::vector<sf::Vector2f>& points, const sf::Vector2f& apex, const sf::Vector2f& first,
+                      const sf::Vector2f& second, const sf::Vector2f& axis, float reach) {
+        sf::Vector2f towardFirst = first + axis;
+        sf::Vector2f towardSecond = second + axis;
+        float halfLength = std::sqrt(towardFirst.x * towardFirst.x + towardFirst.y * towardFirst.y);
+        
+        // Tangents a quarter of the wedge apart meet at reach / cos(quarter angle);
+        // |first + axis| is 2 cos(quarter angle), so the corner is 2 reach / |first + axis|^2 along it
+        float cornerScale = 2.0f * reach / (halfLength * halfLength);
+        points.push_back(apex + first * reach);
+        points.push_back(apex + towardFirst * cornerScale);
+        points.push_back(apex + towardSecond * cornerScale);
+        points.push_back(apex + second * reach);
+    }
+}
+
+DirtyRegion::DirtyRegion()
+    : width(0)
+    , height(0)
+    , tileSize(1)
+    , tilesX(0)
+    , tilesY(0)
+    , dirtyCount(0) {
+}
+
+void DirtyRegion::reset(const FrameBuffer& frameBuffer, int newTileSize) {
+    width = static_cast<int>(frameBuffer.getWidth());
+    height = static_cast<int>(frameBuffer.getHeight());
+    tileSize = newTileSize;
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+    dirtyTiles.assign(static_cast<size_t>(tilesX) * tilesY, 0);
+    tileList.clear();
+    dirtyCount = 0;
+}
+
+void DirtyRegion::markAll() {
+    std::fill(dirtyTiles.begin(), dirtyTiles.end(), 1);
+    dirtyCount = static_cast<int>(dirtyTiles.size());
+    tileList.clear();
+}
+
+void DirtyRegion::addRect(float left, float top, float right, float bottom) {
+    if (isFull()) {
+        return;
+    }
+    
+    // Grow by the margin, then clip to the buffer
+    left = std::max(left - EDGE_MARGIN, 0.0f);
+    top = std::max(top - EDGE_MARGIN, 0.0f);
+    right = std::min(right + EDGE_MARGIN, static_cast<float>(width));
+    bottom = std::min(bottom + EDGE_MARGIN, static_cast<float>(height));
+    if (left >= right || top >= bottom) {
+        return;
+    }
+    
+    int firstX = static_cast<int>(left) / tileSize;
+    int firstY = static_cast<int>(top) / tileSize;
+    // Right and bottom edges are exclusive
+    int lastX = std::min((static_cast<int>(std::ceil(right)) - 1) / tileSize, tilesX - 1);
+    int lastY = std::min((static_cast<int>(std::ceil(bottom)) - 1) / tileSize, tilesY - 1);
+    
+    for (int ty = firstY; ty <= lastY; ++ty) {
+        for (int tx = firstX; tx <= lastX; ++tx) {
+            char& tile = dirtyTiles[static_cast<size_t>(ty) * tilesX + tx];
+            if (!tile) {
+                tile = 1;
+                ++dirtyCount;
+            }
+        }
+    }
+    tileList.clear();
+}
+
+void DirtyRegion::addCircle(const sf::Vector2f& center, float radius) {
+    addRect(center.x - radius, center.y - radius, center.x + radius, center.y + radius);
+}
+
+void DirtyRegion::addCameraWedge(const sf::Vector2f& apex, const sf::Vector2f& center, float radius) {
+    sf::Vector2f first, second, axis;
+    float distance;
+    if (!Utils::getTangentDirections(apex, center, radius, first, second, axis, distance)) {
+        // Every ray from inside the circle can hit it
+        markAll();
+        return;
+    }
+    
+    // Long enough to leave the screen from anywhere on it
+    float reach = static_cast<float>(width + height) * 2.0f + distance;
+    polygon.clear();
+    polygon.push_back(apex);
+    appendFarArc(polygon, apex, first, second, axis, reach);
+    addPolygon(polygon);
+}
+
+void DirtyRegion::addShadowWedge(const sf::Vector2f& light, const sf::Vector2f& center, float radius) {
+    sf::Vector2f first, second, axis;
+    float distance;
+    if (!Utils::getTangentDirections(light, center, radius, first, second, axis, distance)) {
+        // A light inside the occluder casts no shadow
+        return;
+    }
+    
+    // The near arc at the center distance bulges away from the light, so its chord bounds it
+    float reach = static_cast<float>(width + height) * 2.0f + distance;
+    polygon.clear();
+    polygon.push_back(light + second * distance);
+    polygon.push_back(light + first * distance);
+    appendFarArc(polygon, light, first, second, axis, reach);
+    addPolygon(polygon);
+}
+
+bool DirtyRegion::canShadow(const sf::Vector2f& light, float lightRadius,
+                            const sf::Vector2f& occluderCenter, float occluderRadius,
+                            const sf::Vector2f& receiverCenter, float receiverRadius) {
+    sf::Vector2f lightToOccluder = occluderCenter - light;
+    float lightOccluderDistance = std::sqrt(lightToOccluder.x * lightToOccluder.x + lightToOccluder.y * lightToOccluder.y);
+    sf::Vector2f lightToReceiver = receiverCenter - light;
+    float lightReceiverDistance = std::sqrt(lightToReceiver.x * lightToReceiver.x + lightToReceiver.y * lightToReceiver.y);
+    
+    // The receiver must reach past the near side of the occluder, seen from some point of the disk
+    if (lightReceiverDistance + receiverRadius < lightOccluderDistance - occluderRadius - 2.0f * lightRadius) {
+        return false;
+    }
+    
+    // Every shadow ray from the disk past the occluder stays inside the tangent cone
+    // from the crossing point of the inner bitangents; overlapping circles have none
+    if (lightOccluderDistance <= lightRadius + occluderRadius) {
+        return true;
+    }
+    const sf::Vector2f apex = light + lightToOccluder * (lightRadius / (lightRadius + occluderRadius));
+    
+    sf::Vector2f toOccluder = occluderCenter - apex;
+    sf::Vector2f toReceiver = receiverCenter - apex;
+    float occluderDistance = std::sqrt(toOccluder.x * toOccluder.x + toOccluder.y * toOccluder.y);
+    float receiverDistance = std::sqrt(toReceiver.x * toReceiver.x + toReceiver.y * toReceiver.y);
+    
+    // The receiver around the apex covers every direction
+    if (receiverDistance <= receiverRadius) {
+        return true;
+    }
+    
+    // ...and the angular intervals seen from the apex must overlap
+    float cosAngle = (toOccluder.x * toReceiver.x + toOccluder.y * toReceiver.y) / (occluderDistance * receiverDistance);
+    float angle = std::acos(std::max(-1.0f, std::min(1.0f, cosAngle)));
+    float halfWidths = std::asin(occluderRadius / occluderDistance) + std::asin(receiverRadius / receiverDistance);
+    return angle <= halfWidths + 1e-3f;
+}
+
+bool DirtyRegion::isEmpty() const {
+    return dirtyCount == 0;
+}
+
+bool DirtyRegion::isFull() const {
+    return dirtyCount == static_cast<int>(dirtyTiles.size());
+}
+
+int DirtyRegion::getTileSize() const {
+    return tileSize;
+}
+
+const std::vector<int>& DirtyRegion::getTiles() {
+    // Built lazily so repeated additions stay cheap
+    if (tileList.empty() && dirtyCount > 0) {
+        tileList.reserve(dirtyCount);
+        for (int i = 0; i < static_cast<int>(dirtyTiles.size()); ++i) {
+            if (dirtyTiles[i]) {
+                tileList.push_back(i);
+            }
+        }
+    }
+    return tileList;
+}
+
+bool DirtyRegion::getRowSpan(int& top, int& bottom) {
+    const std::vector<int>& tiles = getTiles();
+    if (tiles.empty()) {
+        return false;
+    }
+    top = (tiles.front() / tilesX) * tileSize;
+    bottom = std::min((tiles.back() / tilesX + 1) * tileSize, height);
+    return true;
+}
+
+void DirtyRegion::addPolygon(const std::vector<sf::Vector2f>& points) {
+    if (isFull()) {
+        return;
+    }
+    
+    const float maxX = static_cast<float>(width);
+    const float maxY = static_cast<float>(height);
+    
+    // Sutherland-Hodgman against the four buffer edges, alternating between the scratch buffers
+    std::vector<sf::Vector2f>& clipped = clippedPolygon;
+    clipEdge(points, clipScratch,
+        [](const sf::Vector2f& p) { return p.x >= 0.0f; },
+        [](const sf::Vector2f& a, const sf::Vector2f& b) {
+            float t = a.x / (a.x - b.x);
+            return sf::Vector2f(0.0f, a.y + (b.y - a.y) * t);
+        });
+    clipEdge(clipScratch, clipped,
+        [maxX](const sf::Vector2f& p) { return p.x <= maxX; },
+        [maxX](const sf::Vector2f& a, const sf::Vector2f& b) {
+            float t = (maxX - a.x) / (b.x - a.x);
+            return sf::Vector2f(maxX, a.y + (b.y - a.y) * t);
+        });
+    clipEdge(clipped, clipScratch,
+        [](const sf::Vector2f& p) { return p.y >= 0.0f; },
+        [](const sf::Vector2f& a, const sf::Vector2f& b) {
+            float t = a.y / (a.y - b.y);
+            return sf::Vector2f(a.x + (b.x - a.x) * t, 0.0f);
+        });
+    clipEdge(clipScratch, clipped,
+        [maxY](const sf::Vector2f& p) { return p.y <= maxY; },
+        [maxY](const sf::Vector2f& a, const sf::Vector2f& b) {
+            float t = (maxY - a.y) / (b.y - a.y);
+            return sf::Vector2f(a.x + (b.x - a.x) * t, maxY);
+        });
+    
+    if (clipped.empty()) {
+        return;
+    }
+    
+    float top = clipped[0].y, bottom = clipped[0].y;
+    for (const sf::Vector2f& point : clipped) {
+        top = std::min(top, point.y);
+        bottom = std::max(bottom, point.y);
+    }
+    
+    // Thin wedges cross the screen diagonally, so each tile row gets its own
+    // horizontal span instead of marking the whole bounding box
+    int firstRow = std::max(static_cast<int>(top - EDGE_MARGIN) / tileSize, 0);
+    int lastRow = std::min(static_cast<int>(bottom + EDGE_MARGIN) / tileSize, tilesY - 1);
+    for (int row = firstRow; row <= lastRow; ++row) {
+        const float bandTop = static_cast<float>(row * tileSize) - EDGE_MARGIN;
+        const float bandBottom = static_cast<float>((row + 1) * tileSize) + EDGE_MARGIN;
+        
+        std::vector<sf::Vector2f>& band = bandPolygon;
+        clipEdge(clipped, clipScratch,
+            [bandTop](const sf::Vector2f& p) { return p.y >= bandTop; },
+            [bandTop](const sf::Vector2f& a, const sf::Vector2f& b) {
+                float t = (bandTop - a.y) / (b.y - a.y);
+                return sf::Vector2f(a.x + (b.x - a.x) * t, bandTop);
+            });
+        clipEdge(clipScratch, band,
+            [bandBottom](const sf::Vector2f& p) { return p.y <= bandBottom; },
+            [bandBottom](const sf::Vector2f& a, const sf::Vector2f& b) {
+                float t = (bandBottom - a.y) / (b.y - a.y);
+                return sf::Vector2f(a.x + (b.x - a.x) * t, bandBottom);
+            });
+        if (band.empty()) {
+            continue;
+        }
+        
+        float left = band[0].x, right = band[0].x;
+        for (const sf::Vector2f& point : band) {
+            left = std::min(left, point.x);
+            right = std::max(right, point.x);
+        }
+        // The band already includes the vertical margin
+        addRect(left, static_cast<float>(row * tileSize) + EDGE_MARGIN,
+                right, static_cast<float>((row + 1) * tileSize) - EDGE_MARGIN);
+    }
+}
@@ -0,0 +1,643 @@
+#include "../include/distributed.hpp"
+#include "../include/profiler.hpp"
+#include "../include/utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+namespace {
+    // Every message is an 8-byte header, type then payload size, followed by the payload.
+    // Integers and floats are little-endian on the wire, whatever the hosts use.
+    //   HELLO   worker -> coordinator: magic, protocol version
+    //   SCENE   coordinator -> worker: settings, then the spheres and lights
+    //   JOB     coordinator -> worker: frame, job index, x, y, width, height
+    //   PIXELS  worker -> coordinator: the JOB fields, then width * height RGB8 pixels
+    enum MessageType : uint32_t {
+        HELLO = 1,
+        SCENE = 2,
+        JOB = 3,
+        PIXELS = 4
+    };
+    
+    constexpr uint32_t PROTOCOL_MAGIC = 0x4B575452; // "RTWK"
+    constexpr uint32_t PROTOCOL_VERSION = 1;
+    constexpr size_t HEADER_SIZE = 8;
+    constexpr uint32_t MAX_MESSAGE_SIZE = 1u << 30;
+    
+    constexpr uint32_t SETTING_ANTI_ALIASING = 1;
+    constexpr uint32_t SETTING_UNIFORM_GRID = 2;
+    
+    // Once a message has started arriving, a peer this slow to send the rest, or to
+    // take what is sent to it, counts as lost
+    constexpr int TRANSFER_TIMEOUT_MS = 30000;
+    constexpr int CONNECT_ATTEMPTS = 100;
+    constexpr int CONNECT_RETRY_MS = 100;
+    
+    class MessageWriter {
+    public:
+        MessageWriter(std::vector<unsigned char>& bytes, MessageType type)
+            : bytes(bytes) {
+            bytes.clear();
+            putU32(type);
+            putU32(0);
+        }
+        
+        void putU8(uint8_t value) {
+            bytes.push_back(value);
+        }
+        
+        void putU32(uint32_t value) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                bytes.push_back(static_cast<unsigned char>(value >> shift));
+            }
+        }
+        
+        void putFloat(float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            putU32(bits);
+        }
+        
+        // Payload bytes the caller fills in place
+        unsigned char* reserve(size_t size) {
+            bytes.resize(bytes.size() + size);
+            return bytes.data() + bytes.size() - size;
+        }
+        
+        // Writes the payload size into the header
+        void finish() {
+            const uint32_t size = static_cast<uint32_t>(bytes.size() - HEADER_SIZE);
+            for (int i = 0; i < 4; ++i) {
+                bytes[4 + i] = static_cast<unsigned char>(size >> (i * 8));
+            }
+        }
+    
+    private:
+        std::vector<unsigned char>& bytes;
+    };
+    
+    // Reads the payload of a received message; reading past the end marks it invalid
+    class MessageReader {
+    public:
+        explicit MessageReader(const std::vector<unsigned char>& bytes)
+            : data(bytes.data())
+            , size(bytes.size())
+            , offset(HEADER_SIZE)
+            , valid(bytes.size() >= HEADER_SIZE) {
+        }
+        
+        uint8_t getU8() {
+            const unsigned char* p = getBytes(1);
+            return p ? p[0] : 0;
+        }
+        
+        uint32_t getU32() {
+            const unsigned char* p = getBytes(4);
+            return p ? p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24 : 0;
+        }
+        
+        float getFloat() {
+            const uint32_t bits = getU32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        
+        const unsigned char* getBytes(size_t count) {
+            if (!valid || count > size - offset) {
+                valid = false;
+                return nullptr;
+            }
+            const unsigned char* p = data + offset;
+            offset += count;
+            return p;
+        }
+        
+        // True when every read succeeded and the whole payload was read
+        bool isComplete() const {
+            return valid && offset == size;
+        }
+    
+    private:
+        const unsigned char* data;
+        size_t size;
+        size_t offset;
+        bool valid;
+    };
+    
+    bool sendMessage(Socket& socket, const std::vector<unsigned char>& bytes) {
+        return socket.sendAll(bytes.data(), bytes.size());
+    }
+    
+    // Receives one message, header included, into bytes
+    bool receiveMessage(Socket& socket, std::vector<unsigned char>& bytes, uint32_t& type) {
+        unsigned char header[HEADER_SIZE];
+        if (!socket.receiveAll(header, HEADER_SIZE)) {
+            return false;
+        }
+        type = header[0] | header[1] << 8 | header[2] << 16 | static_cast<uint32_t>(header[3]) << 24;
+        const uint32_t size = header[4] | header[5] << 8 | header[6] << 16 | static_cast<uint32_t>(header[7]) << 24;
+        if (size > MAX_MESSAGE_SIZE) {
+            return false;
+        }
+        bytes.resize(HEADER_SIZE + size);
+        std::memcpy(bytes.data(), header, HEADER_SIZE);
+        return size == 0 || socket.receiveAll(bytes.data() + HEADER_SIZE, size);
+    }
+    
+    void encodeScene(const Scene& scene, const DistributedRenderSettings& settings, std::vector<unsigned char>& bytes) {
+        MessageWriter writer(bytes, SCENE);
+        uint32_t flags = 0;
+        flags |= settings.antiAliasing ? SETTING_ANTI_ALIASING : 0;
+        flags |= scene.getAccelerationStructure() == AccelerationStructure::GRID ? SETTING_UNIFORM_GRID : 0;
+        writer.putU32(settings.width);
+        writer.putU32(settings.height);
+        writer.putU32(flags);
+        writer.putU32(static_cast<uint32_t>(settings.maxDepth));
+        writer.putU32(static_cast<uint32_t>(settings.adaptiveThreshold));
+        
+        const std::vector<Sphere>& spheres = scene.getSpheres();
+        const std::vector<Light>& lights = scene.getLights();
+        writer.putU32(static_cast<uint32_t>(spheres.size()));
+        writer.putU32(static_cast<uint32_t>(lights.size()));
+        for (const Sphere& sphere : spheres) {
+            const sf::Color material = sphere.getMaterial();
+            writer.putFloat(sphere.getPosition().x);
+            writer.putFloat(sphere.getPosition().y);
+            writer.putFloat(sphere.getRadius());
+            writer.putU8(material.r);
+            writer.putU8(material.g);
+            writer.putU8(material.b);
+            writer.putU8(static_cast<uint8_t>(sphere.getSurface()));
+        }
+        for (const Light& light : lights) {
+            const sf::Color color = light.getColor();
+            writer.putFloat(light.getPosition().x);
+            writer.putFloat(light.getPosition().y);
+            writer.putU8(color.r);
+            writer.putU8(color.g);
+            writer.putU8(color.b);
+            writer.putU8(color.a);
+        }
+        writer.finish();
+    }
+}
+
+DistributedRenderSettings::DistributedRenderSettings()
+    : width(Utils::WINDOW_WIDTH)
+    , height(Utils::WINDOW_HEIGHT)
+    , antiAliasing(false)
+    , maxDepth(3)
+    , adaptiveThreshold(-1) {
+}
+
+bool DistributedRenderSettings::operator==(const DistributedRenderSettings& other) const {
+    return width == other.width && height == other.height && antiAliasing == other.antiAliasing
+        && maxDepth == other.maxDepth && adaptiveThreshold == other.adaptiveThreshold;
+}
+
+RenderCoordinator::RenderCoordinator()
+    : sceneVersion(0)
+    , encodedScene(nullptr)
+    , encodedRevision(0)
+    , encodedStructure(AccelerationStructure::BVH)
+    , frame(0)
+    , remainingJobs(0)
+    , stats() {
+}
+
+bool RenderCoordinator::listen(const std::string& address, std::string& error) {
+    return listener.listen(address, error);
+}
+
+bool RenderCoordinator::waitForWorkers(int count, std::string& error) {
+    std::vector<Socket*> sockets(1, &listener);
+    std::vector<char> readable;
+    while (static_cast<int>(workers.size()) < count) {
+        if (!listener.isOpen()) {
+            error = "the coordinator is not listening";
+            return false;
+        }
+        if (Socket::waitReadable(sockets, -1, readable)) {
+            acceptWorker();
+        }
+    }
+    return true;
+}
+
+bool RenderCoordinator::traceFrame(const Scene& scene, const DistributedRenderSettings& settings,
+                                   FrameBuffer& frameBuffer, std::string& error) {
+    PROFILE_ZONE("RenderCoordinator::traceFrame");
+    // Switching the acceleration structure leaves the revision alone, so it is compared too
+    if (sceneMessage.empty() || &scene != encodedScene || scene.getRevision() != encodedRevision
+        || scene.getAccelerationStructure() != encodedStructure || !(settings == encodedSettings)) {
+        encodeScene(scene, settings, sceneMessage);
+        ++sceneVersion;
+        encodedScene = &scene;
+        encodedRevision = scene.getRevision();
+        encodedStructure = scene.getAccelerationStructure();
+        encodedSettings = settings;
+    }
+    
+    frameBuffer.resize(settings.width, settings.height);
+    ++frame;
+    const int jobCount = frameBuffer.getTileCount(Utils::DISTRIBUTED_TILE_SIZE);
+    jobs.resize(jobCount);
+    pendingJobs.resize(jobCount);
+    for (int i = 0; i < jobCount; ++i) {
+        jobs[i] = frameBuffer.getTile(i, Utils::DISTRIBUTED_TILE_SIZE);
+        // Taken from the back, so the frame is handed out top to bottom
+        pendingJobs[i] = jobCount - 1 - i;
+    }
+    jobDone.assign(jobCount, 0);
+    jobCopies.assign(jobCount, 0);
+    jobAssignments.assign(jobCount, 0);
+    remainingJobs = jobCount;
+    stats = DistributedFrameStats();
+    stats.jobs = jobCount;
+    
+    std::vector<Socket*> sockets;
+    std::vector<char> readable;
+    while (remainingJobs > 0) {
+        // Top every worker up to its job limit
+        for (size_t i = 0; i < workers.size();) {
+            Worker& worker = workers[i];
+            bool failed = false;
+            while (!failed && static_cast<int>(worker.outstanding.size()) < MAX_OUTSTANDING_JOBS) {
+                const int job = selectJob(worker);
+                if (job < 0) {
+                    break;
+                }
+                failed = !sendJob(worker, job);
+            }
+            if (failed) {
+                removeWorker(i);
+            } else {
+                ++i;
+            }
+        }
+        if (workers.empty()) {
+            error = "no render workers left";
+            stats.workers = 0;
+            return false;
+        }
+        
+        sockets.clear();
+        sockets.push_back(&listener);
+        for (Worker& worker : workers) {
+            sockets.push_back(&worker.socket);
+        }
+        if (!Socket::waitReadable(sockets, -1, readable)) {
+            continue;
+        }
+        // Backwards, so removing a worker leaves the indices still to visit unchanged
+        for (size_t i = workers.size(); i-- > 0;) {
+            if (readable[i + 1]) {
+                receiveResult(i, frameBuffer);
+            }
+        }
+        // Joins after the results, which are indexed by the sockets polled
+        if (readable[0]) {
+            acceptWorker();
+        }
+    }
+    
+    stats.workers = static_cast<int>(workers.size());
+    return true;
+}
+
+int RenderCoordinator::getWorkerCount() const {
+    return static_cast<int>(workers.size());
+}
+
+const DistributedFrameStats& RenderCoordinator::getLastFrameStats() const {
+    return stats;
+}
+
+bool RenderCoordinator::acceptWorker() {
+    Socket socket;
+    std::string error;
+    if (!listener.accept(socket, error)) {
+        return false;
+    }
+    socket.setTimeout(TRANSFER_TIMEOUT_MS);
+    
+    uint32_t type = 0;
+    if (!receiveMessage(socket, messageBuffer, type) || type != HELLO) {
+        return false;
+    }
+    MessageReader reader(messageBuffer);
+    const uint32_t magic = reader.getU32();
+    const uint32_t version = reader.getU32();
+    if (!reader.isComplete() || magic != PROTOCOL_MAGIC || version != PROTOCOL_VERSION) {
+        return false;
+    }
+    
+    workers.emplace_back();
+    workers.back().socket = std::move(socket);
+    workers.back().sceneVersion = 0;
+    return true;
+}
+
+bool RenderCoordinator::sendJob(Worker& worker, int job) {
+    // A job that cannot be sent goes back to the queue for another worker
+    if (worker.sceneVersion != sceneVersion) {
+        if (!sendMessage(worker.socket, sceneMessage)) {
+            pendingJobs.push_back(job);
+            return false;
+        }
+        worker.sceneVersion = sceneVersion;
+    }
+    
+    const Tile& tile = jobs[job];
+    MessageWriter writer(messageBuffer, JOB);
+    writer.putU32(frame);
+    writer.putU32(static_cast<uint32_t>(job));
+    writer.putU32(static_cast<uint32_t>(tile.x));
+    writer.putU32(static_cast<uint32_t>(tile.y));
+    writer.putU32(static_cast<uint32_t>(tile.width));
+    writer.putU32(static_cast<uint32_t>(tile.height));
+    writer.finish();
+    if (!sendMessage(worker.socket, messageBuffer)) {
+        pendingJobs.push_back(job);
+        return false;
+    }
+    
+    worker.outstanding.push_back({ frame, job });
+    ++jobCopies[job];
+    if (jobAssignments[job]++ > 0) {
+        ++stats.reissuedJobs;
+    }
+    return true;
+}
+
+int RenderCoordinator::selectJob(const Worker& worker) {
+    while (!pendingJobs.empty()) {
+        const int job = pendingJobs.back();
+        pendingJobs.pop_back();
+        if (!jobDone[job]) {
+            return job;
+        }
+    }
+    
+    // Nothing left to hand out: an idle worker races the earliest job still running
+    // on a single worker. Only idle workers take copies, so a job runs at most twice
+    // at once and a slow worker's queue is not duplicated wholesale.
+    if (!worker.outstanding.empty()) {
+        return -1;
+    }
+    for (size_t job = 0; job < jobs.size(); ++job) {
+        if (!jobDone[job] && jobCopies[job] == 1) {
+            return static_cast<int>(job);
+        }
+    }
+    return -1;
+}
+
+void RenderCoordinator::receiveResult(size_t workerIndex, FrameBuffer& frameBuffer) {
+    Worker& worker = workers[workerIndex];
+    uint32_t type = 0;
+    if (!receiveMessage(worker.socket, messageBuffer, type) || type != PIXELS) {
+        removeWorker(workerIndex);
+        return;
+    }
+    
+    MessageReader reader(messageBuffer);
+    const uint32_t resultFrame = reader.getU32();
+    const uint32_t job = reader.getU32();
+    Tile tile;
+    tile.x = static_cast<int>(reader.getU32());
+    tile.y = static_cast<int>(reader.getU32());
+    tile.width = static_cast<int>(reader.getU32());
+    tile.height = static_cast<int>(reader.getU32());
+    const unsigned char* pixels = reader.getBytes(static_cast<size_t>(tile.width) * tile.height * 3);
+    
+    auto assignment = std::find_if(worker.outstanding.begin(), worker.outstanding.end(), [&](const Assignment& a) {
+        return a.frame == resultFrame && static_cast<uint32_t>(a.job) == job;
+    });
+    if (!reader.isComplete() || assignment == worker.outstanding.end()) {
+        removeWorker(workerIndex); // Not the protocol; its other jobs are requeued
+        return;
+    }
+    // Late copies of jobs from earlier frames only free the worker's slot
+    if (resultFrame != frame) {
+        worker.outstanding.erase(assignment);
+        return;
+    }
+    const Tile& expected = jobs[job];
+    if (tile.x != expected.x || tile.y != expected.y || tile.width != expected.width
+        || tile.height != expected.height) {
+        removeWorker(workerIndex);
+        return;
+    }
+    worker.outstanding.erase(assignment);
+    --jobCopies[job];
+    
+    // The other copy of a raced job may have won already
+    if (jobDone[job]) {
+        return;
+    }
+    const unsigned width = frameBuffer.getWidth();
+    for (int y = 0; y < tile.height; ++y) {
+        const unsigned char* in = pixels + static_cast<size_t>(y) * tile.width * 3;
+        sf::Uint8* out = frameBuffer.getPixels() + (static_cast<size_t>(tile.y + y) * width + tile.x) * 4;
+        for (int x = 0; x < tile.width; ++x) {
+            out[x * 4] = in[x * 3];
+            out[x * 4 + 1] = in[x * 3 + 1];
+            out[x * 4 + 2] = in[x * 3 + 2];
+            out[x * 4 + 3] = 255;
+        }
+    }
+    frameBuffer.markDirty(tile.y, tile.y + tile.height);
+    jobDone[job] = 1;
+    --remainingJobs;
+}
+
+void RenderCoordinator::removeWorker(size_t workerIndex) {
+    for (const Assignment& assignment : workers[workerIndex].outstanding) {
+        if (assignment.frame == frame && !jobDone[assignment.job]) {
+            --jobCopies[assignment.job];
+            pendingJobs.push_back(assignment.job);
+        }
+    }
+    workers.erase(workers.begin() + static_cast<std::ptrdiff_t>(workerIndex));
+    ++stats.lostWorkers;
+}
+
+RenderWorker::RenderWorker(unsigned threadCount)
+    : threadPool(threadCount)
+    , frameBuffer(1, 1)
+    , hasScene(false)
+    , renderedJobs(0) {
+    scene.setThreadPool(&threadPool);
+}
+
+bool RenderWorker::run(const std::string& address, std::string& error) {
+    for (int attempt = 1; !socket.connect(address, error); ++attempt) {
+        if (attempt >= CONNECT_ATTEMPTS) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(CONNECT_RETRY_MS));
+    }
+    
+    MessageWriter writer(messageBuffer, HELLO);
+    writer.putU32(PROTOCOL_MAGIC);
+    writer.putU32(PROTOCOL_VERSION);
+    writer.finish();
+    if (!sendMessage(socket, messageBuffer)) {
+        error = "cannot reach the coordinator at " + address;
+        return false;
+    }
+    
+    // The coordinator closing the connection is the normal end of the work
+    uint32_t type = 0;
+    while (receiveMessage(socket, messageBuffer, type)) {
+        bool handled = false;
+        if (type == SCENE) {
+            handled = applyScene(error);
+        } else if (type == JOB) {
+            handled = renderJob(error);
+        } else {
+            error = "unexpected message " + std::to_string(type) + " from the coordinator";
+        }
+        if (!handled) {
+            socket.close();
+            return false;
+        }
+    }
+    socket.close();
+    return true;
+}
+
+int RenderWorker::getRenderedJobCount() const {
+    return renderedJobs;
+}
+
+bool RenderWorker::applyScene(std::string& error) {
+    PROFILE_ZONE("RenderWorker::applyScene");
+    MessageReader reader(messageBuffer);
+    const unsigned width = reader.getU32();
+    const unsigned height = reader.getU32();
+    const uint32_t flags = reader.getU32();
+    const int maxDepth = static_cast<int>(reader.getU32());
+    const int adaptiveThreshold = static_cast<int>(reader.getU32());
+    const uint32_t sphereCount = reader.getU32();
+    const uint32_t lightCount = reader.getU32();
+    
+    // Counts are checked against the payload size before anything is allocated for them
+    const uint64_t expectedSize = 28 + static_cast<uint64_t>(sphereCount) * 16 + static_cast<uint64_t>(lightCount) * 12;
+    if (messageBuffer.size() - HEADER_SIZE != expectedSize) {
+        error = "malformed scene message";
+        return false;
+    }
+    std::vector<Sphere> spheres;
+    std::vector<Light> lights;
+    spheres.reserve(sphereCount);
+    for (uint32_t i = 0; i < sphereCount; ++i) {
+        const float x = reader.getFloat();
+        const float y = reader.getFloat();
+        const float radius = reader.getFloat();
+        const sf::Uint8 r = reader.getU8();
+        const sf::Uint8 g = reader.getU8();
+        const sf::Uint8 b = reader.getU8();
+        const uint8_t surface = reader.getU8();
+        Sphere sphere(sf::Vector2f(x, y), radius);
+        sphere.setMaterial(sf::Color(r, g, b));
+        sphere.setSurface(surface == static_cast<uint8_t>(SurfaceType::MIRROR) ? SurfaceType::MIRROR
+                          : surface == static_cast<uint8_t>(SurfaceType::GLASS) ? SurfaceType::GLASS
+                          : SurfaceType::DIFFUSE);
+        spheres.push_back(sphere);
+    }
+    lights.reserve(lightCount);
+    for (uint32_t i = 0; i < lightCount; ++i) {
+        const float x = reader.getFloat();
+        const float y = reader.getFloat();
+        const sf::Uint8 r = reader.getU8();
+        const sf::Uint8 g = reader.getU8();
+        const sf::Uint8 b = reader.getU8();
+        const sf::Uint8 a = reader.getU8();
+        lights.push_back(Light(sf::Vector2f(x, y), sf::Color(r, g, b, a)));
+    }
+    if (!reader.isComplete() || spheres.empty() || lights.empty() || width == 0 || height == 0
+        || width > Utils::MAX_FRAME_SIZE || height > Utils::MAX_FRAME_SIZE || maxDepth <= 0) {
+        error = "invalid scene message";
+        return false;
+    }
+    
+    rayTracer.setAntiAliasing((flags & SETTING_ANTI_ALIASING) != 0);
+    rayTracer.setMaxDepth(maxDepth);
+    rayTracer.setAdaptiveSampling(adaptiveThreshold >= 0);
+    if (adaptiveThreshold >= 0) {
+        rayTracer.setAdaptiveThreshold(adaptiveThreshold);
+    }
+    // Selected first, so only the wanted structure is built over the new spheres
+    scene.setAccelerationStructure((flags & SETTING_UNIFORM_GRID) ? AccelerationStructure::GRID
+                                                                  : AccelerationStructure::BVH);
+    scene.setContents(std::move(spheres), std::move(lights));
+    radiance.resize(width, height);
+    frameBuffer.resize(width, height);
+    hasScene = true;
+    return true;
+}
+
+bool RenderWorker::renderJob(std::string& error) {
+    PROFILE_ZONE("RenderWorker::renderJob");
+    MessageReader reader(messageBuffer);
+    const uint32_t jobFrame = reader.getU32();
+    const uint32_t job = reader.getU32();
+    Tile tile;
+    tile.x = static_cast<int>(reader.getU32());
+    tile.y = static_cast<int>(reader.getU32());
+    tile.width = static_cast<int>(reader.getU32());
+    tile.height = static_cast<int>(reader.getU32());
+    const int frameWidth = static_cast<int>(frameBuffer.getWidth());
+    const int frameHeight = static_cast<int>(frameBuffer.getHeight());
+    if (!reader.isComplete() || !hasScene || tile.x < 0 || tile.y < 0 || tile.width <= 0 || tile.height <= 0
+        || tile.width > frameWidth - tile.x || tile.height > frameHeight - tile.y) {
+        error = "invalid job message";
+        return false;
+    }
+    
+    // The job is cut into the same render tiles a local frame uses, so sampling
+    // (pixel step blocks, adaptive quadtrees) lines up with a local render
+    const int tileSize = Utils::RENDER_TILE_SIZE;
+    const int columns = (tile.width + tileSize - 1) / tileSize;
+    const int rows = (tile.height + tileSize - 1) / tileSize;
+    threadPool.parallelFor(columns * rows, [&](int index) {
+        Tile part;
+        part.x = tile.x + (index % columns) * tileSize;
+        part.y = tile.y + (index / columns) * tileSize;
+        part.width = std::min(tileSize, tile.x + tile.width - part.x);
+        part.height = std::min(tileSize, tile.y + tile.height - part.y);
+        rayTracer.renderTile(scene, radiance, part);
+    });
+    radiance.resolve(frameBuffer, tile);
+    
+    MessageWriter writer(resultBuffer, PIXELS);
+    writer.putU32(jobFrame);
+    writer.putU32(job);
+    writer.putU32(static_cast<uint32_t>(tile.x));
+    writer.putU32(static_cast<uint32_t>(tile.y));
+    writer.putU32(static_cast<uint32_t>(tile.width));
+    writer.putU32(static_cast<uint32_t>(tile.height));
+    unsigned char* out = writer.reserve(static_cast<size_t>(tile.width) * tile.height * 3);
+    for (int y = tile.y; y < tile.y + tile.height; ++y) {
+        const sf::Uint8* in = frameBuffer.getPixels() + (static_cast<size_t>(y) * frameWidth + tile.x) * 4;
+        for (int x = 0; x < tile.width; ++x) {
+            *out++ = in[x * 4];
+            *out++ = in[x * 4 + 1];
+            *out++ = in[x * 4 + 2];
+        }
+    }
+    writer.finish();
+    // A coordinator that finished without this copy of the job has closed the
+    // connection; the next receive fails and ends the worker normally
+    if (!sendMessage(socket, resultBuffer)) {
+        socket.close();
+        return true;
+    }
+    ++renderedJobs;
+    return true;
+}
@@ -0,0 +1,140 @@
+#include "../include/framebuffer.hpp"
+#include "../include/profiler.hpp"
+#include <algorithm>
+#include <fstream>
+
+FrameBuffer::FrameBuffer(unsigned width, unsigned height)
+    : width(width)
+    , height(height)
+    , pixels(static_cast<size_t>(width) * height * 4, 0)
+    , textureReady(false)
+    , dirtyTop(0)
+    , dirtyBottom(static_cast<int>(height)) {
+}
+
+void FrameBuffer::resize(unsigned newWidth, unsigned newHeight) {
+    if (newWidth == width && newHeight == height) {
+        return;
+    }
+    width = newWidth;
+    height = newHeight;
+    pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+    textureReady = false;
+    markDirty();
+}
+
+void FrameBuffer::clear(const sf::Color& color) {
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        pixels[i] = color.r;
+        pixels[i + 1] = color.g;
+        pixels[i + 2] = color.b;
+        pixels[i + 3] = color.a;
+    }
+    markDirty();
+}
+
+void FrameBuffer::present(sf::RenderWindow& window) {
+    PROFILE_ZONE("FrameBuffer::present");
+    
+    // The texture is created lazily so the buffer itself never needs a GL context
+    if (!textureReady) {
+        texture.create(width, height);
+        sprite.setTexture(texture, true);
+        textureReady = true;
+        markDirty();
+    }
+    
+    // Dirty rows are contiguous in memory, so they go up in a single upload;
+    // an unchanged frame just redraws the cached texture
+    if (dirtyTop < dirtyBottom) {
+        texture.update(&pixels[static_cast<size_t>(dirtyTop) * width * 4],
+                       width, static_cast<unsigned>(dirtyBottom - dirtyTop), 0, static_cast<unsigned>(dirtyTop));
+        dirtyTop = static_cast<int>(height);
+        dirtyBottom = 0;
+    }
+    window.draw(sprite);
+}
+
+void FrameBuffer::markDirty() {
+    dirtyTop = 0;
+    dirtyBottom = static_cast<int>(height);
+}
+
+void FrameBuffer::markDirty(int top, int bottom) {
+    dirtyTop = std::min(dirtyTop, std::max(top, 0));
+    dirtyBottom = std::max(dirtyBottom, std::min(bottom, static_cast<int>(height)));
+}
+
+bool FrameBuffer::takeDirtyRows(int& top, int& bottom) {
+    if (dirtyTop >= dirtyBottom) {
+        return false;
+    }
+    top = dirtyTop;
+    bottom = dirtyBottom;
+    dirtyTop = static_cast<int>(height);
+    dirtyBottom = 0;
+    return true;
+}
+
+bool FrameBuffer::saveToFile(const std::string& path) const {
+    bool isPPM = path.size() >= 4 && path.compare(path.size() - 4, 4, ".ppm") == 0;
+    
+    if (!isPPM) {
+        // sf::Image works entirely on the CPU, so this stays headless
+        sf::Image image;
+        image.create(width, height, pixels.data());
+        return image.saveToFile(path);
+    }
+    
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    
+    file << "P6\n" << width << " " << height << "\n255\n";
+    std::vector<char> row(static_cast<size_t>(width) * 3);
+    for (unsigned y = 0; y < height; ++y) {
+        const sf::Uint8* src = &pixels[static_cast<size_t>(y) * width * 4];
+        for (unsigned x = 0; x < width; ++x) {
+            row[x * 3] = static_cast<char>(src[x * 4]);
+            row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+            row[x * 3 + 2] = static_cast<char>(src[x * 4 + 2]);
+        }
+        file.write(row.data(), static_cast<std::streamsize>(row.size()));
+    }
+    
+    return static_cast<bool>(file);
+}
+
+int FrameBuffer::getTileCount(int tileSize) const {
+    int tilesX = (static_cast<int>(width) + tileSize - 1) / tileSize;
+    int tilesY = (static_cast<int>(height) + tileSize - 1) / tileSize;
+    return tilesX * tilesY;
+}
+
+Tile FrameBuffer::getTile(int index, int tileSize) const {
+    int tilesX = (static_cast<int>(width) + tileSize - 1) / tileSize;
+    
+    Tile tile;
+    tile.x = (index % tilesX) * tileSize;
+    tile.y = (index / tilesX) * tileSize;
+    tile.width = std::min(tileSize, static_cast<int>(width) - tile.x);
+    tile.height = std::min(tileSize, static_cast<int>(height) - tile.y);
+    return tile;
+}
+
+unsigned FrameBuffer::getWidth() const {
+    return width;
+}
+
+unsigned FrameBuffer::getHeight() const {
+    return height;
+}
+
+const sf::Uint8* FrameBuffer::getPixels() const {
+    return pixels.data();
+}
+
+sf::Uint8* FrameBuffer::getPixels() {
+    return pixels.data();
+}
@@ -0,0 +1,89 @@
+#include "../include/framegovernor.hpp"
+#include <algorithm>
+
+FrameGovernor::FrameGovernor()
+    : stepChanges(0) {
+    modes[static_cast<int>(GovernedMode::MODE_2D)].targetMs = DEFAULT_2D_TARGET_MS;
+    modes[static_cast<int>(GovernedMode::RAY_TRACING)].targetMs = DEFAULT_RAY_TRACING_TARGET_MS;
+    reset();
+}
+
+void FrameGovernor::setTargetMs(GovernedMode mode, float milliseconds) {
+    modes[static_cast<int>(mode)].targetMs = std::max(MIN_TARGET_MS, std::min(milliseconds, MAX_TARGET_MS));
+}
+
+float FrameGovernor::getTargetMs(GovernedMode mode) const {
+    return modes[static_cast<int>(mode)].targetMs;
+}
+
+int FrameGovernor::getStep(GovernedMode mode, int configuredStep) const {
+    return std::max(modes[static_cast<int>(mode)].step, configuredStep);
+}
+
+void FrameGovernor::addFrame(GovernedMode mode, float milliseconds, int configuredStep) {
+    ModeState& state = modes[static_cast<int>(mode)];
+    if (state.skipFrame) {
+        state.skipFrame = false;
+        return;
+    }
+    state.history[state.next] = milliseconds;
+    state.next = (state.next + 1) % HISTORY_FRAMES;
+    state.frames = std::min(state.frames + 1, HISTORY_FRAMES);
+    ++state.framesAtStep;
+    
+    float total = 0.0f;
+    for (int i = 0; i < state.frames; ++i) {
+        total += state.history[i];
+    }
+    const float average = total / state.frames;
+    const float lastTwo = state.frames >= 2
+        ? state.history[(state.next + HISTORY_FRAMES - 1) % HISTORY_FRAMES]
+            + state.history[(state.next + HISTORY_FRAMES - 2) % HISTORY_FRAMES]
+        : 0.0f;
+    const int step = getStep(mode, configuredStep);
+    
+    // A sudden load (the sphere starting to move) is answered within two frames
+    const bool overBudget = (state.frames == HISTORY_FRAMES && average > state.targetMs)
+        || lastTwo > 4.0f * state.targetMs;
+    if (overBudget && step < MAX_STEP) {
+        // A halving undone before it held for refineDelay frames makes the next one wait
+        // longer; one that held, like the full step of a scene at rest, starts over
+        if (state.refined) {
+            state.refineDelay = state.framesAtStep < state.refineDelay
+                ? std::min(state.refineDelay * 2, MAX_REFINE_DELAY) : HISTORY_FRAMES;
+        }
+        changeStep(state, std::min(step * 2, MAX_STEP));
+        state.refined = false;
+        return;
+    }
+    if (state.frames == HISTORY_FRAMES && average < REFINE_HEADROOM * state.targetMs
+        && step / 2 >= configuredStep && state.framesAtStep >= state.refineDelay) {
+        changeStep(state, step / 2);
+        state.refined = true;
+    }
+}
+
+int FrameGovernor::getStepChanges() const {
+    return stepChanges;
+}
+
+void FrameGovernor::reset() {
+    for (ModeState& state : modes) {
+        state.step = 1;
+        state.frames = 0;
+        state.next = 0;
+        state.skipFrame = false;
+        state.framesAtStep = 0;
+        state.refineDelay = HISTORY_FRAMES;
+        state.refined = false;
+    }
+}
+
+void FrameGovernor::changeStep(ModeState& state, int step) {
+    state.step = step;
+    state.frames = 0;
+    state.next = 0;
+    state.skipFrame = true;
+    state.framesAtStep = 0;
+    ++stepChanges;
+}
@@ -0,0 +1,72 @@
+#include "../include/frametimingreport.hpp"
+#include "../include/renderer.hpp"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    // Nearest-rank percentile of sorted values
+    double percentile(const std::vector<double>& sorted, int percent) {
+        size_t rank = (sorted.size() * percent + 99) / 100;
+        return sorted[std::max<size_t>(rank, 1) - 1];
+    }
+}
+
+void FrameTimingReport::clear() {
+    frames.clear();
+}
+
+void FrameTimingReport::add(const FrameTiming& timing) {
+    frames.push_back(timing);
+}
+
+const std::vector<FrameTiming>& FrameTimingReport::getFrames() const {
+    return frames;
+}
+
+bool FrameTimingReport::save(const std::string& path, std::string& error) const {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        error = "cannot open " + path + " for writing";
+        return false;
+    }
+    
+    std::fprintf(file, "frame,delta_ms,update_ms,render_ms,mode,revision,rays_cast,pixels_shaded\n");
+    for (const FrameTiming& timing : frames) {
+        std::fprintf(file, "%d,%.3f,%.3f,%.3f,%s,%llu,%llu,%llu\n", timing.frame, timing.deltaTime * 1000.0f,
+                     timing.updateMs, timing.renderMs, timing.mode, static_cast<unsigned long long>(timing.revision),
+                     static_cast<unsigned long long>(timing.raysCast),
+                     static_cast<unsigned long long>(timing.pixelsShaded));
+    }
+    
+    if (std::fclose(file) != 0) {
+        error = "failed to write " + path;
+        return false;
+    }
+    return true;
+}
+
+void FrameTimingReport::printSummary() const {
+    if (frames.empty()) {
+        return;
+    }
+    
+    std::vector<double> renderMs;
+    renderMs.reserve(frames.size());
+    double totalRenderMs = 0.0;
+    double totalUpdateMs = 0.0;
+    for (const FrameTiming& timing : frames) {
+        renderMs.push_back(timing.renderMs);
+        totalRenderMs += timing.renderMs;
+        totalUpdateMs += timing.updateMs;
+    }
+    std::sort(renderMs.begin(), renderMs.end());
+    
+    std::printf("frames=%zu render_ms_avg=%.3f render_ms_p50=%.3f render_ms_p95=%.3f render_ms_max=%.3f "
+                "update_ms_avg=%.3f\n",
+                frames.size(), totalRenderMs / frames.size(), percentile(renderMs, 50), percentile(renderMs, 95),
+                renderMs.back(), totalUpdateMs / frames.size());
+}
+
+const char* FrameTimingReport::getModeName(const RenderSettings& settings) {
+    return settings.isRealRayTracing ? "rt" : settings.is2DMode ? "2d" : "shapes";
+}
@@ -0,0 +1,568 @@
+#include "../include/headless.hpp"
+#include "../include/scene.hpp"
+#include "../include/renderer.hpp"
+#include "../include/utils.hpp"
+#include "../include/profiler.hpp"
+#include "../include/scenefile.hpp"
+#include "../include/inputrecording.hpp"
+#include "../include/frametimingreport.hpp"
+#include "../include/distributed.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace {
+    bool parseInt(const char* text, int& value) {
+        char* end = nullptr;
+        errno = 0;
+        long parsed = std::strtol(text, &end, 10);
+        if (end == text || *end != '\0' || errno == ERANGE
+            || parsed < std::numeric_limits<int>::min() || parsed > std::numeric_limits<int>::max()) {
+            return false;
+        }
+        value = static_cast<int>(parsed);
+        return true;
+    }
+    
+    // Parses "x,y" or "x,y,z" into up to three floats
+    int parseFloatList(const char* text, float* values, int maxValues) {
+        int count = 0;
+        const char* cursor = text;
+        while (count < maxValues) {
+            char* end = nullptr;
+            float value = std::strtof(cursor, &end);
+            if (end == cursor) {
+                return -1;
+            }
+            values[count++] = value;
+            if (*end == '\0') {
+                return count;
+            }
+            if (*end != ',') {
+                return -1;
+            }
+            cursor = end + 1;
+        }
+        return -1;
+    }
+    
+    // Loads the scene file, if any, and applies the scene options on top
+    bool buildHeadlessScene(const HeadlessOptions& options, Scene& scene, std::string& error) {
+        if (options.useGrid) {
+            scene.setAccelerationStructure(AccelerationStructure::GRID);
+        }
+        
+        const std::string& path = options.scenePath;
+        if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".txt") == 0) {
+            std::vector<Sphere> spheres;
+            std::vector<Light> lights;
+            if (!SceneFile::parseText(path, spheres, lights, error)) {
+                return false;
+            }
+            scene.setContents(std::move(spheres), std::move(lights));
+        } else if (!path.empty() && !SceneFile::load(path, scene, error)) {
+            return false;
+        }
+        
+        if (options.hasSpherePosition) {
+            scene.setSpherePosition(options.spherePosition);
+        }
+        if (options.hasLightPosition) {
+            scene.setLightPosition(options.lightPosition);
+        }
+        if (options.hasSphereSurface) {
+            scene.setSphereSurface(options.sphereSurface);
+        }
+        for (const sf::Vector3f& sphere : options.extraSpheres) {
+            scene.addSphere(Sphere(sf::Vector2f(sphere.x, sphere.y), sphere.z));
+        }
+        for (const sf::Vector2f& position : options.extraLights) {
+            scene.addLight(Light(position, Utils::LIGHT_COLOR));
+        }
+        return true;
+    }
+}
+
+HeadlessOptions::HeadlessOptions()
+    : hasMode(false)
+    , use2DMode(false)
+    , width(Utils::WINDOW_WIDTH)
+    , height(Utils::WINDOW_HEIGHT)
+    , pixelStep(2)
+    , antiAliasing(false)
+    , coverageAntiAliasing(false)
+    , incremental(false)
+    , progressive(false)
+    , reprojectionInterval(0)
+    , adaptiveThreshold(-1)
+    , targetMs(0.0f)
+    , maxDepth(3)
+    , useGrid(false)
+    , threadCount(0)
+    , frameCount(1)
+    , outputPath("render.ppm")
+    , saveSceneBVH(true)
+    , workerCount(1)
+    , hasSpherePosition(false)
+    , spherePosition(0.f, 0.f)
+    , hasSphereSurface(false)
+    , sphereSurface(SurfaceType::DIFFUSE)
+    , hasLightPosition(false)
+    , lightPosition(0.f, 0.f) {
+}
+
+bool isHeadlessRequested(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseHeadlessOptions(int argc, char* argv[], HeadlessOptions& options, std::string& error) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            continue;
+        }
+        if (arg == "--help") {
+            error.clear(); // Usage only
+            return false;
+        }
+        if (arg == "--aa") {
+            options.antiAliasing = true;
+            continue;
+        }
+        if (arg == "--coverage-aa") {
+            options.coverageAntiAliasing = true;
+            continue;
+        }
+        if (arg == "--incremental") {
+            options.incremental = true;
+            continue;
+        }
+        if (arg == "--progressive") {
+            options.progressive = true;
+            continue;
+        }
+        if (arg == "--no-bvh") {
+            options.saveSceneBVH = false;
+            continue;
+        }
+        
+        // Every remaining option takes a value
+        if (i + 1 >= argc) {
+            error = "missing value for " + arg;
+            return false;
+        }
+        const char* value = argv[++i];
+        
+        int number = 0;
+        float values[3];
+        if (arg == "--mode") {
+            options.hasMode = true;
+            if (std::strcmp(value, "2d") == 0) {
+                options.use2DMode = true;
+            } else if (std::strcmp(value, "rt") == 0) {
+                options.use2DMode = false;
+            } else {
+                error = "unknown mode " + std::string(value);
+                return false;
+            }
+        } else if (arg == "--width" || arg == "--height") {
+            if (!parseInt(value, number) || number <= 0 || number > Utils::MAX_FRAME_SIZE) {
+                error = arg + " must be between 1 and " + std::to_string(Utils::MAX_FRAME_SIZE);
+                return false;
+            }
+            (arg == "--width" ? options.width : options.height) = static_cast<unsigned>(number);
+        } else if (arg == "--step") {
+            // Tiles must split evenly into sample blocks
+            if (!parseInt(value, number) || number <= 0 || Utils::RENDER_TILE_SIZE % number != 0) {
+                error = "pixel step must divide " + std::to_string(Utils::RENDER_TILE_SIZE);
+                return false;
+            }
+            options.pixelStep = number;
+        } else if (arg == "--adaptive") {
+            if (!parseInt(value, number) || number < 0 || number > 255) {
+                error = "adaptive threshold must be between 0 and 255";
+                return false;
+            }
+            options.adaptiveThreshold = number;
+        } else if (arg == "--target-ms") {
+            if (parseFloatList(value, values, 1) != 1 || values[0] < FrameGovernor::MIN_TARGET_MS
+                || values[0] > FrameGovernor::MAX_TARGET_MS) {
+                error = "frame time target must be between "
+                    + std::to_string(static_cast<int>(FrameGovernor::MIN_TARGET_MS)) + " and "
+                    + std::to_string(static_cast<int>(FrameGovernor::MAX_TARGET_MS)) + " ms";
+                return false;
+            }
+            options.targetMs = values[0];
+        } else if (arg == "--reproject") {
+            if (!parseInt(value, number) || number < 1 || number > ReprojectionCache::MAX_REFRESH_INTERVAL) {
+                error = "reprojection refresh interval must be between 1 and "
+                    + std::to_string(ReprojectionCache::MAX_REFRESH_INTERVAL);
+                return false;
+            }
+            options.reprojectionInterval = number;
+        } else if (arg == "--depth") {
+            if (!parseInt(value, number) || number <= 0) {
+                error = "invalid ray depth " + std::string(value);
+                return false;
+            }
+            options.maxDepth = number;
+        } else if (arg == "--accel") {
+            if (std::strcmp(value, "bvh") == 0) {
+                options.useGrid = false;
+            } else if (std::strcmp(value, "grid") == 0) {
+                options.useGrid = true;
+            } else {
+                error = "unknown acceleration structure " + std::string(value);
+                return false;
+            }
+        } else if (arg == "--surface") {
+            options.hasSphereSurface = true;
+            if (std::strcmp(value, "diffuse") == 0) {
+                options.sphereSurface = SurfaceType::DIFFUSE;
+            } else if (std::strcmp(value, "mirror") == 0) {
+                options.sphereSurface = SurfaceType::MIRROR;
+            } else if (std::strcmp(value, "glass") == 0) {
+                options.sphereSurface = SurfaceType::GLASS;
+            } else {
+                error = "unknown surface " + std::string(value);
+                return false;
+            }
+        } else if (arg == "--threads") {
+            if (!parseInt(value, number) || number < 0) {
+                error = "invalid thread count " + std::string(value);
+                return false;
+            }
+            // Each thread is a real one; past a few per core they only add overhead, and
+            // enough of them fail to start at all
+            if (static_cast<unsigned>(number) > ThreadPool::getMaxThreadCount()) {
+                error = "thread count must be at most " + std::to_string(ThreadPool::getMaxThreadCount());
+                return false;
+            }
+            options.threadCount = static_cast<unsigned>(number);
+        } else if (arg == "--frames") {
+            if (!parseInt(value, number) || number <= 0) {
+                error = "invalid frame count " + std::string(value);
+                return false;
+            }
+            options.frameCount = number;
+        } else if (arg == "--output") {
+            options.outputPath = value;
+        } else if (arg == "--trace") {
+            options.tracePath = value;
+        } else if (arg == "--replay") {
+            options.replayPath = value;
+        } else if (arg == "--report") {
+            options.reportPath = value;
+        } else if (arg == "--scene") {
+            options.scenePath = value;
+        } else if (arg == "--save-scene") {
+            options.saveScenePath = value;
+        } else if (arg == "--coordinator") {
+            options.coordinatorAddress = value;
+        } else if (arg == "--workers") {
+            if (!parseInt(value, number) || number <= 0) {
+                error = "invalid worker count " + std::string(value);
+                return false;
+            }
+            options.workerCount = number;
+        } else if (arg == "--worker") {
+            options.workerAddress = value;
+        } else if (arg == "--sphere" || arg == "--light" || arg == "--add-light") {
+            if (parseFloatList(value, values, 2) != 2) {
+                error = arg + " expects x,y";
+                return false;
+            }
+            sf::Vector2f position(values[0], values[1]);
+            if (arg == "--sphere") {
+                options.hasSpherePosition = true;
+                options.spherePosition = position;
+            } else if (arg == "--light") {
+                options.hasLightPosition = true;
+                options.lightPosition = position;
+            } else {
+                options.extraLights.push_back(position);
+            }
+        } else if (arg == "--add-sphere") {
+            if (parseFloatList(value, values, 3) != 3) {
+                error = "--add-sphere expects x,y,radius";
+                return false;
+            }
+            options.extraSpheres.push_back(sf::Vector3f(values[0], values[1], values[2]));
+        } else {
+            error = "unknown option " + arg;
+            return false;
+        }
+    }
+    
+    // Replays start in the window's default modes and switch them with the recorded keys
+    if (!options.replayPath.empty()
+        && (options.hasMode || options.incremental || options.progressive || options.adaptiveThreshold >= 0)) {
+        error = "--replay takes its modes from the recording and does not support --mode, --incremental, "
+            "--progressive or --adaptive";
+        return false;
+    }
+    
+    // The ray tracer samples every pixel or every other one; coarser steps are 2D only
+    if (!options.use2DMode && options.replayPath.empty() && options.pixelStep > 2) {
+        error = "rt mode takes a pixel step of 1 or 2";
+        return false;
+    }
+    
+    // Workers trace whole ray-traced frames from a static scene
+    if (!options.coordinatorAddress.empty()) {
+        if (!options.workerAddress.empty()) {
+            error = "--coordinator and --worker cannot be combined";
+            return false;
+        }
+        if (options.use2DMode || options.incremental || options.progressive || options.reprojectionInterval > 0
+            || options.targetMs > 0.0f || options.coverageAntiAliasing || !options.replayPath.empty()) {
+            error = "distributed rendering does not support --mode 2d, --incremental, --progressive, --reproject, "
+                "--target-ms, --coverage-aa or --replay";
+            return false;
+        }
+    }
+    return true;
+}
+
+int runHeadless(const HeadlessOptions& options) {
+    // Worker processes take the scene and settings from the coordinator
+    if (!options.workerAddress.empty()) {
+        RenderWorker worker(options.threadCount);
+        std::string error;
+        if (!worker.run(options.workerAddress, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::printf("worker finished, rendered %d jobs\n", worker.getRenderedJobCount());
+        return 0;
+    }
+    
+    Renderer renderer;
+    Scene scene;
+    scene.setThreadPool(&renderer.getThreadPool());
+    std::string error;
+    if (!buildHeadlessScene(options, scene, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    
+    // Conversion mode: the assembled scene is written out instead of rendered
+    if (!options.saveScenePath.empty()) {
+        if (!SceneFile::save(options.saveScenePath, scene, options.saveSceneBVH, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::printf("spheres=%zu lights=%zu bvh=%s wrote %s\n", scene.getSpheres().size(), scene.getLights().size(),
+                    options.saveSceneBVH ? "yes" : "no", options.saveScenePath.c_str());
+        return 0;
+    }
+    
+    std::vector<FrameInput> replay;
+    if (!options.replayPath.empty() && !InputRecording::load(options.replayPath, replay, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    
+    renderer.setResolution(options.width, options.height);
+    renderer.setThreadCount(options.threadCount);
+    renderer.setPixelStep(options.pixelStep);
+    renderer.getRayTracer().setAntiAliasing(options.antiAliasing || options.pixelStep == 1);
+    renderer.getRayTracer().setMaxDepth(options.maxDepth);
+    renderer.setCoverageAntiAliasing(options.coverageAntiAliasing);
+    // A replay starts from the interactive defaults, like the window it was recorded
+    // in, and its recorded key presses switch the modes
+    if (replay.empty()) {
+        renderer.setIncrementalRendering(options.incremental);
+        renderer.setProgressiveRendering(options.progressive);
+        if (options.adaptiveThreshold >= 0) {
+            renderer.setAdaptiveSampling(true);
+            renderer.setAdaptiveThreshold(options.adaptiveThreshold);
+        }
+        if (options.use2DMode) {
+            renderer.toggle2DMode();
+        } else {
+            renderer.toggleRealRayTracing();
+        }
+    }
+    // Unlike the other modes, reprojection and the frame governor are also forced on for replays,
+    // to compare a recording with and without them
+    if (options.reprojectionInterval > 0) {
+        renderer.setTemporalReprojection(true);
+        renderer.setReprojectionRefreshInterval(options.reprojectionInterval);
+    }
+    if (options.targetMs > 0.0f) {
+        renderer.setFrameGovernor(true);
+        renderer.setFrameTargetMs(GovernedMode::MODE_2D, options.targetMs);
+        renderer.setFrameTargetMs(GovernedMode::RAY_TRACING, options.targetMs);
+    }
+    
+    const bool distributed = !options.coordinatorAddress.empty();
+    RenderCoordinator coordinator;
+    DistributedRenderSettings distributedSettings;
+    if (distributed) {
+        distributedSettings.width = options.width;
+        distributedSettings.height = options.height;
+        distributedSettings.antiAliasing = options.antiAliasing || options.pixelStep == 1;
+        distributedSettings.maxDepth = options.maxDepth;
+        distributedSettings.adaptiveThreshold = options.adaptiveThreshold;
+        if (!coordinator.listen(options.coordinatorAddress, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::printf("waiting for %d workers on %s\n", options.workerCount, options.coordinatorAddress.c_str());
+        std::fflush(stdout);
+        if (!coordinator.waitForWorkers(options.workerCount, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    
+    if (!options.tracePath.empty()) {
+        Profiler::setCapturing(true);
+    }
+    
+    // Only the trace itself is timed; scene setup and image encoding are excluded
+    const int frameCount = replay.empty() ? options.frameCount : static_cast<int>(replay.size());
+    InputHandler inputHandler;
+    FrameTimingReport report;
+    double totalMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    int reissuedJobs = 0;
+    int lostWorkers = 0;
+    uint64_t shadedPixels = 0;
+    uint64_t reprojectedPixels = 0;
+    bool tracedAnyFrame = false;
+    for (int frame = 0; frame < frameCount; ++frame) {
+        Profiler::beginFrame();
+        auto start = std::chrono::steady_clock::now();
+        if (!replay.empty()) {
+            inputHandler.apply(replay[frame], scene, renderer);
+        }
+        auto traceStart = std::chrono::steady_clock::now();
+        if (distributed) {
+            if (!coordinator.traceFrame(scene, distributedSettings, renderer.getFrameBuffer(), error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+            reissuedJobs += coordinator.getLastFrameStats().reissuedJobs;
+            lostWorkers += coordinator.getLastFrameStats().lostWorkers;
+        } else {
+            renderer.traceFrame(scene);
+        }
+        tracedAnyFrame = tracedAnyFrame || distributed || renderer.is2DMode() || renderer.isRealRayTracing();
+        auto end = std::chrono::steady_clock::now();
+        Profiler::endFrame();
+        
+        double ms = std::chrono::duration<double, std::milli>(end - traceStart).count();
+        totalMs += ms;
+        minMs = frame == 0 ? ms : std::min(minMs, ms);
+        maxMs = frame == 0 ? ms : std::max(maxMs, ms);
+        
+        const ProfileFrameStats& stats = Profiler::getLastFrame();
+        FrameTiming timing;
+        timing.frame = frame;
+        timing.deltaTime = replay.empty() ? 0.0f : replay[frame].deltaTime;
+        timing.updateMs = std::chrono::duration<double, std::milli>(traceStart - start).count();
+        timing.renderMs = ms;
+        timing.mode = FrameTimingReport::getModeName(renderer.getSettings());
+        timing.revision = scene.getRevision();
+        timing.raysCast = stats.counters[static_cast<int>(ProfileCounter::RAYS_CAST)];
+        timing.pixelsShaded = stats.counters[static_cast<int>(ProfileCounter::PIXELS_SHADED)];
+        report.add(timing);
+        shadedPixels += timing.pixelsShaded;
+        reprojectedPixels += stats.counters[static_cast<int>(ProfileCounter::PIXELS_REPROJECTED)];
+    }
+    
+    // A replay that never switches a trace mode on would leave the image blank
+    if (!tracedAnyFrame) {
+        std::cerr << options.replayPath << " never enables ray tracing or 2D mode; nothing was rendered" << std::endl;
+        return 1;
+    }
+    
+    const RenderSettings settings = renderer.getSettings();
+    std::printf("mode=%s resolution=%ux%u threads=%u frames=%d trace_ms_avg=%.3f trace_ms_min=%.3f trace_ms_max=%.3f\n",
+                FrameTimingReport::getModeName(settings), options.width, options.height, renderer.getThreadCount(),
+                frameCount, totalMs / frameCount, minMs, maxMs);
+    if (distributed) {
+        std::printf("workers=%d jobs_per_frame=%d jobs_reissued=%d workers_lost=%d\n", coordinator.getWorkerCount(),
+                    coordinator.getLastFrameStats().jobs, reissuedJobs, lostWorkers);
+    }
+    if (settings.isTemporalReprojection) {
+        // Sample counts come from the profiler, so they read 0 in builds without it
+        std::printf("refresh_interval=%d pixels_shaded=%llu pixels_reprojected=%llu\n",
+                    settings.reprojectionRefreshInterval, static_cast<unsigned long long>(shadedPixels),
+                    static_cast<unsigned long long>(reprojectedPixels));
+    }
+    if (settings.isFrameGovernor) {
+        std::printf("target_ms=%.3f final_step=%d step_changes=%d\n", options.targetMs, renderer.getSamplingStep(),
+                    renderer.getFrameGovernor().getStepChanges());
+    }
+    
+    if (!options.reportPath.empty()) {
+        report.printSummary();
+        if (!report.save(options.reportPath, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    
+    if (!options.tracePath.empty() && !Profiler::exportChromeTrace(options.tracePath)) {
+        std::cerr << "Failed to write " << options.tracePath << std::endl;
+        return 1;
+    }
+    
+    if (!renderer.getFrameBuffer().saveToFile(options.outputPath)) {
+        std::cerr << "Failed to write " << options.outputPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+void printHeadlessUsage() {
+    std::cerr <<
+        "Usage: ray-tracing --headless [options]\n"
+        "  --mode rt|2d          Render path (default rt)\n"
+        "  --width N --height N  Output resolution\n"
+        "  --step N              Sample every N pixels; rt mode takes 1 (anti-aliased) or 2\n"
+        "  --aa                  Enable ray tracer anti-aliasing\n"
+        "  --coverage-aa         One sample per pixel, blending the pixels hard edges cross by their coverage\n"
+        "  --adaptive T          Quadtree sampling; blocks whose displayed corner colours differ by at most\n"
+        "                        T (0-255) are filled\n"
+        "  --incremental         Re-trace only changed regions after the first frame\n"
+        "  --target-ms MS        Coarsen the pixel step while frames trace slower than MS, upscaling edge-aware\n"
+        "  --progressive         Accumulate jittered anti-aliasing samples over frames (rt mode)\n"
+        "  --reproject N         Reuse the previous frame's shadow queries where still valid, tracing every\n"
+        "                        pixel again after N moving frames (rt mode)\n"
+        "  --depth N             Ray bounces per pixel in rt mode, including the first hit (default 3)\n"
+        "  --accel bvh|grid      Acceleration structure for rt mode (default bvh)\n"
+        "  --threads N           Worker threads, 0 for all cores; at most 4 per core\n"
+        "  --frames N            Render N frames and report trace timing\n"
+        "  --sphere x,y          Position of the main sphere\n"
+        "  --surface S           Main sphere surface: diffuse, mirror or glass (rt mode)\n"
+        "  --light x,y           Position of the main light\n"
+        "  --add-sphere x,y,r    Add an extra sphere\n"
+        "  --add-light x,y       Add an extra light\n"
+        "  --output FILE         Output image (.ppm, or .png via SFML)\n"
+        "  --trace FILE          Write a Chrome/Perfetto trace of the rendered frames\n"
+        "  --replay FILE         Drive the frames with a recorded input file, starting in the window's modes\n"
+        "  --report FILE         Write per-frame timings as CSV and print a summary\n"
+        "  --scene FILE          Load a binary scene file, or a text scene if FILE ends in .txt\n"
+        "  --save-scene FILE     Write the scene as a binary scene file instead of rendering\n"
+        "  --no-bvh              Leave the prebuilt BVH out of the saved scene file\n"
+        "  --coordinator ADDR    Trace the frames on render workers connecting to ADDR\n"
+        "                        (tcp:HOST:PORT or unix:PATH)\n"
+        "  --workers N           Workers to wait for before the first frame (default 1)\n"
+        "  --worker ADDR         Run as a render worker for the coordinator at ADDR\n";
+}
@@ -0,0 +1,208 @@
+#include "../include/inputrecording.hpp"
+#include "../include/scene.hpp"
+#include "../include/renderer.hpp"
+#include "../include/profiler.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace {
+    constexpr uint32_t keyBit(InputKey key) {
+        return 1u << static_cast<int>(key);
+    }
+    
+    constexpr uint32_t ALL_KEYS = keyBit(InputKey::COUNT) - 1;
+    
+    // Keyboard key behind each InputKey, in enum order
+    const sf::Keyboard::Key KEYBOARD_KEYS[static_cast<int>(InputKey::COUNT)] = {
+        sf::Keyboard::Left,
+        sf::Keyboard::Right,
+        sf::Keyboard::Up,
+        sf::Keyboard::Down,
+        sf::Keyboard::R,
+        sf::Keyboard::T,
+        sf::Keyboard::PageUp,
+        sf::Keyboard::PageDown,
+        sf::Keyboard::Num2,
+        sf::Keyboard::Num3,
+        sf::Keyboard::M,
+        sf::Keyboard::I,
+        sf::Keyboard::A,
+        sf::Keyboard::F,
+        sf::Keyboard::G,
+        sf::Keyboard::B,
+        sf::Keyboard::D,
+        sf::Keyboard::P,
+        sf::Keyboard::C,
+        sf::Keyboard::E,
+        sf::Keyboard::Q,
+        sf::Keyboard::V
+    };
+}
+
+FrameInput::FrameInput()
+    : mousePosition(0, 0)
+    , keys(0)
+    , deltaTime(0.0f) {
+}
+
+bool FrameInput::isDown(InputKey key) const {
+    return (keys & keyBit(key)) != 0;
+}
+
+void FrameInput::setDown(InputKey key, bool down) {
+    if (down) {
+        keys |= keyBit(key);
+    } else {
+        keys &= ~keyBit(key);
+    }
+}
+
+FrameInput FrameInput::poll(const sf::RenderWindow& window, float deltaTime) {
+    FrameInput input;
+    input.mousePosition = sf::Mouse::getPosition(window);
+    input.deltaTime = deltaTime;
+    for (int key = 0; key < static_cast<int>(InputKey::COUNT); ++key) {
+        input.setDown(static_cast<InputKey>(key), sf::Keyboard::isKeyPressed(KEYBOARD_KEYS[key]));
+    }
+    return input;
+}
+
+InputHandler::InputHandler()
+    : heldKeys(0)
+    , pressedKeys(0) {
+}
+
+void InputHandler::apply(const FrameInput& input, Scene& scene, Renderer& renderer) {
+    pressedKeys = input.keys & ~heldKeys;
+    heldKeys = input.keys;
+    
+    if (wasPressed(InputKey::DEBUG_MODE)) {
+        renderer.toggleDebugMode();
+    }
+    if (wasPressed(InputKey::RAY_DISPLAY_MODE)) {
+        renderer.cycleRayDisplayMode();
+    }
+    // Page Up and Page Down scale the number of debug rays cast in all directions
+    if (wasPressed(InputKey::MORE_DEBUG_RAYS)) {
+        renderer.setDebugRayCount(renderer.getDebugRayCount() * 10);
+    }
+    if (wasPressed(InputKey::FEWER_DEBUG_RAYS)) {
+        renderer.setDebugRayCount(renderer.getDebugRayCount() / 10);
+    }
+    if (wasPressed(InputKey::MODE_2D)) {
+        renderer.toggle2DMode();
+    }
+    if (wasPressed(InputKey::REAL_RAY_TRACING)) {
+        renderer.toggleRealRayTracing();
+    }
+    if (wasPressed(InputKey::PARALLEL_RENDERING)) {
+        renderer.toggleParallelRendering();
+    }
+    if (wasPressed(InputKey::INCREMENTAL_RENDERING)) {
+        renderer.toggleIncrementalRendering();
+    }
+    if (wasPressed(InputKey::ADAPTIVE_SAMPLING)) {
+        renderer.toggleAdaptiveSampling();
+    }
+    if (wasPressed(InputKey::PROGRESSIVE_RENDERING)) {
+        renderer.toggleProgressiveRendering();
+    }
+    if (wasPressed(InputKey::TEMPORAL_REPROJECTION)) {
+        renderer.toggleTemporalReprojection();
+    }
+    if (wasPressed(InputKey::FRAME_GOVERNOR)) {
+        renderer.toggleFrameGovernor();
+    }
+    if (wasPressed(InputKey::COVERAGE_ANTI_ALIASING)) {
+        renderer.toggleCoverageAntiAliasing();
+    }
+    // G cycles the interactive sphere between a diffuse, mirror and glass surface
+    if (wasPressed(InputKey::SPHERE_SURFACE)) {
+        SurfaceType surface = scene.getSphere().getSurface();
+        scene.setSphereSurface(surface == SurfaceType::DIFFUSE ? SurfaceType::MIRROR
+                               : surface == SurfaceType::MIRROR ? SurfaceType::GLASS
+                               : SurfaceType::DIFFUSE);
+    }
+    if (wasPressed(InputKey::ACCELERATION_STRUCTURE)) {
+        scene.setAccelerationStructure(scene.getAccelerationStructure() == AccelerationStructure::BVH
+                                       ? AccelerationStructure::GRID : AccelerationStructure::BVH);
+    }
+    
+    PROFILE_ZONE("Scene::update");
+    scene.handleInput(input.mousePosition, input.isDown(InputKey::LEFT), input.isDown(InputKey::RIGHT),
+                      input.isDown(InputKey::UP), input.isDown(InputKey::DOWN));
+    scene.update(input.deltaTime);
+}
+
+bool InputHandler::wasPressed(InputKey key) const {
+    return (pressedKeys & keyBit(key)) != 0;
+}
+
+namespace InputRecording {
+    bool save(const std::string& path, const std::vector<FrameInput>& frames, std::string& error) {
+        std::ofstream file(path);
+        if (!file) {
+            error = "cannot open " + path + " for writing";
+            return false;
+        }
+        
+        file << "rtinput " << VERSION << "\n";
+        char line[96];
+        for (const FrameInput& frame : frames) {
+            // Nine significant digits read back as the same float
+            std::snprintf(line, sizeof(line), "%.9g %d %d %u\n", frame.deltaTime, frame.mousePosition.x,
+                          frame.mousePosition.y, static_cast<unsigned>(frame.keys));
+            file << line;
+        }
+        
+        if (!file.flush()) {
+            error = "failed to write " + path;
+            return false;
+        }
+        return true;
+    }
+    
+    bool load(const std::string& path, std::vector<FrameInput>& frames, std::string& error) {
+        std::ifstream file(path);
+        if (!file) {
+            error = "cannot open " + path;
+            return false;
+        }
+        
+        std::string text;
+        std::string magic;
+        int version = 0;
+        if (!std::getline(file, text) || !(std::istringstream(text) >> magic >> version) || magic != "rtinput") {
+            error = path + " is not an input recording";
+            return false;
+        }
+        if (version != VERSION) {
+            error = path + " has unsupported version " + std::to_string(version);
+            return false;
+        }
+        
+        frames.clear();
+        for (int lineNumber = 2; std::getline(file, text); ++lineNumber) {
+            std::istringstream line(text);
+            FrameInput frame;
+            unsigned keys = 0;
+            if (!(line >> frame.deltaTime >> frame.mousePosition.x >> frame.mousePosition.y >> keys)
+                || frame.deltaTime < 0.0f || (keys & ~ALL_KEYS) != 0) {
+                if (text.find_first_not_of(" \t\r") == std::string::npos) {
+                    continue;
+                }
+                error = path + ":" + std::to_string(lineNumber) + ": expected DELTA_TIME MOUSE_X MOUSE_Y KEYS";
+                return false;
+            }
+            frame.keys = keys;
+            frames.push_back(frame);
+        }
+        
+        if (frames.empty()) {
+            error = path + " has no frames";
+            return false;
+        }
+        return true;
+    }
+}
@@ -2,77 +2,174 @@
 #include "../include/scene.hpp"
 #include "../include/renderer.hpp"
 #include "../include/utils.hpp"
+#include "../include/headless.hpp"
+#include "../include/profiler.hpp"
+#include "../include/renderthread.hpp"
+#include "../include/inputrecording.hpp"
+#include "../include/frametimingreport.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (isHeadlessRequested(argc, argv)) {
+        HeadlessOptions options;
+        std::string error;
+        if (!parseHeadlessOptions(argc, argv, options, error)) {
+            if (!error.empty()) {
+                std::cerr << error << std::endl;
+            }
+            printHeadlessUsage();
+            return 1;
+        }
+        return runHeadless(options);
+    }
+    
+    // --record FILE saves this session's input, --replay FILE plays one back in place of
+    // the keyboard and mouse, and --report FILE writes per-frame timings
+    std::string recordPath;
+    std::string replayPath;
+    std::string reportPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if ((arg == "--record" || arg == "--replay" || arg == "--report") && i + 1 < argc) {
+            (arg == "--record" ? recordPath : arg == "--replay" ? replayPath : reportPath) = argv[++i];
+        } else {
+            std::cerr << "Usage: ray-tracing [--record FILE] [--replay FILE] [--report FILE]\n"
+                         "       ray-tracing --headless --help" << std::endl;
+            return 1;
+        }
+    }
+    
+    std::vector<FrameInput> replay;
+    size_t replayFrame = 0;
+    std::string error;
+    if (!replayPath.empty() && !InputRecording::load(replayPath, replay, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    
     sf::RenderWindow window(sf::VideoMode(Utils::WINDOW_WIDTH, Utils::WINDOW_HEIGHT), "Ray Tracing");
-    window.setFramerateLimit(Utils::FRAME_RATE_LIMIT);
+    // A replay runs unthrottled so its timings show the renderer, not the frame limit
+    window.setFramerateLimit(replay.empty() ? Utils::FRAME_RATE_LIMIT : 0);
 
     Scene scene;
     Renderer renderer;
+    scene.setThreadPool(&renderer.getThreadPool());
+    // Traces the 2D and ray tracing modes off the main thread while it exists
+    std::unique_ptr<RenderThread> renderThread;
     
     sf::Clock clock;
-    bool rKeyPressed = false;
-    bool tKeyPressed = false; 
-    bool twoKeyPressed = false;
-    bool threeKeyPressed = false;
+    InputHandler inputHandler;
+    std::vector<FrameInput> recording;
+    FrameTimingReport report;
     
     while (window.isOpen()) {
+        Profiler::beginFrame();
         float deltaTime = clock.restart().asSeconds();
         
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed) {
-                window.close();
+        {
+            PROFILE_ZONE("events");
+            sf::Event event;
+            while (window.pollEvent(event)) {
+                if (event.type == sf::Event::Closed) {
+                    window.close();
+                }
             }
         }
-
-        sf::Vector2i mousePos = sf::Mouse::getPosition(window);
-        bool leftPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Left);
-        bool rightPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Right);
-        bool upPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Up);
-        bool downPressed = sf::Keyboard::isKeyPressed(sf::Keyboard::Down);
         
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::R)) {
-            if (!rKeyPressed) {
-                renderer.toggleDebugMode();
-                rKeyPressed = true;
-            }
+        FrameInput input;
+        if (replay.empty()) {
+            input = FrameInput::poll(window, deltaTime);
+        } else if (replayFrame < replay.size()) {
+            input = replay[replayFrame++];
         } else {
-            rKeyPressed = false;
+            window.close();
+            Profiler::endFrame();
+            break;
+        }
+        if (!recordPath.empty()) {
+            recording.push_back(input);
         }
         
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::T)) {
-            if (!tKeyPressed) {
-                renderer.cycleRayDisplayMode();
-                tKeyPressed = true;
+        sf::Clock frameClock;
+        inputHandler.apply(input, scene, renderer);
+        const float updateSeconds = frameClock.restart().asSeconds();
+        
+        // D moves tracing to a render thread and back
+        if (inputHandler.wasPressed(InputKey::RENDER_THREAD)) {
+            if (renderThread) {
+                renderThread.reset();
+            } else {
+                renderThread = std::make_unique<RenderThread>(Utils::WINDOW_WIDTH, Utils::WINDOW_HEIGHT);
             }
-        } else {
-            tKeyPressed = false;
         }
         
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Num2)) {
-            if (!twoKeyPressed) {
-                renderer.toggle2DMode();
-                twoKeyPressed = true;
-            }
-        } else {
-            twoKeyPressed = false;
+        if (inputHandler.wasPressed(InputKey::PROFILER_OVERLAY)) {
+            Profiler::toggleOverlay();
         }
         
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Num3)) {
-            if (!threeKeyPressed) {
-                renderer.toggleRealRayTracing();
-                threeKeyPressed = true;
+        // C starts a trace capture; pressing it again writes the Chrome trace file
+        if (inputHandler.wasPressed(InputKey::TRACE_CAPTURE)) {
+            if (Profiler::isCapturing()) {
+                Profiler::setCapturing(false);
+                Profiler::setEnabled(Profiler::isOverlayVisible());
+                if (Profiler::exportChromeTrace("profile_trace.json")) {
+                    std::cout << "Wrote profile_trace.json" << std::endl;
+                }
+            } else {
+                Profiler::setCapturing(true);
             }
+        }
+        
+        if (renderThread && (renderer.isRealRayTracing() || renderer.is2DMode())) {
+            // Never waits for the trace: shows the newest finished frame under overlays
+            // drawn from the current scene
+            renderThread->submit(scene, renderer.getSettings());
+            renderer.clearWindow(window);
+            renderThread->present(window);
+            renderer.drawTraceOverlays(window, scene);
         } else {
-            threeKeyPressed = false;
+            renderer.renderScene(window, scene);
         }
+        const float renderSeconds = frameClock.restart().asSeconds();
+        Profiler::drawOverlay(window);
         
-        scene.handleInput(mousePos, leftPressed, rightPressed, upPressed, downPressed);
-        scene.update(deltaTime);
+        {
+            PROFILE_ZONE("window.display");
+            window.display();
+        }
+        Profiler::endFrame();
         
-        renderer.renderScene(window, scene);
-        window.display();
+        if (!reportPath.empty()) {
+            const ProfileFrameStats& stats = Profiler::getLastFrame();
+            FrameTiming timing;
+            timing.frame = static_cast<int>(report.getFrames().size());
+            timing.deltaTime = input.deltaTime;
+            timing.updateMs = updateSeconds * 1000.0;
+            timing.renderMs = renderSeconds * 1000.0;
+            timing.mode = FrameTimingReport::getModeName(renderer.getSettings());
+            timing.revision = scene.getRevision();
+            timing.raysCast = stats.counters[static_cast<int>(ProfileCounter::RAYS_CAST)];
+            timing.pixelsShaded = stats.counters[static_cast<int>(ProfileCounter::PIXELS_SHADED)];
+            report.add(timing);
+        }
+    }
+    
+    if (!recordPath.empty()) {
+        if (!InputRecording::save(recordPath, recording, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::cout << "Recorded " << recording.size() << " frames to " << recordPath << std::endl;
+    }
+    if (!reportPath.empty()) {
+        report.printSummary();
+        if (!report.save(reportPath, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
     }
     return 0;
 }
\ No newline at end of file
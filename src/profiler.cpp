@@ -0,0 +1,381 @@
+#include "../include/profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace {
+    constexpr int MAX_ZONES = 64;
+    constexpr int COUNTER_COUNT = static_cast<int>(ProfileCounter::COUNT);
+    constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+    constexpr float OVERLAY_WIDTH = 380.0f;
+    constexpr float OVERLAY_LINE_HEIGHT = 18.0f;
+    constexpr double OVERLAY_BUDGET_MS = 1000.0 / 60.0; // Full bar width
+    
+    struct TraceEvent {
+        int zoneId;
+        uint64_t start;
+        uint64_t end;
+    };
+    
+    struct CounterSample {
+        uint64_t timestamp;
+        uint64_t counters[COUNTER_COUNT];
+    };
+    
+    // Each thread only writes its own slots, so updates need no read-modify-write
+    struct ThreadData {
+        uint32_t threadId;
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+        std::atomic<uint64_t> zoneNs[MAX_ZONES];
+        std::atomic<uint64_t> zoneCalls[MAX_ZONES];
+        std::mutex eventMutex;
+        std::vector<TraceEvent> events;
+    };
+    
+    struct ProfilerState {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadData>> threads;
+        std::vector<const char*> zoneNames;
+        std::atomic<bool> enabled;
+        std::atomic<bool> capturing;
+        bool overlayVisible;
+        std::chrono::steady_clock::time_point epoch;
+        
+        uint64_t frameStart;
+        uint64_t previousCounters[COUNTER_COUNT];
+        uint64_t previousZoneNs[MAX_ZONES];
+        uint64_t previousZoneCalls[MAX_ZONES];
+        ProfileFrameStats lastFrame;
+        std::vector<CounterSample> counterSamples;
+        
+        sf::Font font;
+        bool fontLoaded;
+        bool fontAttempted;
+        
+        ProfilerState()
+            : enabled(false)
+            , capturing(false)
+            , overlayVisible(false)
+            , epoch(std::chrono::steady_clock::now())
+            , frameStart(0)
+            , fontLoaded(false)
+            , fontAttempted(false) {
+            std::fill(previousCounters, previousCounters + COUNTER_COUNT, 0);
+            std::fill(previousZoneNs, previousZoneNs + MAX_ZONES, 0);
+            std::fill(previousZoneCalls, previousZoneCalls + MAX_ZONES, 0);
+            lastFrame.frameMs = 0.0;
+            std::fill(lastFrame.counters, lastFrame.counters + COUNTER_COUNT, 0);
+        }
+    };
+    
+    ProfilerState& state() {
+        static ProfilerState profilerState;
+        return profilerState;
+    }
+    
+    ThreadData& threadData() {
+        thread_local ThreadData* data = nullptr;
+        if (!data) {
+            // Thread data is owned by the profiler so totals survive thread exit
+            ProfilerState& s = state();
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.threads.push_back(std::make_unique<ThreadData>());
+            data = s.threads.back().get();
+            data->threadId = static_cast<uint32_t>(s.threads.size());
+            for (auto& counter : data->counters) counter.store(0);
+            for (auto& zone : data->zoneNs) zone.store(0);
+            for (auto& calls : data->zoneCalls) calls.store(0);
+        }
+        return *data;
+    }
+    
+    void bump(std::atomic<uint64_t>& slot, uint64_t amount) {
+        slot.store(slot.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+    
+    void writeJsonString(std::ofstream& out, const std::string& text) {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\';
+            }
+            out << c;
+        }
+        out << '"';
+    }
+    
+    const sf::Color ZONE_COLORS[] = {
+        sf::Color(230, 120, 60), sf::Color(80, 170, 230), sf::Color(120, 210, 90),
+        sf::Color(220, 200, 70), sf::Color(190, 110, 220), sf::Color(90, 220, 200)
+    };
+}
+
+namespace Profiler {
+    void setEnabled(bool enabled) {
+        state().enabled.store(enabled);
+    }
+    
+    bool isEnabled() {
+        return state().enabled.load(std::memory_order_relaxed);
+    }
+    
+    uint64_t now() {
+        // Never zero, so zero can mean "not started"
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - state().epoch).count()) + 1;
+    }
+    
+    int registerZone(const char* name) {
+        ProfilerState& s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (size_t i = 0; i < s.zoneNames.size(); ++i) {
+            if (std::strcmp(s.zoneNames[i], name) == 0) {
+                return static_cast<int>(i);
+            }
+        }
+        if (s.zoneNames.size() >= MAX_ZONES) {
+            return MAX_ZONES - 1; // Overflow shares the last slot
+        }
+        s.zoneNames.push_back(name);
+        return static_cast<int>(s.zoneNames.size() - 1);
+    }
+    
+    void recordZone(int zoneId, uint64_t start, uint64_t end, bool traceEvent) {
+        ThreadData& data = threadData();
+        bump(data.zoneNs[zoneId], end - start);
+        bump(data.zoneCalls[zoneId], 1);
+        
+        if (traceEvent && state().capturing.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(data.eventMutex);
+            if (data.events.size() < MAX_EVENTS_PER_THREAD) {
+                data.events.push_back({ zoneId, start, end });
+            }
+        }
+    }
+    
+    void addCount(ProfileCounter counter, uint64_t amount) {
+        bump(threadData().counters[static_cast<int>(counter)], amount);
+    }
+    
+    void beginFrame() {
+        state().frameStart = now();
+    }
+    
+    void endFrame() {
+        ProfilerState& s = state();
+        uint64_t frameEnd = now();
+        
+        uint64_t counters[COUNTER_COUNT] = {};
+        uint64_t zoneNs[MAX_ZONES] = {};
+        uint64_t zoneCalls[MAX_ZONES] = {};
+        // Names are copied as pointers, and frame.zones keeps its capacity, so a frame
+        // allocates nothing once every zone has been seen
+        const char* zoneNames[MAX_ZONES];
+        size_t zoneCount = 0;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            zoneCount = s.zoneNames.size();
+            std::copy(s.zoneNames.begin(), s.zoneNames.end(), zoneNames);
+            for (const auto& thread : s.threads) {
+                for (int i = 0; i < COUNTER_COUNT; ++i) {
+                    counters[i] += thread->counters[i].load(std::memory_order_relaxed);
+                }
+                for (int i = 0; i < MAX_ZONES; ++i) {
+                    zoneNs[i] += thread->zoneNs[i].load(std::memory_order_relaxed);
+                    zoneCalls[i] += thread->zoneCalls[i].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        
+        // Totals only grow, so a frame is the difference to the previous snapshot
+        ProfileFrameStats& frame = s.lastFrame;
+        frame.frameMs = s.frameStart ? (frameEnd - s.frameStart) / 1e6 : 0.0;
+        frame.zones.clear();
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            frame.counters[i] = counters[i] - s.previousCounters[i];
+            s.previousCounters[i] = counters[i];
+        }
+        for (size_t i = 0; i < zoneCount; ++i) {
+            uint64_t calls = zoneCalls[i] - s.previousZoneCalls[i];
+            if (calls > 0) {
+                frame.zones.push_back({ zoneNames[i], (zoneNs[i] - s.previousZoneNs[i]) / 1e6, calls });
+            }
+            s.previousZoneNs[i] = zoneNs[i];
+            s.previousZoneCalls[i] = zoneCalls[i];
+        }
+        
+        if (s.capturing.load()) {
+            CounterSample sample;
+            sample.timestamp = frameEnd;
+            std::copy(frame.counters, frame.counters + COUNTER_COUNT, sample.counters);
+            s.counterSamples.push_back(sample);
+        }
+    }
+    
+    const ProfileFrameStats& getLastFrame() {
+        return state().lastFrame;
+    }
+    
+    void setCapturing(bool capturing) {
+        state().capturing.store(capturing);
+        if (capturing) {
+            setEnabled(true);
+        }
+    }
+    
+    bool isCapturing() {
+        return state().capturing.load();
+    }
+    
+    bool exportChromeTrace(const std::string& path) {
+        ProfilerState& s = state();
+        std::ofstream out(path);
+        if (!out) {
+            return false;
+        }
+        
+        std::lock_guard<std::mutex> lock(s.mutex);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        
+        // Timestamps are microseconds in the trace event format
+        for (const auto& thread : s.threads) {
+            std::lock_guard<std::mutex> eventLock(thread->eventMutex);
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->threadId
+                << ",\"args\":{\"name\":\"" << (thread->threadId == 1 ? "main" : "worker") << "\"}}";
+            first = false;
+            
+            for (const TraceEvent& event : thread->events) {
+                out << ",\n{\"name\":";
+                writeJsonString(out, s.zoneNames[event.zoneId]);
+                out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->threadId
+                    << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+            }
+            thread->events.clear();
+        }
+        
+        for (const CounterSample& sample : s.counterSamples) {
+            out << (first ? "" : ",\n") << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":" << sample.timestamp / 1000.0 << ",\"args\":{";
+            first = false;
+            for (int i = 0; i < COUNTER_COUNT; ++i) {
+                out << (i ? "," : "") << "\"" << getCounterName(static_cast<ProfileCounter>(i)) << "\":" << sample.counters[i];
+            }
+            out << "}}";
+        }
+        s.counterSamples.clear();
+        
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+    
+    void toggleOverlay() {
+        ProfilerState& s = state();
+        s.overlayVisible = !s.overlayVisible;
+        if (s.overlayVisible) {
+            setEnabled(true);
+        } else if (!isCapturing()) {
+            setEnabled(false);
+        }
+    }
+    
+    bool isOverlayVisible() {
+        return state().overlayVisible;
+    }
+    
+    void drawOverlay(sf::RenderWindow& window) {
+        ProfilerState& s = state();
+        if (!s.overlayVisible) {
+            return;
+        }
+        
+        // Text needs a font file; without one the overlay falls back to bars only
+        if (!s.fontAttempted) {
+            s.fontAttempted = true;
+            const char* fontPaths[] = {
+                "assets/font.ttf",
+                "C:/Windows/Fonts/consola.ttf",
+                "C:/Windows/Fonts/arial.ttf",
+                "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+                "/System/Library/Fonts/Menlo.ttc"
+            };
+            for (const char* path : fontPaths) {
+                if (s.font.loadFromFile(path)) {
+                    s.fontLoaded = true;
+                    break;
+                }
+            }
+        }
+        
+        const ProfileFrameStats& frame = s.lastFrame;
+        size_t lines = 1 + frame.zones.size() + COUNTER_COUNT;
+        
+        sf::RectangleShape background(sf::Vector2f(OVERLAY_WIDTH, lines * OVERLAY_LINE_HEIGHT + 10.0f));
+        background.setPosition(10.0f, 10.0f);
+        background.setFillColor(sf::Color(0, 0, 0, 170));
+        window.draw(background);
+        
+        sf::Text text;
+        if (s.fontLoaded) {
+            text.setFont(s.font);
+            text.setCharacterSize(13);
+            text.setFillColor(sf::Color::White);
+        }
+        
+        auto drawLine = [&](size_t line, const std::string& label, float barFraction, const sf::Color& color) {
+            float y = 15.0f + line * OVERLAY_LINE_HEIGHT;
+            sf::RectangleShape bar(sf::Vector2f(std::min(1.0f, barFraction) * (OVERLAY_WIDTH - 10.0f), OVERLAY_LINE_HEIGHT - 4.0f));
+            bar.setPosition(15.0f, y);
+            bar.setFillColor(sf::Color(color.r, color.g, color.b, 120));
+            window.draw(bar);
+            if (s.fontLoaded) {
+                text.setString(label);
+                text.setPosition(18.0f, y);
+                window.draw(text);
+            }
+        };
+        
+        char buffer[128];
+        std::snprintf(buffer, sizeof(buffer), "frame  %.2f ms", frame.frameMs);
+        drawLine(0, buffer, static_cast<float>(frame.frameMs / OVERLAY_BUDGET_MS), sf::Color::White);
+        
+        size_t line = 1;
+        for (size_t i = 0; i < frame.zones.size(); ++i) {
+            const ProfileZoneStats& zone = frame.zones[i];
+            std::snprintf(buffer, sizeof(buffer), "%-20s %8.2f ms %9llu", zone.name, zone.totalMs,
+                          static_cast<unsigned long long>(zone.calls));
+            drawLine(line++, buffer, static_cast<float>(zone.totalMs / OVERLAY_BUDGET_MS), ZONE_COLORS[i % 6]);
+        }
+        
+        // Counters use a log scale so millions of rays still fit
+        for (int i = 0; i < COUNTER_COUNT; ++i) {
+            std::snprintf(buffer, sizeof(buffer), "%-20s %12llu", getCounterName(static_cast<ProfileCounter>(i)),
+                          static_cast<unsigned long long>(frame.counters[i]));
+            float fraction = frame.counters[i] > 0 ? static_cast<float>(std::log10(static_cast<double>(frame.counters[i])) / 7.0) : 0.0f;
+            drawLine(line++, buffer, fraction, sf::Color(150, 150, 150));
+        }
+    }
+    
+    const char* getCounterName(ProfileCounter counter) {
+        switch (counter) {
+            case ProfileCounter::RAYS_CAST:
+                return "rays_cast";
+            case ProfileCounter::SHADOW_RAYS:
+                return "shadow_rays";
+            case ProfileCounter::HITS:
+                return "hits";
+            case ProfileCounter::PIXELS_SHADED:
+                return "pixels_shaded";
+            case ProfileCounter::PIXELS_REPROJECTED:
+                return "pixels_reprojected";
+            case ProfileCounter::COUNT:
+                break;
+        }
+        return "unknown";
+    }
+}
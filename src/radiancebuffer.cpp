@@ -0,0 +1,148 @@
+#include "../include/radiancebuffer.hpp"
+#include "../include/profiler.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define RT_RESOLVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Channels up to the knee are shown unchanged; brighter ones roll off
+    // smoothly towards 1 instead of clipping
+    constexpr float TONEMAP_KNEE = 0.8f;
+    constexpr int ENCODE_TABLE_SIZE = 4096;
+    
+    // sRGB encoding of tonemapped values, indexed by value * (ENCODE_TABLE_SIZE - 1)
+    struct EncodeTable {
+        sf::Uint8 values[ENCODE_TABLE_SIZE];
+        
+        EncodeTable() {
+            for (int i = 0; i < ENCODE_TABLE_SIZE; ++i) {
+                float c = static_cast<float>(i) / (ENCODE_TABLE_SIZE - 1);
+                float encoded = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+                values[i] = static_cast<sf::Uint8>(std::min(255.0f, encoded * 255.0f + 0.5f));
+            }
+        }
+    };
+    
+    const EncodeTable& getEncodeTable() {
+        static const EncodeTable table;
+        return table;
+    }
+    
+    // Scalar path; performs the same operations in the same order as the SIMD one
+    int tonemapIndex(float value) {
+        value = std::max(value, 0.0f);
+        if (value > TONEMAP_KNEE) {
+            float t = (value - TONEMAP_KNEE) * (1.0f / (1.0f - TONEMAP_KNEE));
+            value = TONEMAP_KNEE + (1.0f - TONEMAP_KNEE) * (t / (1.0f + t));
+        }
+        return static_cast<int>(value * (ENCODE_TABLE_SIZE - 1) + 0.5f);
+    }
+
+#if defined(RT_RESOLVE_SSE2)
+    // Four channels at once; lanes are branch-free selects of the scalar cases
+    __m128i tonemapIndexSSE(__m128 value) {
+        const __m128 knee = _mm_set1_ps(TONEMAP_KNEE);
+        const __m128 one = _mm_set1_ps(1.0f);
+        value = _mm_max_ps(value, _mm_setzero_ps());
+        __m128 t = _mm_mul_ps(_mm_sub_ps(value, knee), _mm_set1_ps(1.0f / (1.0f - TONEMAP_KNEE)));
+        __m128 rolledOff = _mm_add_ps(knee, _mm_mul_ps(_mm_set1_ps(1.0f - TONEMAP_KNEE), _mm_div_ps(t, _mm_add_ps(one, t))));
+        __m128 aboveKnee = _mm_cmpgt_ps(value, knee);
+        value = _mm_or_ps(_mm_and_ps(aboveKnee, rolledOff), _mm_andnot_ps(aboveKnee, value));
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(static_cast<float>(ENCODE_TABLE_SIZE - 1))),
+                                           _mm_set1_ps(0.5f)));
+    }
+#endif
+    
+    // Resolves count consecutive RGBx pixels into RGBA8
+    void resolveSpan(const float* src, sf::Uint8* dst, size_t count) {
+        const sf::Uint8* encode = getEncodeTable().values;
+        size_t i = 0;
+#if defined(RT_RESOLVE_SSE2)
+        // Tonemapping and quantization run four channels (one pixel) per instruction;
+        // only the table lookups of the gamma curve are scalar
+        alignas(16) int indices[16];
+        for (; i + 4 <= count; i += 4) {
+            for (int p = 0; p < 4; ++p) {
+                _mm_store_si128(reinterpret_cast<__m128i*>(indices + p * 4), tonemapIndexSSE(_mm_loadu_ps(src + (i + p) * 4)));
+            }
+            sf::Uint8* out = dst + i * 4;
+            for (int p = 0; p < 4; ++p) {
+                out[p * 4] = encode[indices[p * 4]];
+                out[p * 4 + 1] = encode[indices[p * 4 + 1]];
+                out[p * 4 + 2] = encode[indices[p * 4 + 2]];
+                out[p * 4 + 3] = 255;
+            }
+        }
+#endif
+        for (; i < count; ++i) {
+            const float* in = src + i * 4;
+            sf::Uint8* out = dst + i * 4;
+            out[0] = encode[tonemapIndex(in[0])];
+            out[1] = encode[tonemapIndex(in[1])];
+            out[2] = encode[tonemapIndex(in[2])];
+            out[3] = 255;
+        }
+    }
+}
+
+RadianceBuffer::RadianceBuffer()
+    : width(0)
+    , height(0) {
+}
+
+void RadianceBuffer::resize(unsigned newWidth, unsigned newHeight) {
+    if (newWidth == width && newHeight == height) {
+        return;
+    }
+    width = newWidth;
+    height = newHeight;
+    pixels.assign(static_cast<size_t>(width) * height * 4, 0.0f);
+}
+
+void RadianceBuffer::resolve(FrameBuffer& target, int top, int bottom) const {
+    PROFILE_ZONE("RadianceBuffer::resolve");
+    top = std::max(top, 0);
+    bottom = std::min(bottom, static_cast<int>(height));
+    if (top >= bottom) {
+        return;
+    }
+    
+    // Both buffers are row-major with the same width, so the rows form one span
+    const size_t first = static_cast<size_t>(top) * width;
+    resolveSpan(&pixels[first * 4], target.getPixels() + first * 4, static_cast<size_t>(bottom - top) * width);
+    target.markDirty(top, bottom);
+}
+
+void RadianceBuffer::resolve(FrameBuffer& target, const Tile& tile) const {
+    PROFILE_ZONE("RadianceBuffer::resolve");
+    const int x0 = std::max(tile.x, 0);
+    const int y0 = std::max(tile.y, 0);
+    const int x1 = std::min(tile.x + tile.width, static_cast<int>(width));
+    const int y1 = std::min(tile.y + tile.height, static_cast<int>(height));
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+    
+    for (int y = y0; y < y1; ++y) {
+        const size_t first = static_cast<size_t>(y) * width + x0;
+        resolveSpan(&pixels[first * 4], target.getPixels() + first * 4, static_cast<size_t>(x1 - x0));
+    }
+    target.markDirty(y0, y1);
+}
+
+sf::Color RadianceBuffer::resolveColor(const LinearColor& color) {
+    const sf::Uint8* encode = getEncodeTable().values;
+    return sf::Color(encode[tonemapIndex(color.r)], encode[tonemapIndex(color.g)], encode[tonemapIndex(color.b)]);
+}
+
+unsigned RadianceBuffer::getWidth() const {
+    return width;
+}
+
+unsigned RadianceBuffer::getHeight() const {
+    return height;
+}
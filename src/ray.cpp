@@ -6,6 +6,14 @@ Ray::Ray(const sf::Vector2f& origin, const sf::Vector2f& direction, float maxDis
     normalize();
 }
 
+Ray::Ray(const sf::Vector2f& origin, const sf::Vector2f& direction, float maxDistance, UnitDirection)
+    : origin(origin), direction(direction), maxDistance(maxDistance) {
+}
+
+Ray Ray::fromUnitDirection(const sf::Vector2f& origin, const sf::Vector2f& unitDirection, float maxDistance) {
+    return Ray(origin, unitDirection, maxDistance, UnitDirection());
+}
+
 sf::Vector2f Ray::getPointAtDistance(float distance) const {
     return origin + direction * distance;
 }
@@ -17,9 +25,47 @@ void Ray::normalize() {
     }
 }
 
-RayHit::RayHit() : point(0, 0), normal(0, 0), distance(0), hit(false) {
+int RayBatch::size() const {
+    return static_cast<int>(originX.size());
+}
+
+void RayBatch::resize(int count) {
+    originX.resize(count);
+    originY.resize(count);
+    directionX.resize(count);
+    directionY.resize(count);
+    maxDistance.resize(count);
+}
+
+void RayBatch::set(int index, const sf::Vector2f& origin, const sf::Vector2f& direction, float distance) {
+    originX[index] = origin.x;
+    originY[index] = origin.y;
+    directionX[index] = direction.x;
+    directionY[index] = direction.y;
+    maxDistance[index] = distance;
+}
+
+void RayBatch::normalizeDirections() {
+    float* x = directionX.data();
+    float* y = directionY.data();
+    const int count = size();
+    for (int i = 0; i < count; ++i) {
+        const float length = std::sqrt(x[i] * x[i] + y[i] * y[i]);
+        // Selects instead of branching, so the loop stays vectorizable
+        const float divisor = length > 0 ? length : 1.0f;
+        x[i] = x[i] / divisor;
+        y[i] = y[i] / divisor;
+    }
+}
+
+Ray RayBatch::getRay(int index) const {
+    return Ray::fromUnitDirection(sf::Vector2f(originX[index], originY[index]),
+                                  sf::Vector2f(directionX[index], directionY[index]), maxDistance[index]);
+}
+
+RayHit::RayHit() : point(0, 0), normal(0, 0), distance(0), hit(false), objectIndex(-1) {
 }
 
 RayHit::RayHit(const sf::Vector2f& point, const sf::Vector2f& normal, float distance)
-    : point(point), normal(normal), distance(distance), hit(true) {
+    : point(point), normal(normal), distance(distance), hit(true), objectIndex(-1) {
 } 
\ No newline at end of file
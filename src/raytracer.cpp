@@ -1,192 +1,1124 @@
 #include "../include/raytracer.hpp"
 #include "../include/scene.hpp"
+#include "../include/profiler.hpp"
+#include "../include/adaptivesampling.hpp"
+#include "../include/reprojectioncache.hpp"
+#include "../include/upscaling.hpp"
+#include "../include/coverage.hpp"
 #include <cmath>
 #include <algorithm>
+#include <numeric>
+
+namespace {
+    // Stateless integer hash; progressive samples are reproducible per pixel and pass
+    uint32_t hashSample(uint32_t value) {
+        value ^= value >> 16;
+        value *= 0x7FEB352Du;
+        value ^= value >> 15;
+        value *= 0x846CA68Bu;
+        value ^= value >> 16;
+        return value;
+    }
+    
+    // Uniform in [0, 1) from the top 24 bits
+    float toUnitFloat(uint32_t value) {
+        return static_cast<float>(value >> 8) * (1.0f / 16777216.0f);
+    }
+    
+    // Sorts the intervals and merges overlapping ones in place; returns their total length
+    float mergeIntervals(std::vector<sf::Vector2f>& intervals) {
+        std::sort(intervals.begin(), intervals.end(), [](const sf::Vector2f& a, const sf::Vector2f& b) {
+            return a.x < b.x;
+        });
+        size_t count = 0;
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            if (count > 0 && intervals[i].x <= intervals[count - 1].y) {
+                intervals[count - 1].y = std::max(intervals[count - 1].y, intervals[i].y);
+            } else {
+                intervals[count++] = intervals[i];
+            }
+        }
+        intervals.resize(count);
+        
+        float length = 0.0f;
+        for (const sf::Vector2f& interval : intervals) {
+            length += interval.y - interval.x;
+        }
+        return length;
+    }
+    
+    LinearColor getBackgroundColor() {
+        return LinearColor::fromColor(sf::Color(20, 20, 40));
+    }
+    
+    // Distinct per object along the path, and changes when any light becomes blocked
+    uint32_t addHitToSampleState(uint32_t sampleState, int objectIndex, uint32_t shadowMask) {
+        return sampleState * 0x85EBCA6Bu + (static_cast<uint32_t>(objectIndex + 1) * 0x9E3779B1u ^ shadowMask);
+    }
+    
+    // Upper bound on the rays of one wavefront; larger tiles are traced in bands of rows
+    constexpr int MAX_WAVEFRONT_RAYS = 4096;
+    // Secondary rays that would add less than this to their sample are dropped
+    constexpr float MIN_RAY_THROUGHPUT = 1.0f / 512.0f;
+    
+    // A ray in flight: the sample it belongs to, the share of that sample's colour
+    // it still carries, and its path so far (one bit per bounce, set when transmitted).
+    // The ray itself is queued separately, so intersection reads only dense rays.
+    struct RayRecord {
+        LinearColor throughput;
+        int sample;
+        uint32_t path;
+        uint32_t coherenceKey;
+    };
+    
+    // Per-thread queues; they are cleared but never shrunk, so tracing stops
+    // allocating once they have grown to the largest wavefront
+    struct WavefrontQueues {
+        std::vector<Ray> rays; // Parallel to records
+        std::vector<RayRecord> records;
+        std::vector<Ray> nextRays;
+        std::vector<RayRecord> nextRecords;
+        std::vector<int> order;
+        std::vector<RayHit> hits;
+        RayBatch cameraRays;
+        std::vector<LinearColor> colors;
+        // Reprojected tiles: every camera ray and its hit, then the samples traced again
+        std::vector<Ray> primaryRays;
+        std::vector<RayHit> primaryHits;
+        std::vector<Ray> tracedRays;
+        std::vector<int> tracedSamples;
+        std::vector<RayHit> tracedHits;
+        std::vector<uint32_t> tracedStates;
+    };
+    
+    WavefrontQueues& getThreadQueues() {
+        thread_local WavefrontQueues queues;
+        return queues;
+    }
+    
+    // Rays leaving the same sphere on the same side and in the same quadrant
+    // mostly traverse the same BVH nodes
+    uint32_t getCoherenceKey(int objectIndex, const sf::Vector2f& direction, uint32_t transmitted) {
+        const uint32_t quadrant = (direction.x < 0.0f ? 1u : 0u) | (direction.y < 0.0f ? 2u : 0u);
+        return (static_cast<uint32_t>(objectIndex) << 3) | (quadrant << 1) | transmitted;
+    }
+    
+    // Total order, so a sample's rays are always combined in the same order
+    // whatever else shares the wavefront
+    bool isBefore(const RayRecord& a, const RayRecord& b) {
+        if (a.coherenceKey != b.coherenceKey) {
+            return a.coherenceKey < b.coherenceKey;
+        }
+        if (a.sample != b.sample) {
+            return a.sample < b.sample;
+        }
+        return a.path < b.path;
+    }
+}
 
 RayTracer::RayTracer() 
     : maxDepth(3)
-    , shadowRays(8)
     , antiAliasing(false)
+    , pixelStepOverride(0)
+    , edgeAwareUpscaling(false)
+    , coverageAntiAliasing(false)
+    , adaptiveSampling(false)
+    , adaptiveThreshold(AdaptiveSampling::DEFAULT_THRESHOLD)
     , ambientIntensity(0.2f)
     , diffuseIntensity(0.8f)
     , specularIntensity(0.3f) {
 }
 
-void RayTracer::renderScene(sf::RenderWindow& window, const Scene& scene) {
-    // Create render texture for pixel-perfect ray tracing
-    sf::RenderTexture renderTexture;
-    renderTexture.create(Utils::WINDOW_WIDTH, Utils::WINDOW_HEIGHT);
-    renderTexture.clear(sf::Color::Black);
+void RayTracer::renderScene(sf::RenderWindow& window, const Scene& scene, FrameBuffer& frameBuffer,
+                            ThreadPool* threadPool, DirtyRegion* dirtyRegion) {
+    PROFILE_ZONE("RayTracer::renderScene");
+    
+    traceFrame(scene, frameBuffer, threadPool, dirtyRegion);
+    
+    // Upload and draw the whole frame at once
+    frameBuffer.present(window);
+    drawSceneMarkers(window, scene);
+}
+
+void RayTracer::drawSceneMarkers(sf::RenderWindow& window, const Scene& scene) {
+    // Draw UI elements
+    for (const Light& sceneLight : scene.getLights()) {
+        renderLight(window, sceneLight);
+    }
+    renderSphereOutline(window, scene.getSphere());
+}
+
+void RayTracer::traceFrame(const Scene& scene, FrameBuffer& frameBuffer,
+                           ThreadPool* threadPool, DirtyRegion* dirtyRegion) {
+    PROFILE_ZONE("RayTracer::traceFrame");
+    radiance.resize(frameBuffer.getWidth(), frameBuffer.getHeight());
     
-    const Light& light = scene.getLight();
-    const Sphere& sphere = scene.getSphere();
+    if (dirtyRegion && !dirtyRegion->isFull()) {
+        // Only the tiles the scene change can reach are traced again
+        const std::vector<int>& tiles = dirtyRegion->getTiles();
+        const int tileSize = dirtyRegion->getTileSize();
+        auto renderDirtyTile = [&](int index) {
+            renderTile(scene, radiance, frameBuffer.getTile(tiles[index], tileSize));
+        };
+        if (threadPool) {
+            threadPool->parallelFor(static_cast<int>(tiles.size()), renderDirtyTile);
+        } else {
+            for (int i = 0; i < static_cast<int>(tiles.size()); ++i) {
+                renderDirtyTile(i);
+            }
+        }
+        
+        int top, bottom;
+        if (dirtyRegion->getRowSpan(top, bottom)) {
+            resolveRows(scene, frameBuffer, top, bottom, threadPool);
+        }
+        return;
+    }
     
-    // Camera position (top-left of screen)
-    sf::Vector2f cameraPos(0, 0);
+    if (threadPool) {
+        // Tiles are independent, so the result matches the serial path exactly
+        const int tileCount = frameBuffer.getTileCount(Utils::RENDER_TILE_SIZE);
+        threadPool->parallelFor(tileCount, [&](int index) {
+            renderTile(scene, radiance, frameBuffer.getTile(index, Utils::RENDER_TILE_SIZE));
+        });
+    } else {
+        Tile fullFrame = { 0, 0, static_cast<int>(frameBuffer.getWidth()), static_cast<int>(frameBuffer.getHeight()) };
+        renderTile(scene, radiance, fullFrame);
+    }
+    resolveRows(scene, frameBuffer, 0, static_cast<int>(frameBuffer.getHeight()), threadPool);
+}
+
+bool RayTracer::accumulateFrame(const Scene& scene, FrameBuffer& frameBuffer, AccumulationBuffer& accumulation,
+                                ThreadPool* threadPool) {
+    PROFILE_ZONE("RayTracer::accumulateFrame");
+    radiance.resize(frameBuffer.getWidth(), frameBuffer.getHeight());
+    const int tileSize = accumulation.getTileSize();
+    const int tileCount = accumulation.getTileCount();
     
-    // Ray trace each pixel
-    const int pixelStep = antiAliasing ? 1 : 2; // Anti-aliasing uses every pixel
+    // Converged tiles are skipped; the rest are resolved as one row span
+    int top = static_cast<int>(frameBuffer.getHeight());
+    int bottom = 0;
+    for (int i = 0; i < tileCount; ++i) {
+        if (accumulation.getSampleCount(i) < Utils::MAX_ACCUMULATED_SAMPLES) {
+            const Tile tile = frameBuffer.getTile(i, tileSize);
+            top = std::min(top, tile.y);
+            bottom = std::max(bottom, tile.y + tile.height);
+        }
+    }
+    if (top >= bottom) {
+        return false;
+    }
     
-    for (int x = 0; x < Utils::WINDOW_WIDTH; x += pixelStep) {
-        for (int y = 0; y < Utils::WINDOW_HEIGHT; y += pixelStep) {
-            sf::Vector2f pixelPos(static_cast<float>(x), static_cast<float>(y));
-            
-            // Create ray from camera to pixel
-            sf::Vector2f rayDir = pixelPos - cameraPos;
-            Ray ray(cameraPos, rayDir);
-            
-            // Trace the ray
-            sf::Color pixelColor = traceRay(ray, scene);
+    auto accumulateIndex = [&](int index) {
+        if (accumulation.getSampleCount(index) < Utils::MAX_ACCUMULATED_SAMPLES) {
+            accumulateTile(scene, accumulation, frameBuffer.getTile(index, tileSize), index);
+        }
+    };
+    if (threadPool) {
+        threadPool->parallelFor(tileCount, accumulateIndex);
+    } else {
+        for (int i = 0; i < tileCount; ++i) {
+            accumulateIndex(i);
+        }
+    }
+    radiance.resolve(frameBuffer, top, bottom);
+    return true;
+}
+
+void RayTracer::accumulateTile(const Scene& scene, AccumulationBuffer& accumulation, const Tile& tile, int tileIndex) {
+    PROFILE_ZONE("RayTracer::accumulateTile");
+    const int pass = accumulation.getSampleCount(tileIndex);
+    
+    WavefrontQueues& queues = getThreadQueues();
+    RayBatch& cameraRays = queues.cameraRays;
+    std::vector<LinearColor>& colors = queues.colors;
+    const sf::Vector2f cameraPos = getCameraPosition();
+    cameraRays.resize(tile.width * tile.height);
+    int index = 0;
+    for (int y = tile.y; y < tile.y + tile.height; ++y) {
+        for (int x = tile.x; x < tile.x + tile.width; ++x) {
+            const uint32_t seed = hashSample(hashSample(static_cast<uint32_t>(y) * 0x9E3779B1u ^ static_cast<uint32_t>(x))
+                                             + static_cast<uint32_t>(pass) * 0x85EBCA6Bu);
             
-            // Draw pixel
-            sf::RectangleShape pixel(sf::Vector2f(pixelStep, pixelStep));
-            pixel.setPosition(pixelPos);
-            pixel.setFillColor(pixelColor);
-            renderTexture.draw(pixel);
+            // Box-filtered anti-aliasing: a random position inside the pixel footprint
+            const float offsetX = toUnitFloat(hashSample(seed ^ 0x68E31DA4u)) - 0.5f;
+            const float offsetY = toUnitFloat(hashSample(seed ^ 0xB5297A4Du)) - 0.5f;
+            const sf::Vector2f pixelPos(static_cast<float>(x) + offsetX, static_cast<float>(y) + offsetY);
+            cameraRays.set(index++, cameraPos, pixelPos - cameraPos);
         }
     }
+    cameraRays.normalizeDirections();
     
-    renderTexture.display();
+    // Accumulation tiles stay well below MAX_WAVEFRONT_RAYS, so one wavefront covers the tile
+    colors.resize(cameraRays.size());
+    traceRays(scene, cameraRays, colors);
     
-    // Draw the rendered texture
-    sf::Sprite renderSprite(renderTexture.getTexture());
-    window.draw(renderSprite);
+    const LinearColor* color = colors.data();
+    for (int y = tile.y; y < tile.y + tile.height; ++y) {
+        for (int x = tile.x; x < tile.x + tile.width; ++x) {
+            accumulation.addSample(x, y, *color++, pass == 0);
+        }
+    }
+    accumulation.finishTile(radiance, tile, tileIndex);
     
-    // Draw UI elements
-    renderLight(window, light);
-    renderSphereOutline(window, sphere);
+    PROFILE_COUNT(ProfileCounter::PIXELS_SHADED, static_cast<uint64_t>(tile.width) * tile.height);
 }
 
-sf::Color RayTracer::traceRay(const Ray& ray, const Scene& scene, int depth) {
-    if (depth >= maxDepth) {
-        return sf::Color::Black; // Max depth reached
+void RayTracer::renderTile(const Scene& scene, RadianceBuffer& target, const Tile& tile) {
+    PROFILE_ZONE("RayTracer::renderTile");
+    
+    if (adaptiveSampling) {
+        // Sphere silhouettes and shadow boundaries change the hit/shadow state
+        AdaptiveSampling::renderTile(target, tile, adaptiveThreshold, [&](int x, int y) {
+            AdaptiveSampling::LinearSample sample;
+            Ray ray = generateCameraRay(sf::Vector2f(static_cast<float>(x), static_cast<float>(y)));
+            sample.color = traceRay(ray, scene, &sample.state);
+            return sample;
+        });
+        return;
     }
     
-    // Find closest intersection
-    RayHit hit = findClosestHit(ray, scene);
+    // Ray trace each pixel
+    const int pixelStep = getPixelStep();
+    const int samplesPerRow = (tile.width + pixelStep - 1) / pixelStep;
+    const int bandHeight = std::max(1, MAX_WAVEFRONT_RAYS / samplesPerRow) * pixelStep;
+    
+    WavefrontQueues& queues = getThreadQueues();
+    RayBatch& cameraRays = queues.cameraRays;
+    std::vector<LinearColor>& colors = queues.colors;
     
-    if (!hit.hit) {
-        return sf::Color(20, 20, 40); // Background color
+    // Each band of rows is one wavefront; row-major order matches the framebuffer layout
+    for (int bandY = tile.y; bandY < tile.y + tile.height; bandY += bandHeight) {
+        const int bandEnd = std::min(bandY + bandHeight, tile.y + tile.height);
+        
+        const Tile band = { tile.x, bandY, tile.width, bandEnd - bandY };
+        generateCameraRays(band, pixelStep, cameraRays);
+        colors.resize(cameraRays.size());
+        traceRays(scene, cameraRays, colors);
+        
+        // Write each sample into its buffer block
+        const LinearColor* color = colors.data();
+        for (int y = bandY; y < bandEnd; y += pixelStep) {
+            for (int x = tile.x; x < tile.x + tile.width; x += pixelStep) {
+                target.fillRect(x, y, pixelStep, pixelStep, *color++);
+            }
+        }
     }
     
-    // Calculate lighting at intersection point
-    sf::Color lighting = calculateLighting(hit.point, hit.normal, scene);
+    PROFILE_COUNT(ProfileCounter::PIXELS_SHADED,
+                  static_cast<uint64_t>((tile.width + pixelStep - 1) / pixelStep) * ((tile.height + pixelStep - 1) / pixelStep));
+}
+
+void RayTracer::reprojectFrame(const Scene& scene, FrameBuffer& frameBuffer, ReprojectionCache& cache,
+                               ThreadPool* threadPool, DirtyRegion* dirtyRegion) {
+    PROFILE_ZONE("RayTracer::reprojectFrame");
+    if (adaptiveSampling) {
+        // Quadtree samples have no fixed grid to reproject
+        cache.invalidate();
+        traceFrame(scene, frameBuffer, threadPool, dirtyRegion);
+        return;
+    }
+    radiance.resize(frameBuffer.getWidth(), frameBuffer.getHeight());
     
-    // Get material color
-    const Sphere& sphere = scene.getSphere();
-    sf::Color material = sphere.getMaterial();
+    const uint32_t shadingKey = static_cast<uint32_t>(maxDepth);
+    const bool canReuse = cache.beginFrame(scene, frameBuffer.getWidth(), frameBuffer.getHeight(), getPixelStep(),
+                                           getCameraPosition(), shadingKey);
     
-    // Combine material and lighting
-    sf::Color finalColor;
-    finalColor.r = static_cast<uint8_t>(material.r * lighting.r / 255);
-    finalColor.g = static_cast<uint8_t>(material.g * lighting.g / 255);
-    finalColor.b = static_cast<uint8_t>(material.b * lighting.b / 255);
+    // Tiles outside the dirty region keep their pixels and their cached samples alike
+    const bool dirtyOnly = canReuse && dirtyRegion && !dirtyRegion->isFull();
+    const std::vector<int>* dirtyTiles = dirtyOnly ? &dirtyRegion->getTiles() : nullptr;
+    const int tileSize = dirtyOnly ? dirtyRegion->getTileSize() : Utils::RENDER_TILE_SIZE;
+    const int tileCount = dirtyOnly ? static_cast<int>(dirtyTiles->size()) : frameBuffer.getTileCount(tileSize);
+    auto reprojectIndex = [&](int index) {
+        reprojectTile(scene, radiance, cache, frameBuffer.getTile(dirtyOnly ? (*dirtyTiles)[index] : index, tileSize));
+    };
+    if (threadPool) {
+        threadPool->parallelFor(tileCount, reprojectIndex);
+    } else {
+        for (int i = 0; i < tileCount; ++i) {
+            reprojectIndex(i);
+        }
+    }
     
-    return finalColor;
+    int top = 0;
+    int bottom = static_cast<int>(frameBuffer.getHeight());
+    if (!dirtyOnly || dirtyRegion->getRowSpan(top, bottom)) {
+        resolveRows(scene, frameBuffer, top, bottom, threadPool);
+    }
 }
 
-sf::Color RayTracer::calculateLighting(const sf::Vector2f& point, const sf::Vector2f& normal, const Scene& scene) {
-    const Light& light = scene.getLight();
+void RayTracer::reprojectTile(const Scene& scene, RadianceBuffer& target, ReprojectionCache& cache, const Tile& tile) {
+    PROFILE_ZONE("RayTracer::reprojectTile");
+    const int pixelStep = cache.getPixelStep();
+    const int columns = (tile.width + pixelStep - 1) / pixelStep;
+    const int currentStep = cache.getCurrentStep();
+    const DiffuseShader shadeDiffuseHit = getDiffuseShader(scene);
     
-    // Ambient lighting
-    sf::Color ambient = sf::Color(
-        static_cast<uint8_t>(255 * ambientIntensity),
-        static_cast<uint8_t>(255 * ambientIntensity),
-        static_cast<uint8_t>(255 * ambientIntensity)
-    );
+    WavefrontQueues& queues = getThreadQueues();
+    std::vector<Ray>& primaryRays = queues.primaryRays;
+    std::vector<RayHit>& primaryHits = queues.primaryHits;
+    std::vector<Ray>& tracedRays = queues.tracedRays;
+    std::vector<int>& tracedSamples = queues.tracedSamples;
+    std::vector<RayHit>& tracedHits = queues.tracedHits;
+    std::vector<LinearColor>& colors = queues.colors;
+    std::vector<uint32_t>& states = queues.tracedStates;
     
-    // Check if point is in shadow
-    if (isInShadow(point, light, scene)) {
-        return ambient; // Only ambient light in shadow
+    // Every camera ray is intersected, to find what each sample sees now
+    generateCameraRays(tile, pixelStep, queues.cameraRays);
+    primaryRays.clear();
+    for (int i = 0; i < queues.cameraRays.size(); ++i) {
+        primaryRays.push_back(queues.cameraRays.getRay(i));
     }
+    primaryHits.resize(primaryRays.size());
+    findClosestHits(primaryRays, primaryHits, scene);
     
-    // Calculate diffuse lighting
-    sf::Vector2f lightDir = light.getPosition() - point;
-    float distance = Utils::calculateDistance(point, light.getPosition());
-    float attenuation = 1.0f / (1.0f + 0.01f * distance + 0.001f * distance * distance);
+    // Misses and diffuse hits are shaded here, the latter with reused visibilities where
+    // the cache allows; hits that spawn secondary rays are traced as usual
+    const std::vector<Sphere>& spheres = scene.getSpheres();
+    const LinearColor background = getBackgroundColor();
+    uint64_t reprojected = 0;
+    uint64_t diffuseHits = 0;
+    tracedRays.clear();
+    tracedSamples.clear();
+    tracedHits.clear();
+    for (int i = 0; i < static_cast<int>(primaryHits.size()); ++i) {
+        const int sampleX = tile.x / pixelStep + i % columns;
+        const int sampleY = tile.y / pixelStep + i / columns;
+        const RayHit& hit = primaryHits[i];
+        ReprojectionCache::Sample& sample = cache.getSample(sampleX, sampleY);
+        sample.object = hit.hit ? hit.objectIndex : -1;
+        sample.hitOffset = hit.hit ? hit.point - spheres[hit.objectIndex].getPosition() : sf::Vector2f(0.0f, 0.0f);
+        sample.tracedStep = currentStep;
+        
+        if (!hit.hit) {
+            sample.state = 0;
+            target.fillRect(sampleX * pixelStep, sampleY * pixelStep, pixelStep, pixelStep, background);
+            continue;
+        }
+        const Sphere& sphere = spheres[hit.objectIndex];
+        if (sphere.getReflectivity() > 0.0f || sphere.getTransparency() > 0.0f) {
+            tracedRays.push_back(primaryRays[i]);
+            tracedSamples.push_back(i);
+            tracedHits.push_back(hit);
+            continue;
+        }
+        
+        ++diffuseHits;
+        float* visibilities = cache.getVisibilities(sampleX, sampleY);
+        const ReprojectionCache::Sample* source = cache.findReusable(hit, sampleX, sampleY, scene);
+        if (source) {
+            const float* previous = cache.getPreviousVisibilities(*source);
+            std::copy(previous, previous + scene.getLights().size(), visibilities);
+            sample.tracedStep = source->tracedStep;
+            ++reprojected;
+        }
+        uint32_t shadowMask = 0;
+        const LinearColor color = (this->*shadeDiffuseHit)(hit, scene, visibilities, source != nullptr, shadowMask);
+        sample.state = addHitToSampleState(0, hit.objectIndex, shadowMask);
+        target.fillRect(sampleX * pixelStep, sampleY * pixelStep, pixelStep, pixelStep, color);
+    }
+    
+    // The rays shaded above are counted here; traceRays counts the rest as it traces them
+    PROFILE_COUNT(ProfileCounter::RAYS_CAST, static_cast<uint64_t>(primaryRays.size() - tracedRays.size()));
+    PROFILE_COUNT(ProfileCounter::HITS, diffuseHits);
+    
+    // Specular samples are traced as one batch from the hits already found, keeping their
+    // states for the next frame's edge tests; their visibilities are never reused
+    colors.resize(tracedRays.size());
+    states.resize(tracedRays.size());
+    traceRays(scene, tracedRays, colors, states, tracedHits);
+    for (size_t i = 0; i < tracedSamples.size(); ++i) {
+        const int sampleX = tile.x / pixelStep + tracedSamples[i] % columns;
+        const int sampleY = tile.y / pixelStep + tracedSamples[i] / columns;
+        cache.getSample(sampleX, sampleY).state = states[i];
+        target.fillRect(sampleX * pixelStep, sampleY * pixelStep, pixelStep, pixelStep, colors[i]);
+    }
+    
+    PROFILE_COUNT(ProfileCounter::PIXELS_SHADED, static_cast<uint64_t>(primaryHits.size()) - reprojected);
+    PROFILE_COUNT(ProfileCounter::PIXELS_REPROJECTED, reprojected);
+}
+
+Ray RayTracer::generateCameraRay(const sf::Vector2f& pixelPos) {
+    PROFILE_ZONE_HOT("ray generation");
+    
+    sf::Vector2f cameraPos = getCameraPosition();
+    sf::Vector2f rayDir = pixelPos - cameraPos;
+    return Ray(cameraPos, rayDir);
+}
+
+void RayTracer::generateCameraRays(const Tile& tile, int pixelStep, RayBatch& rays) {
+    PROFILE_ZONE_HOT("ray generation");
+    
+    const sf::Vector2f cameraPos = getCameraPosition();
+    const int columns = (tile.width + pixelStep - 1) / pixelStep;
+    const int rows = (tile.height + pixelStep - 1) / pixelStep;
+    rays.resize(columns * rows);
+    int index = 0;
+    for (int y = tile.y; y < tile.y + tile.height; y += pixelStep) {
+        for (int x = tile.x; x < tile.x + tile.width; x += pixelStep) {
+            rays.set(index++, cameraPos, sf::Vector2f(static_cast<float>(x), static_cast<float>(y)) - cameraPos);
+        }
+    }
+    rays.normalizeDirections();
+}
+
+LinearColor RayTracer::traceRay(const Ray& ray, const Scene& scene, uint32_t* sampleState) {
+    // A batch of a single ray; tiles pass all their rays at once
+    LinearColor color;
+    traceRays(scene, Span<const Ray>(&ray, 1), Span<LinearColor>(&color, 1),
+              sampleState ? Span<uint32_t>(sampleState, 1) : Span<uint32_t>());
+    return color;
+}
+
+void RayTracer::traceRays(const Scene& scene, Span<const Ray> rays, Span<LinearColor> colors,
+                          Span<uint32_t> sampleStates, Span<const RayHit> firstHits) {
+    const WavefrontKernel traceWavefront = getWavefrontKernel(getShadingFeatures(scene, !sampleStates.empty()));
+    WavefrontQueues& queues = getThreadQueues();
+    for (size_t first = 0; first < rays.size(); first += MAX_WAVEFRONT_RAYS) {
+        const size_t count = std::min(rays.size() - first, static_cast<size_t>(MAX_WAVEFRONT_RAYS));
+        queues.rays.assign(rays.begin() + first, rays.begin() + first + count);
+        (this->*traceWavefront)(scene, &colors[first], sampleStates.empty() ? nullptr : &sampleStates[first],
+                                firstHits.empty() ? nullptr : &firstHits[first]);
+    }
+}
+
+void RayTracer::traceRays(const Scene& scene, const RayBatch& rays, Span<LinearColor> colors, Span<uint32_t> sampleStates) {
+    const WavefrontKernel traceWavefront = getWavefrontKernel(getShadingFeatures(scene, !sampleStates.empty()));
+    WavefrontQueues& queues = getThreadQueues();
+    for (int first = 0; first < rays.size(); first += MAX_WAVEFRONT_RAYS) {
+        const int last = std::min(rays.size(), first + MAX_WAVEFRONT_RAYS);
+        queues.rays.clear();
+        for (int i = first; i < last; ++i) {
+            queues.rays.push_back(rays.getRay(i));
+        }
+        (this->*traceWavefront)(scene, &colors[first], sampleStates.empty() ? nullptr : &sampleStates[first], nullptr);
+    }
+}
+
+unsigned RayTracer::getShadingFeatures(const Scene& scene, bool trackSampleStates) const {
+    unsigned features = 0;
+    if (trackSampleStates) {
+        features |= TRACK_SAMPLE_STATES;
+    }
+    if (maxDepth > 1) {
+        features |= SECONDARY_RAYS;
+    }
+    if (scene.getAccelerationStructure() == AccelerationStructure::GRID) {
+        features |= UNIFORM_GRID;
+    }
+    return features;
+}
+
+RayTracer::WavefrontKernel RayTracer::getWavefrontKernel(unsigned features) {
+    static const WavefrontKernel kernels[SHADING_FEATURE_SETS] = {
+        &RayTracer::traceWavefront<0>, &RayTracer::traceWavefront<1>, &RayTracer::traceWavefront<2>,
+        &RayTracer::traceWavefront<3>, &RayTracer::traceWavefront<4>, &RayTracer::traceWavefront<5>,
+        &RayTracer::traceWavefront<6>, &RayTracer::traceWavefront<7>
+    };
+    return kernels[features];
+}
+
+template <unsigned Features>
+void RayTracer::traceWavefront(const Scene& scene, LinearColor* colors, uint32_t* sampleStates,
+                               const RayHit* firstHits) {
+    PROFILE_ZONE_HOT("traceWavefront");
+    const bool trackSampleStates = (Features & TRACK_SAMPLE_STATES) != 0;
+    const bool secondaryRays = (Features & SECONDARY_RAYS) != 0;
+    const bool uniformGrid = (Features & UNIFORM_GRID) != 0;
+    
+    WavefrontQueues& queues = getThreadQueues();
+    std::vector<Ray>& rays = queues.rays;
+    std::vector<RayRecord>& records = queues.records;
+    std::vector<Ray>& nextRays = queues.nextRays;
+    std::vector<RayRecord>& nextRecords = queues.nextRecords;
+    std::vector<int>& order = queues.order;
+    std::vector<RayHit>& hits = queues.hits;
+    
+    const int count = static_cast<int>(rays.size());
+    records.clear();
+    for (int i = 0; i < count; ++i) {
+        colors[i] = LinearColor();
+        if (trackSampleStates) {
+            sampleStates[i] = 0;
+        }
+        records.push_back({ LinearColor(1.0f), i, 0u, 0u });
+    }
+    
+    const std::vector<Sphere>& spheres = scene.getSpheres();
+    const LinearColor background = getBackgroundColor();
+    
+    // Rays still queued when maxDepth is reached contribute nothing
+    for (int depth = 0; depth < maxDepth && !rays.empty(); ++depth) {
+        const int rayCount = static_cast<int>(rays.size());
+        PROFILE_COUNT(ProfileCounter::RAYS_CAST, static_cast<uint64_t>(rayCount));
+        
+        // Intersection stage: the whole bounce is traced before anything is shaded
+        hits.resize(rays.size());
+        {
+            PROFILE_ZONE_HOT("intersection");
+            if (depth == 0 && firstHits) {
+                std::copy(firstHits, firstHits + rayCount, hits.begin());
+            } else if (uniformGrid) {
+                const UniformGrid& grid = scene.getGrid();
+                for (int i = 0; i < rayCount; ++i) {
+                    hits[i] = grid.intersect(rays[i], spheres);
+                }
+            } else {
+                const BVH& bvh = scene.getBVH();
+                for (int i = 0; i < rayCount; ++i) {
+                    hits[i] = bvh.intersect(rays[i], spheres);
+                }
+            }
+        }
+        
+        // Shading stage; rays that continue are appended densely to the next queue
+        nextRays.clear();
+        nextRecords.clear();
+        for (int i = 0; i < rayCount; ++i) {
+            const RayRecord& record = records[i];
+            const RayHit& hit = hits[i];
+            
+            if (!hit.hit) {
+                colors[record.sample] += record.throughput * background;
+                if (trackSampleStates) {
+                    sampleStates[record.sample] *= 0x85EBCA6Bu;
+                }
+                continue;
+            }
+            PROFILE_COUNT(ProfileCounter::HITS, 1);
+            
+            const Sphere& sphere = spheres[hit.objectIndex];
+            const LinearColor albedo = LinearColor::fromColor(sphere.getMaterial());
+            float reflectWeight = sphere.getReflectivity();
+            float transmitWeight = sphere.getTransparency();
+            const float diffuseWeight = 1.0f - reflectWeight - transmitWeight;
+            
+            uint32_t shadowMask = 0;
+            if (diffuseWeight > 0.0f) {
+                LinearColor lighting = calculateLightingWith<Features>(hit.point, hit.normal, scene, shadowMask);
+                // The result may exceed 1 until the frame is resolved
+                colors[record.sample] += record.throughput * albedo * lighting * diffuseWeight;
+            }
+            if (trackSampleStates) {
+                sampleStates[record.sample] = addHitToSampleState(sampleStates[record.sample], hit.objectIndex, shadowMask);
+            }
+            
+            // Fresnel only splits the specular share between the two secondary rays,
+            // so kernels without them skip it
+            if (!secondaryRays || depth + 1 >= maxDepth) {
+                continue;
+            }
+            const sf::Vector2f direction = rays[i].direction;
+            
+            // Rays refracted into a glass sphere hit it from the inside
+            const float cosIncident = -(direction.x * hit.normal.x + direction.y * hit.normal.y);
+            const bool entering = cosIncident > 0.0f;
+            const sf::Vector2f normal = entering ? hit.normal : -hit.normal;
+            const float cosI = std::abs(cosIncident);
+            
+            float eta = 1.0f;
+            float cosT = 0.0f;
+            if (transmitWeight > 0.0f) {
+                const float refractiveIndex = sphere.getRefractiveIndex();
+                eta = entering ? 1.0f / refractiveIndex : refractiveIndex;
+                const float sin2T = eta * eta * (1.0f - cosI * cosI);
+                if (sin2T >= 1.0f) {
+                    // Total internal reflection
+                    reflectWeight += transmitWeight;
+                    transmitWeight = 0.0f;
+                } else {
+                    // Schlick's Fresnel approximation, using the angle on the outside
+                    cosT = std::sqrt(1.0f - sin2T);
+                    const float r0 = (1.0f - refractiveIndex) / (1.0f + refractiveIndex);
+                    const float c = 1.0f - (entering ? cosI : cosT);
+                    const float fresnel = r0 * r0 + (1.0f - r0 * r0) * c * c * c * c * c;
+                    reflectWeight += transmitWeight * fresnel;
+                    transmitWeight *= 1.0f - fresnel;
+                }
+            }
+            
+            // Reflection and refraction of a unit direction about a unit normal are
+            // unit length already, so the secondary rays skip the normalization
+            const LinearColor reflected = record.throughput * reflectWeight;
+            if (std::max(reflected.r, std::max(reflected.g, reflected.b)) >= MIN_RAY_THROUGHPUT) {
+                const sf::Vector2f reflectedDir = direction + normal * (2.0f * cosI);
+                nextRays.push_back(Ray::fromUnitDirection(hit.point + normal * Utils::SHADOW_BIAS, reflectedDir));
+                nextRecords.push_back({ reflected, record.sample, record.path << 1,
+                                        getCoherenceKey(hit.objectIndex, reflectedDir, 0u) });
+            }
+            // Transmitted light is tinted by the sphere's colour
+            const LinearColor transmitted = record.throughput * albedo * transmitWeight;
+            if (std::max(transmitted.r, std::max(transmitted.g, transmitted.b)) >= MIN_RAY_THROUGHPUT) {
+                const sf::Vector2f refractedDir = direction * eta + normal * (eta * cosI - cosT);
+                nextRays.push_back(Ray::fromUnitDirection(hit.point - normal * Utils::SHADOW_BIAS, refractedDir));
+                nextRecords.push_back({ transmitted, record.sample, (record.path << 1) | 1u,
+                                        getCoherenceKey(hit.objectIndex, refractedDir, 1u) });
+            }
+        }
+        if (!secondaryRays) {
+            break;
+        }
+        
+        // The next bounce is traced in coherent groups rather than in spawn order;
+        // indices are sorted and both queues gathered, keeping the rays dense
+        order.resize(nextRecords.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return isBefore(nextRecords[a], nextRecords[b]);
+        });
+        rays.clear();
+        records.clear();
+        for (int index : order) {
+            rays.push_back(nextRays[index]);
+            records.push_back(nextRecords[index]);
+        }
+    }
+}
+
+LinearColor RayTracer::calculateLighting(const sf::Vector2f& point, const sf::Vector2f& normal, const Scene& scene,
+                                         uint32_t* shadowMask) {
+    uint32_t mask = 0;
+    LinearColor lighting;
+    if (getShadingFeatures(scene, true) & UNIFORM_GRID) {
+        lighting = calculateLightingWith<TRACK_SAMPLE_STATES | UNIFORM_GRID>(point, normal, scene, mask);
+    } else {
+        lighting = calculateLightingWith<TRACK_SAMPLE_STATES>(point, normal, scene, mask);
+    }
+    if (shadowMask) {
+        *shadowMask ^= mask;
+    }
+    return lighting;
+}
+
+template <unsigned Features>
+LinearColor RayTracer::calculateLightingWith(const sf::Vector2f& point, const sf::Vector2f& normal, const Scene& scene,
+                                             uint32_t& shadowMask) {
+    PROFILE_ZONE_HOT("calculateLighting");
+    // Ambient lighting, plus the diffuse contribution of every light that reaches the point
+    LinearColor lighting(ambientIntensity);
+    
+    // Starting exactly on the surface lets the shadow ray re-hit its own sphere
+    // depending on rounding, so it leaves from just outside
+    const sf::Vector2f shadowOrigin = point + normal * Utils::SHADOW_BIAS;
+    
+    const std::vector<Light>& lights = scene.getLights();
+    for (size_t i = 0; i < lights.size(); ++i) {
+        const Light& light = lights[i];
+        
+        // Lights fully blocked by occluders only leave ambient light; partly
+        // covered ones are scaled by the visible part of their disk
+        const float visibility = calculateLightVisibilityWith<Features>(shadowOrigin, light, scene);
+        if ((Features & TRACK_SAMPLE_STATES) && visibility < 1.0f) {
+            shadowMask ^= 1u << (i % 32);
+        }
+        if (visibility <= 0.0f) {
+            continue;
+        }
+        addDiffuseLight<Features>(lighting, point, normal, light, visibility);
+    }
     
-    // Normalize light direction
-    float lightLength = std::sqrt(lightDir.x * lightDir.x + lightDir.y * lightDir.y);
-    if (lightLength > 0) {
-        lightDir = lightDir / lightLength;
+    return lighting;
+}
+
+template <unsigned Features>
+void RayTracer::addDiffuseLight(LinearColor& lighting, const sf::Vector2f& point, const sf::Vector2f& normal,
+                                const Light& light, float visibility) const {
+    // The distance to the light is the length of the unnormalized direction
+    sf::Vector2f lightDir = light.getPosition() - point;
+    const float distance = std::sqrt(lightDir.x * lightDir.x + lightDir.y * lightDir.y);
+    const float attenuation = 1.0f / (1.0f + 0.01f * distance + 0.001f * distance * distance);
+    if (distance > 0) {
+        lightDir = lightDir / distance;
     }
     
     // Calculate diffuse intensity
     float diffuseDot = normal.x * lightDir.x + normal.y * lightDir.y;
     diffuseDot = std::max(0.0f, diffuseDot);
     
-    sf::Color diffuse = sf::Color(
-        static_cast<uint8_t>(255 * diffuseIntensity * diffuseDot * attenuation),
-        static_cast<uint8_t>(255 * diffuseIntensity * diffuseDot * attenuation),
-        static_cast<uint8_t>(255 * diffuseIntensity * diffuseDot * attenuation)
-    );
+    // Lights are white; overlapping lights add up without clipping
+    lighting += LinearColor(diffuseIntensity * diffuseDot * attenuation * visibility);
+}
+
+float RayTracer::calculateLightVisibility(const sf::Vector2f& point, const Light& light, const Scene& scene) {
+    if (getShadingFeatures(scene, false) & UNIFORM_GRID) {
+        return calculateLightVisibilityWith<UNIFORM_GRID>(point, light, scene);
+    }
+    return calculateLightVisibilityWith<0>(point, light, scene);
+}
+
+RayTracer::DiffuseShader RayTracer::getDiffuseShader(const Scene& scene) const {
+    if (getShadingFeatures(scene, false) & UNIFORM_GRID) {
+        return &RayTracer::shadeDiffuseHitWith<UNIFORM_GRID>;
+    }
+    return &RayTracer::shadeDiffuseHitWith<0>;
+}
+
+template <unsigned Features>
+LinearColor RayTracer::shadeDiffuseHitWith(const RayHit& hit, const Scene& scene, float* visibilities,
+                                           bool knownVisibilities, uint32_t& shadowMask) {
+    PROFILE_ZONE_HOT("calculateLighting");
+    // Same terms in the same order as calculateLightingWith, so the colour matches traceRays exactly
+    LinearColor lighting(ambientIntensity);
+    const sf::Vector2f shadowOrigin = hit.point + hit.normal * Utils::SHADOW_BIAS;
+    
+    const std::vector<Light>& lights = scene.getLights();
+    for (size_t i = 0; i < lights.size(); ++i) {
+        if (!knownVisibilities) {
+            visibilities[i] = calculateLightVisibilityWith<Features>(shadowOrigin, lights[i], scene);
+        }
+        if (visibilities[i] < 1.0f) {
+            shadowMask ^= 1u << (i % 32);
+        }
+        if (visibilities[i] <= 0.0f) {
+            continue;
+        }
+        addDiffuseLight<Features>(lighting, hit.point, hit.normal, lights[i], visibilities[i]);
+    }
+    
+    const LinearColor albedo = LinearColor::fromColor(scene.getSpheres()[hit.objectIndex].getMaterial());
+    return albedo * lighting;
+}
+
+template <unsigned Features>
+float RayTracer::calculateLightVisibilityWith(const sf::Vector2f& point, const Light& light, const Scene& scene) {
+    PROFILE_ZONE_HOT("shadow intersection");
+    PROFILE_COUNT(ProfileCounter::SHADOW_RAYS, 1);
+    
+    const sf::Vector2f lightPos = light.getPosition();
+    const float lightRadius = Utils::LIGHT_RADIUS;
+    const sf::Vector2f toLight = lightPos - point;
+    const float lightDistance = std::sqrt(toLight.x * toLight.x + toLight.y * toLight.y);
+    if (lightDistance <= lightRadius) {
+        return 1.0f; // Inside the light itself
+    }
+    
+    // Directions are handled in the frame of the light center (along, across), as
+    // slopes across/along. The disk covers slopes [-lightSlope, lightSlope]; its half
+    // angle is below 90 degrees, so slopes order directions the same way angles do
+    // and only the merged intervals need converting back to angles.
+    const sf::Vector2f axis = toLight / lightDistance;
+    const sf::Vector2f perpendicular(-axis.y, axis.x);
+    const float sinLightHalf = lightRadius / lightDistance;
+    const float cosLightHalf = std::sqrt(1.0f - sinLightHalf * sinLightHalf);
+    const float lightSlope = sinLightHalf / cosLightHalf;
+    const float fullSlope = 2.0f * lightSlope;
+    
+    // The cone from the point to the disk lies within lightRadius of the segment to its
+    // center, so one fat shadow ray finds every sphere that can cover part of it
+    const Ray coneAxis = Ray::fromUnitDirection(point, axis, lightDistance);
+    
+    // Reused per thread so shading does not allocate
+    thread_local std::vector<sf::Vector2f> blocked; // (low, high) slope intervals
+    blocked.clear();
+    float pendingLength = 0.0f; // Upper bound on the covered slope length
+    bool fullyBlocked = false;
+    const std::vector<Sphere>& spheres = scene.getSpheres();
+    
+    // Whether the sphere is entered before the disk along the direction with this slope
+    auto isInFront = [&](float slope, const sf::Vector2f& toSphere, float radius) {
+        const float scale = 1.0f / std::sqrt(1.0f + slope * slope);
+        const sf::Vector2f direction = (axis + perpendicular * slope) * scale;
+        const float sphereAlong = direction.x * toSphere.x + direction.y * toSphere.y;
+        const float lightAlong = direction.x * toLight.x + direction.y * toLight.y;
+        const float sphereEntry = sphereAlong - std::sqrt(std::max(0.0f, sphereAlong * sphereAlong
+            - (toSphere.x * toSphere.x + toSphere.y * toSphere.y) + radius * radius));
+        const float lightEntry = lightAlong - std::sqrt(std::max(0.0f, lightAlong * lightAlong
+            - lightDistance * lightDistance + lightRadius * lightRadius));
+        return sphereEntry < lightEntry;
+    };
+    
+    auto visitOccluder = [&](int index) {
+        const Sphere& sphere = spheres[index];
+        const sf::Vector2f toSphere = sphere.getPosition() - point;
+        const float radius = sphere.getRadius();
+        
+        // Candidates can lie near the fat ray without touching it; skip those outside its capsule
+        const float across = axis.x * toSphere.y - axis.y * toSphere.x;
+        const float along = axis.x * toSphere.x + axis.y * toSphere.y;
+        if (std::fabs(across) > radius + lightRadius || along < -radius || along > lightDistance + radius) {
+            return true;
+        }
+        
+        const float distanceSquared = toSphere.x * toSphere.x + toSphere.y * toSphere.y;
+        if (distanceSquared <= radius * radius) {
+            fullyBlocked = true; // Inside an occluder
+            return false;
+        }
+        
+        // No ray enters the disk later than its center distance
+        const float distance = std::sqrt(distanceSquared);
+        if (distance - radius >= lightDistance) {
+            return true;
+        }
+        
+        // Spheres beside the cone: the angle between the sphere and the light center
+        // exceeds the sum of their half angles (compared as cosines)
+        const float sinHalf = radius / distance;
+        const float cosHalf = std::sqrt(1.0f - sinHalf * sinHalf);
+        const float cosCenter = along / distance;
+        if (cosCenter < cosHalf * cosLightHalf - sinHalf * sinLightHalf) {
+            return true;
+        }
+        
+        // Tangent directions to the sphere, clipped to the disk. The sphere spans less
+        // than 180 degrees and overlaps the disk, so a tangent pointing backwards can
+        // only lie beyond the disk edge on its own side.
+        const float lowAlong = along * cosHalf + across * sinHalf;
+        const float lowAcross = across * cosHalf - along * sinHalf;
+        const float highAlong = along * cosHalf - across * sinHalf;
+        const float highAcross = across * cosHalf + along * sinHalf;
+        const float low = lowAlong > 0.0f ? std::max(lowAcross / lowAlong, -lightSlope) : -lightSlope;
+        const float high = highAlong > 0.0f ? std::min(highAcross / highAlong, lightSlope) : lightSlope;
+        if (low >= high) {
+            return true;
+        }
+        
+        // The sphere only blocks directions in which it is entered before the disk.
+        // The order can only swap where the two circles cross, so the overlap is cut
+        // at the crossing points and each piece is tested once inside.
+        float cuts[4];
+        int cutCount = 0;
+        cuts[cutCount++] = low;
+        const sf::Vector2f lightToSphere = toSphere - toLight;
+        const float centerDistance = std::sqrt(lightToSphere.x * lightToSphere.x + lightToSphere.y * lightToSphere.y);
+        if (centerDistance < lightRadius + radius && centerDistance > std::fabs(lightRadius - radius)) {
+            const sf::Vector2f unit = lightToSphere / centerDistance;
+            const float chordOffset = (lightRadius * lightRadius - radius * radius + centerDistance * centerDistance)
+                                    / (2.0f * centerDistance);
+            const float chordHalf = std::sqrt(std::max(0.0f, lightRadius * lightRadius - chordOffset * chordOffset));
+            const sf::Vector2f chordMiddle = toLight + unit * chordOffset;
+            for (float side : { -1.0f, 1.0f }) {
+                // Crossings lie on the disk, which is entirely in front of the point
+                const sf::Vector2f crossing(chordMiddle.x - unit.y * chordHalf * side, chordMiddle.y + unit.x * chordHalf * side);
+                const float slope = (perpendicular.x * crossing.x + perpendicular.y * crossing.y)
+                                  / (axis.x * crossing.x + axis.y * crossing.y);
+                if (slope > low && slope < high) {
+                    cuts[cutCount++] = slope;
+                }
+            }
+            if (cutCount == 3 && cuts[2] < cuts[1]) {
+                std::swap(cuts[1], cuts[2]);
+            }
+        }
+        cuts[cutCount++] = high;
+        
+        for (int i = 0; i + 1 < cutCount; ++i) {
+            if (!isInFront(0.5f * (cuts[i] + cuts[i + 1]), toSphere, radius)) {
+                continue;
+            }
+            blocked.emplace_back(cuts[i], cuts[i + 1]);
+            pendingLength += cuts[i + 1] - cuts[i];
+        }
+        
+        // Stop once the union covers the whole disk (umbra); merging only runs when
+        // the summed lengths say it could
+        if (pendingLength >= fullSlope) {
+            pendingLength = mergeIntervals(blocked);
+            if (pendingLength >= fullSlope) {
+                fullyBlocked = true;
+                return false;
+            }
+        }
+        return true;
+    };
+    if (Features & UNIFORM_GRID) {
+        scene.getGrid().queryAlongRay(coneAxis, lightRadius, visitOccluder);
+    } else {
+        scene.getBVH().queryAlongRay(coneAxis, lightRadius, visitOccluder);
+    }
     
-    // Combine ambient and diffuse
-    sf::Color finalLighting;
-    finalLighting.r = std::min(255, ambient.r + diffuse.r);
-    finalLighting.g = std::min(255, ambient.g + diffuse.g);
-    finalLighting.b = std::min(255, ambient.b + diffuse.b);
+    if (fullyBlocked) {
+        return 0.0f;
+    }
+    if (blocked.empty()) {
+        return 1.0f;
+    }
     
-    return finalLighting;
+    // Overlapping occluders must not be counted twice
+    mergeIntervals(blocked);
+    float coveredAngle = 0.0f;
+    for (const sf::Vector2f& interval : blocked) {
+        coveredAngle += std::atan(interval.y) - std::atan(interval.x);
+    }
+    return std::max(0.0f, 1.0f - coveredAngle / (2.0f * std::atan(lightSlope)));
 }
 
 bool RayTracer::isInShadow(const sf::Vector2f& point, const Light& light, const Scene& scene) {
-    sf::Vector2f lightDir = light.getPosition() - point;
-    float distance = Utils::calculateDistance(point, light.getPosition());
+    return isOccluded(point, light.getPosition(), scene);
+}
+
+bool RayTracer::isOccluded(const sf::Vector2f& point, const sf::Vector2f& target, const Scene& scene) {
+    PROFILE_ZONE_HOT("shadow intersection");
+    PROFILE_COUNT(ProfileCounter::SHADOW_RAYS, 1);
+    
+    sf::Vector2f lightDir = target - point;
+    float distance = Utils::calculateDistance(point, target);
     
     // Create shadow ray
     Ray shadowRay(point, lightDir, distance);
     
-    // Check for intersections between point and light
-    RayHit hit = findClosestHit(shadowRay, scene);
-    
-    // If we hit something before reaching the light, we're in shadow
-    return hit.hit && hit.distance < distance;
+    // Any intersection before reaching the light puts the point in shadow
+    if (scene.getAccelerationStructure() == AccelerationStructure::GRID) {
+        return scene.getGrid().isOccluded(shadowRay);
+    }
+    return scene.getBVH().isOccluded(shadowRay);
 }
 
 RayHit RayTracer::findClosestHit(const Ray& ray, const Scene& scene) {
-    const Sphere& sphere = scene.getSphere();
-    return sphere.intersect(ray);
+    PROFILE_ZONE_HOT("intersection");
+    if (scene.getAccelerationStructure() == AccelerationStructure::GRID) {
+        return scene.getGrid().intersect(ray, scene.getSpheres());
+    }
+    return scene.getBVH().intersect(ray, scene.getSpheres());
 }
 
-std::vector<Ray> RayTracer::generateRaysFromLight(const Light& light, int numRays) {
-    std::vector<Ray> rays;
-    float angleStep = 2.0f * M_PI / numRays;
-    
-    for (int i = 0; i < numRays; ++i) {
-        float angle = i * angleStep;
-        sf::Vector2f direction(std::cos(angle), std::sin(angle));
-        rays.emplace_back(light.getPosition(), direction);
+void RayTracer::findClosestHits(Span<const Ray> rays, Span<RayHit> hits, const Scene& scene) {
+    PROFILE_ZONE_HOT("intersection");
+    const std::vector<Sphere>& spheres = scene.getSpheres();
+    if (scene.getAccelerationStructure() == AccelerationStructure::GRID) {
+        const UniformGrid& grid = scene.getGrid();
+        for (size_t i = 0; i < rays.size(); ++i) {
+            hits[i] = grid.intersect(rays[i], spheres);
+        }
+        return;
+    }
+    const BVH& bvh = scene.getBVH();
+    for (size_t i = 0; i < rays.size(); ++i) {
+        hits[i] = bvh.intersect(rays[i], spheres);
+    }
+}
+
+void RayTracer::findClosestHits(const RayBatch& rays, int first, Span<RayHit> hits, const Scene& scene) {
+    PROFILE_ZONE_HOT("intersection");
+    const std::vector<Sphere>& spheres = scene.getSpheres();
+    const int count = static_cast<int>(hits.size());
+    if (scene.getAccelerationStructure() == AccelerationStructure::GRID) {
+        const UniformGrid& grid = scene.getGrid();
+        for (int i = 0; i < count; ++i) {
+            hits[i] = grid.intersect(rays.getRay(first + i), spheres);
+        }
+        return;
+    }
+    const BVH& bvh = scene.getBVH();
+    for (int i = 0; i < count; ++i) {
+        hits[i] = bvh.intersect(rays.getRay(first + i), spheres);
     }
-    
-    return rays;
 }
 
-std::vector<Ray> RayTracer::generateRaysFromCamera(const sf::Vector2f& cameraPos, int numRays) {
-    std::vector<Ray> rays;
+void RayTracer::generateRaysFromLight(const Light& light, int numRays, RayBatch& rays, float maxDistance) {
+    generateRaysFromCamera(light.getPosition(), numRays, rays, maxDistance);
+}
+
+void RayTracer::generateRaysFromCamera(const sf::Vector2f& cameraPos, int numRays, RayBatch& rays, float maxDistance) {
+    rays.resize(numRays);
     float angleStep = 2.0f * M_PI / numRays;
     
+    // cos and sin of one angle form a unit vector, so no normalization is needed
     for (int i = 0; i < numRays; ++i) {
         float angle = i * angleStep;
-        sf::Vector2f direction(std::cos(angle), std::sin(angle));
-        rays.emplace_back(cameraPos, direction);
+        rays.set(i, cameraPos, sf::Vector2f(std::cos(angle), std::sin(angle)), maxDistance);
     }
-    
-    return rays;
 }
 
 void RayTracer::setMaxDepth(int depth) {
     maxDepth = depth;
 }
 
-void RayTracer::setShadowRays(int rays) {
-    shadowRays = rays;
-}
-
 void RayTracer::setAntiAliasing(bool enabled) {
     antiAliasing = enabled;
 }
 
+int RayTracer::getPixelStep() const {
+    return pixelStepOverride > 0 ? pixelStepOverride : getBasePixelStep();
+}
+
+int RayTracer::getBasePixelStep() const {
+    return antiAliasing || coverageAntiAliasing ? 1 : 2; // Anti-aliasing uses every pixel
+}
+
+void RayTracer::setPixelStep(int step) {
+    pixelStepOverride = step;
+}
+
+void RayTracer::setEdgeAwareUpscaling(bool enabled) {
+    edgeAwareUpscaling = enabled;
+}
+
+bool RayTracer::isEdgeAwareUpscaling() const {
+    return edgeAwareUpscaling;
+}
+
+void RayTracer::setCoverageAntiAliasing(bool enabled) {
+    coverageAntiAliasing = enabled;
+}
+
+bool RayTracer::isCoverageAntiAliasing() const {
+    return coverageAntiAliasing;
+}
+
+void RayTracer::resolveRows(const Scene& scene, FrameBuffer& frameBuffer, int top, int bottom, ThreadPool* threadPool) {
+    // Quadtree blocks have no fixed grid of samples to interpolate between or blend across
+    if (edgeAwareUpscaling && !adaptiveSampling) {
+        Upscaling::upscaleRows(radiance, getPixelStep(), top, bottom, threadPool);
+    }
+    radiance.resolve(frameBuffer, top, bottom);
+    if (coverageAntiAliasing && !adaptiveSampling && getPixelStep() == 1) {
+        const sf::Vector2f camera = getCameraPosition();
+        Coverage::findSilhouettes(scene.getSpheres(), camera, silhouetteEdges);
+        cullHiddenSilhouettes(scene, camera, threadPool);
+        Coverage::blendSilhouettes(radiance, frameBuffer, silhouetteEdges, camera, top, bottom, threadPool);
+    }
+}
+
+void RayTracer::cullHiddenSilhouettes(const Scene& scene, const sf::Vector2f& camera, ThreadPool* threadPool) {
+    PROFILE_ZONE("RayTracer::cullHiddenSilhouettes");
+    // One shadow ray per edge is cheap next to walking its line across the frame
+    const int chunkSize = 256;
+    const int edgeCount = static_cast<int>(silhouetteEdges.size());
+    auto cullChunk = [&](int chunk) {
+        const int end = std::min(edgeCount, (chunk + 1) * chunkSize);
+        for (int i = chunk * chunkSize; i < end; ++i) {
+            Coverage::SilhouetteEdge& edge = silhouetteEdges[i];
+            // Stopping a pixel short of the tangent point keeps the sphere's own grazing hit out
+            const float reach = edge.length - 1.0f;
+            if (reach > 0.0f && isOccluded(camera, camera + edge.direction * reach, scene)) {
+                edge.length = -1.0f;
+            }
+        }
+    };
+    const int chunkCount = (edgeCount + chunkSize - 1) / chunkSize;
+    if (threadPool) {
+        threadPool->parallelFor(chunkCount, cullChunk);
+    } else {
+        for (int i = 0; i < chunkCount; ++i) {
+            cullChunk(i);
+        }
+    }
+    silhouetteEdges.erase(std::remove_if(silhouetteEdges.begin(), silhouetteEdges.end(),
+                                         [](const Coverage::SilhouetteEdge& edge) { return edge.length < 0.0f; }),
+                          silhouetteEdges.end());
+}
+
+void RayTracer::setAdaptiveSampling(bool enabled) {
+    adaptiveSampling = enabled;
+}
+
+bool RayTracer::isAdaptiveSampling() const {
+    return adaptiveSampling;
+}
+
+void RayTracer::setAdaptiveThreshold(int threshold) {
+    adaptiveThreshold = threshold;
+}
+
+int RayTracer::getAdaptiveThreshold() const {
+    return adaptiveThreshold;
+}
+
+sf::Vector2f RayTracer::getCameraPosition() const {
+    return sf::Vector2f(0.f, 0.f); // Top-left of screen
+}
+
 void RayTracer::renderLight(sf::RenderWindow& window, const Light& light) {
     sf::CircleShape lightShape(Utils::LIGHT_RADIUS);
     lightShape.setOrigin(Utils::LIGHT_RADIUS, Utils::LIGHT_RADIUS);
@@ -1,18 +1,52 @@
 #include "../include/renderer.hpp"
 #include "../include/scene.hpp"
+#include "../include/profiler.hpp"
+#include "../include/adaptivesampling.hpp"
+#include "../include/upscaling.hpp"
+#include "../include/coverage.hpp"
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <limits>
+
+namespace {
+    // Debug rays traced per thread pool task
+    constexpr int DEBUG_RAY_CHUNK_SIZE = 4096;
+}
 
 Renderer::Renderer() 
     : ambientLight(0.3f)
     , diffuseIntensity(2.0f)
     , maxLightDistance(800.0f)
+    , pixelStep(2) // Reduced for better quality
+    , frameStep(2)
     , showDebugInfo(true)
     , is2DModeEnabled(false)
     , isRealRayTracingEnabled(false)
-    , rayDisplayMode(RayDisplayMode::ALL_RAYS) {
+    , isParallelRenderingEnabled(true)
+    , isIncrementalRenderingEnabled(true)
+    , isAdaptiveSamplingEnabled(false)
+    , isProgressiveRenderingEnabled(false)
+    , isTemporalReprojectionEnabled(false)
+    , isFrameGovernorEnabled(false)
+    , isCoverageAntiAliasingEnabled(false)
+    , adaptiveThreshold(AdaptiveSampling::DEFAULT_THRESHOLD)
+    , rayDisplayMode(RayDisplayMode::ALL_RAYS)
+    , debugRayCount(Utils::MIN_DEBUG_RAYS)
+    , frameBuffer(Utils::WINDOW_WIDTH, Utils::WINDOW_HEIGHT)
+    , hasCachedFrame(false)
+    , sceneChanged(true)
+    , cachedRealRayTracing(false)
+    , cachedPixelStep(0)
+    , cachedAdaptiveThreshold(-1)
+    , cachedWidth(0)
+    , cachedHeight(0)
+    , cachedRevision(0) {
 }
 
 void Renderer::renderScene(sf::RenderWindow& window, const Scene& scene) {
+    PROFILE_ZONE("Renderer::renderScene");
+    
     if (isRealRayTracingEnabled) {
         renderRealRayTracing(window, scene);
     } else if (is2DModeEnabled) {
@@ -21,66 +55,37 @@ void Renderer::renderScene(sf::RenderWindow& window, const Scene& scene) {
         clearWindow(window);
         
         // Draw rays based on display mode
-        if (showDebugInfo) {
-            switch (rayDisplayMode) {
-                case RayDisplayMode::NONE:
-                    break;
-                case RayDisplayMode::SPHERE_ONLY:
-                    drawRays(window, scene.getLight(), scene.getSphere());
-                    break;
-                case RayDisplayMode::ALL_RAYS:
-                    drawAllRays(window, scene.getLight());
-                    break;
-                case RayDisplayMode::BOTH:
-                    drawAllRays(window, scene.getLight());
-                    drawRays(window, scene.getLight(), scene.getSphere());
-                    break;
-            }
+        if (showDebugInfo && rayDisplayMode != RayDisplayMode::NONE) {
+            drawDebugRays(window, scene);
         }
         
-        renderSphere(window, scene.getSphere(), scene.getLight());
-        renderLight(window, scene.getLight());
+        for (const Sphere& sphere : scene.getSpheres()) {
+            renderSphere(window, sphere, scene.getLight());
+        }
+        for (const Light& light : scene.getLights()) {
+            renderLight(window, light);
+        }
     }
 }
 
 void Renderer::renderRealRayTracing(sf::RenderWindow& window, const Scene& scene) {
-    rayTracer.renderScene(window, scene);
+    PROFILE_ZONE("Renderer::renderRealRayTracing");
+    traceFrame(scene);
+    frameBuffer.present(window);
+    drawTraceOverlays(window, scene);
 }
 
-void Renderer::render2DScene(sf::RenderWindow& window, const Scene& scene) {
-    const Light& light = scene.getLight();
-    const Sphere& sphere = scene.getSphere();
-    
-    // Create a texture to render the 2D lighting
-    sf::RenderTexture lightingTexture;
-    lightingTexture.create(Utils::WINDOW_WIDTH, Utils::WINDOW_HEIGHT);
-    lightingTexture.clear(sf::Color::Black);
-    
-    // Fill the screen with light, but create shadows where the sphere blocks it
-    const int pixelStep = 2; // Reduced for better quality
-    
-    for (int x = 0; x < Utils::WINDOW_WIDTH; x += pixelStep) {
-        for (int y = 0; y < Utils::WINDOW_HEIGHT; y += pixelStep) {
-            sf::Vector2f pixelPos(static_cast<float>(x), static_cast<float>(y));
-            
-            // Calculate lighting for this pixel
-            sf::Color pixelColor = calculate2DLighting(pixelPos, light, sphere);
-            
-            // Draw a small rectangle for this pixel
-            sf::RectangleShape pixel(sf::Vector2f(pixelStep, pixelStep));
-            pixel.setPosition(pixelPos);
-            pixel.setFillColor(pixelColor);
-            lightingTexture.draw(pixel);
-        }
+void Renderer::drawTraceOverlays(sf::RenderWindow& window, const Scene& scene) {
+    if (isRealRayTracingEnabled) {
+        rayTracer.drawSceneMarkers(window, scene);
+        return;
+    }
+    if (!is2DModeEnabled) {
+        return;
     }
-    
-    lightingTexture.display();
-    
-    // Draw the lighting texture to the window
-    sf::Sprite lightingSprite(lightingTexture.getTexture());
-    window.draw(lightingSprite);
     
     // Draw the sphere outline to show its position
+    const Sphere& sphere = scene.getSphere();
     sf::CircleShape sphereOutline(sphere.getRadius());
     sphereOutline.setOrigin(sphere.getRadius(), sphere.getRadius());
     sphereOutline.setPosition(sphere.getPosition());
@@ -90,7 +95,466 @@ void Renderer::render2DScene(sf::RenderWindow& window, const Scene& scene) {
     window.draw(sphereOutline);
     
     // Draw the light source
-    renderLight(window, light);
+    renderLight(window, scene.getLight());
+}
+
+void Renderer::traceFrame(const Scene& scene) {
+    if (!isRealRayTracingEnabled && !is2DModeEnabled) {
+        return;
+    }
+    
+    // Adaptive sampling picks its own density per block
+    const bool governed = isFrameGovernorEnabled && !isAdaptiveSamplingEnabled;
+    const GovernedMode mode = isRealRayTracingEnabled ? GovernedMode::RAY_TRACING : GovernedMode::MODE_2D;
+    const int configuredStep = isRealRayTracingEnabled ? rayTracer.getBasePixelStep()
+        : isCoverageAntiAliasingEnabled ? 1 : pixelStep;
+    const int step = governed ? governor.getStep(mode, configuredStep) : configuredStep;
+    rayTracer.setPixelStep(governed && isRealRayTracingEnabled ? step : 0);
+    rayTracer.setEdgeAwareUpscaling(governed);
+    frameStep = isRealRayTracingEnabled ? pixelStep : step;
+    
+    auto start = std::chrono::steady_clock::now();
+    if (isRealRayTracingEnabled) {
+        traceRealRayTracingFrame(scene);
+    } else {
+        trace2DFrame(scene);
+    }
+    
+    // A static frame being refined progressively has no frame time to keep
+    if (governed && !(isRealRayTracingEnabled && isProgressiveRenderingEnabled && !sceneChanged)) {
+        auto end = std::chrono::steady_clock::now();
+        governor.addFrame(mode, std::chrono::duration<float, std::milli>(end - start).count(), configuredStep);
+    }
+}
+
+void Renderer::traceRealRayTracingFrame(const Scene& scene) {
+    updateDirtyRegion(scene);
+    ThreadPool* pool = isParallelRenderingEnabled ? &threadPool : nullptr;
+    
+    if (isProgressiveRenderingEnabled) {
+        accumulation.resize(frameBuffer.getWidth(), frameBuffer.getHeight(), Utils::RENDER_TILE_SIZE);
+        if (!sceneChanged) {
+            rayTracer.accumulateFrame(scene, frameBuffer, accumulation, pool);
+            return;
+        }
+        // Soft shadows reach past the point-light wedges the dirty region tracks,
+        // so every tile starts over; the moving frame itself is traced as usual
+        accumulation.reset();
+    }
+    if (isTemporalReprojectionEnabled) {
+        rayTracer.reprojectFrame(scene, frameBuffer, reprojection, pool, &dirtyRegion);
+        return;
+    }
+    rayTracer.traceFrame(scene, frameBuffer, pool, &dirtyRegion);
+}
+
+void Renderer::trace2DFrame(const Scene& scene) {
+    PROFILE_ZONE("Renderer::trace2DFrame");
+    updateDirtyRegion(scene);
+    
+    // The light-sphere relationship is the same for every pixel
+    const ShadowWedge wedge = computeShadowWedge(scene.getLight(), scene.getSphere());
+    // The governor's steps are interpolated between samples; see Upscaling
+    const bool upscale = isFrameGovernorEnabled && !isAdaptiveSamplingEnabled;
+    ThreadPool* pool = isParallelRenderingEnabled ? &threadPool : nullptr;
+    
+    if (!dirtyRegion.isFull()) {
+        // Only the tiles the scene change can reach are traced again
+        const std::vector<int>& tiles = dirtyRegion.getTiles();
+        const int tileSize = dirtyRegion.getTileSize();
+        auto renderDirtyTile = [&](int index) {
+            render2DTile(scene, frameBuffer.getTile(tiles[index], tileSize), wedge);
+        };
+        if (isParallelRenderingEnabled) {
+            threadPool.parallelFor(static_cast<int>(tiles.size()), renderDirtyTile);
+        } else {
+            for (int i = 0; i < static_cast<int>(tiles.size()); ++i) {
+                renderDirtyTile(i);
+            }
+        }
+        
+        int top, bottom;
+        if (dirtyRegion.getRowSpan(top, bottom)) {
+            if (upscale) {
+                Upscaling::upscaleRows(frameBuffer, frameStep, top, bottom, pool);
+            }
+            frameBuffer.markDirty(top, bottom);
+        }
+        return;
+    }
+    
+    if (isParallelRenderingEnabled) {
+        const int tileCount = frameBuffer.getTileCount(Utils::RENDER_TILE_SIZE);
+        threadPool.parallelFor(tileCount, [&](int index) {
+            render2DTile(scene, frameBuffer.getTile(index, Utils::RENDER_TILE_SIZE), wedge);
+        });
+    } else {
+        Tile fullFrame = { 0, 0, static_cast<int>(frameBuffer.getWidth()), static_cast<int>(frameBuffer.getHeight()) };
+        render2DTile(scene, fullFrame, wedge);
+    }
+    if (upscale) {
+        int top = 0;
+        int bottom = static_cast<int>(frameBuffer.getHeight());
+        Upscaling::upscaleRows(frameBuffer, frameStep, top, bottom, pool);
+    }
+    frameBuffer.markDirty();
+}
+
+void Renderer::updateDirtyRegion(const Scene& scene) {
+    PROFILE_ZONE("Renderer::updateDirtyRegion");
+    dirtyRegion.reset(frameBuffer, Utils::RENDER_TILE_SIZE);
+    
+    const int samplingStep = getSamplingStep();
+    const int samplingThreshold = isAdaptiveSamplingEnabled ? adaptiveThreshold : -1;
+    bool settingsChanged = !hasCachedFrame
+        || cachedRealRayTracing != isRealRayTracingEnabled
+        || cachedPixelStep != samplingStep
+        || cachedAdaptiveThreshold != samplingThreshold
+        || cachedWidth != frameBuffer.getWidth()
+        || cachedHeight != frameBuffer.getHeight();
+    
+    sceneChanged = settingsChanged || cachedRevision != scene.getRevision()
+        || cachedSpheres.size() != scene.getSpheres().size()
+        || cachedLights.size() != scene.getLights().size();
+    
+    if (!isIncrementalRenderingEnabled || settingsChanged
+        || cachedSpheres.size() != scene.getSpheres().size()
+        || cachedLights.size() != scene.getLights().size()) {
+        dirtyRegion.markAll();
+    } else if (cachedRevision != scene.getRevision()) {
+        if (isRealRayTracingEnabled) {
+            addRayTracingChanges(scene);
+        } else {
+            add2DChanges(scene);
+        }
+    }
+    
+    // A static scene leaves the region empty and the cached frame is presented as is
+    if (settingsChanged || cachedRevision != scene.getRevision()) {
+        cacheSceneState(scene);
+    }
+    hasCachedFrame = true;
+    cachedRealRayTracing = isRealRayTracingEnabled;
+    cachedPixelStep = samplingStep;
+    cachedAdaptiveThreshold = samplingThreshold;
+    cachedWidth = frameBuffer.getWidth();
+    cachedHeight = frameBuffer.getHeight();
+}
+
+void Renderer::addRayTracingChanges(const Scene& scene) {
+    const std::vector<Sphere>& spheres = scene.getSpheres();
+    const std::vector<Light>& lights = scene.getLights();
+    const sf::Vector2f camera = rayTracer.getCameraPosition();
+    
+    // Mirror and glass spheres can show any sphere, light or shadow in the scene,
+    // so every change re-traces what they cover; this includes a changed surface
+    for (size_t i = 0; i < spheres.size(); ++i) {
+        if (spheres[i].getSurface() != SurfaceType::DIFFUSE || cachedSurfaces[i] != SurfaceType::DIFFUSE) {
+            const sf::Vector3f& cached = cachedSpheres[i];
+            dirtyRegion.addCameraWedge(camera, sf::Vector2f(cached.x, cached.y), cached.z);
+            dirtyRegion.addCameraWedge(camera, spheres[i].getPosition(), spheres[i].getRadius());
+        }
+    }
+    
+    bool lightsMoved = false;
+    for (size_t i = 0; i < lights.size(); ++i) {
+        lightsMoved = lightsMoved || lights[i].getPosition() != cachedLights[i];
+    }
+    
+    // Camera rays that miss every sphere always show the background, so a
+    // moved light can only change pixels inside some sphere's camera wedge
+    if (lightsMoved) {
+        for (size_t i = 0; i < spheres.size(); ++i) {
+            const sf::Vector3f& cached = cachedSpheres[i];
+            dirtyRegion.addCameraWedge(camera, sf::Vector2f(cached.x, cached.y), cached.z);
+            dirtyRegion.addCameraWedge(camera, spheres[i].getPosition(), spheres[i].getRadius());
+        }
+        return;
+    }
+    
+    for (size_t i = 0; i < spheres.size() && !dirtyRegion.isFull(); ++i) {
+        const sf::Vector3f& cached = cachedSpheres[i];
+        sf::Vector2f oldCenter(cached.x, cached.y);
+        if (oldCenter == spheres[i].getPosition() && cached.z == spheres[i].getRadius()) {
+            continue;
+        }
+        
+        // Pixels the sphere covered before and covers now
+        dirtyRegion.addCameraWedge(camera, oldCenter, cached.z);
+        dirtyRegion.addCameraWedge(camera, spheres[i].getPosition(), spheres[i].getRadius());
+        
+        // Other spheres whose shading its old or new shadow can reach
+        for (size_t j = 0; j < spheres.size(); ++j) {
+            if (j == i) {
+                continue;
+            }
+            for (const Light& light : lights) {
+                if (DirtyRegion::canShadow(light.getPosition(), Utils::LIGHT_RADIUS, oldCenter, cached.z,
+                                           spheres[j].getPosition(), spheres[j].getRadius())
+                    || DirtyRegion::canShadow(light.getPosition(), Utils::LIGHT_RADIUS, spheres[i].getPosition(),
+                                              spheres[i].getRadius(), spheres[j].getPosition(), spheres[j].getRadius())) {
+                    dirtyRegion.addCameraWedge(camera, spheres[j].getPosition(), spheres[j].getRadius());
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void Renderer::add2DChanges(const Scene& scene) {
+    // The 2D view is lit by the primary light and shadowed by the primary sphere only
+    const sf::Vector2f lightPos = scene.getLight().getPosition();
+    const sf::Vector2f spherePos = scene.getSphere().getPosition();
+    const float radius = scene.getSphere().getRadius();
+    const sf::Vector2f oldLightPos = cachedLights.front();
+    const sf::Vector2f oldSpherePos(cachedSpheres.front().x, cachedSpheres.front().y);
+    const float oldRadius = cachedSpheres.front().z;
+    
+    if (lightPos != oldLightPos) {
+        // Beyond maxLightDistance only the constant ambient term remains
+        dirtyRegion.addCircle(oldLightPos, maxLightDistance);
+        dirtyRegion.addCircle(lightPos, maxLightDistance);
+    } else if (spherePos == oldSpherePos && radius == oldRadius) {
+        return;
+    }
+    
+    dirtyRegion.addShadowWedge(oldLightPos, oldSpherePos, oldRadius);
+    dirtyRegion.addShadowWedge(lightPos, spherePos, radius);
+}
+
+void Renderer::cacheSceneState(const Scene& scene) {
+    cachedRevision = scene.getRevision();
+    cachedSpheres.resize(scene.getSpheres().size());
+    cachedSurfaces.resize(scene.getSpheres().size());
+    for (size_t i = 0; i < cachedSpheres.size(); ++i) {
+        const Sphere& sphere = scene.getSpheres()[i];
+        cachedSpheres[i] = sf::Vector3f(sphere.getPosition().x, sphere.getPosition().y, sphere.getRadius());
+        cachedSurfaces[i] = sphere.getSurface();
+    }
+    cachedLights.resize(scene.getLights().size());
+    for (size_t i = 0; i < cachedLights.size(); ++i) {
+        cachedLights[i] = scene.getLights()[i].getPosition();
+    }
+}
+
+void Renderer::render2DScene(sf::RenderWindow& window, const Scene& scene) {
+    traceFrame(scene);
+    
+    // Upload and draw the lighting in a single call
+    frameBuffer.present(window);
+    drawTraceOverlays(window, scene);
+}
+
+void Renderer::render2DTile(const Scene& scene, const Tile& tile, const ShadowWedge& wedge) {
+    PROFILE_ZONE("Renderer::render2DTile");
+    
+    const sf::Vector2f lightPos = scene.getLight().getPosition();
+    const int sampleCount = (tile.width + frameStep - 1) / frameStep;
+    const sf::Color shadowColor(10, 10, 10); // Very dark shadow
+    
+    if (isAdaptiveSamplingEnabled) {
+        // Shadow edges change the state; the smooth falloff is left to the threshold
+        AdaptiveSampling::renderTile(frameBuffer, tile, adaptiveThreshold, [&](int x, int y) {
+            sf::Vector2f point(static_cast<float>(x), static_cast<float>(y));
+            AdaptiveSampling::Sample sample;
+            bool inShadow = isInShadowWedge(point, wedge);
+            sample.color = inShadow ? shadowColor : calculate2DLitColor(Utils::calculateDistance(point, lightPos));
+            sample.state = inShadow ? 1 : 0;
+            return sample;
+        });
+        return;
+    }
+    
+    // Past maxLightDistance only ambient light is left, and close to the light the
+    // lighting saturates, so only the ring in between needs a square root per pixel
+    const sf::Color ambientColor = calculate2DLitColor(maxLightDistance);
+    const sf::Color saturatedColor = calculate2DLitColor(0.0f);
+    const float outerSquared = maxLightDistance * maxLightDistance;
+    float innerDistance = diffuseIntensity > 0.0f ? maxLightDistance * (1.0f - (1.0f - ambientLight) / diffuseIntensity) - 1.0f : 0.0f;
+    innerDistance = std::max(innerDistance, 0.0f);
+    const float innerSquared = innerDistance * innerDistance;
+    
+    for (int y = tile.y; y < tile.y + tile.height; y += frameStep) {
+        const float dy = static_cast<float>(y) - lightPos.y;
+        
+        int spanStart[2];
+        int spanEnd[2];
+        int spanCount = findShadowSpans(wedge, y, tile.x, sampleCount, spanStart, spanEnd);
+        
+        // Alternate between lit samples and whole shadow spans along the scanline
+        int sample = 0;
+        for (int span = 0; span <= spanCount; ++span) {
+            const int litEnd = span < spanCount ? spanStart[span] : sampleCount;
+            for (; sample < litEnd; ++sample) {
+                const int x = tile.x + sample * frameStep;
+                const float dx = lightPos.x - static_cast<float>(x);
+                const float distanceSquared = dx * dx + dy * dy;
+                
+                sf::Color pixelColor;
+                if (distanceSquared >= outerSquared) {
+                    pixelColor = ambientColor;
+                } else if (distanceSquared <= innerSquared) {
+                    pixelColor = saturatedColor;
+                } else {
+                    pixelColor = calculate2DLitColor(std::sqrt(distanceSquared));
+                }
+                frameBuffer.fillRect(x, y, frameStep, frameStep, pixelColor);
+            }
+            
+            if (span < spanCount) {
+                frameBuffer.fillRect(tile.x + spanStart[span] * frameStep, y,
+                                     (spanEnd[span] - spanStart[span]) * frameStep, frameStep, shadowColor);
+                sample = spanEnd[span];
+            }
+        }
+        if (isCoverageAntiAliasingEnabled && frameStep == 1 && wedge.castsShadow) {
+            blendShadowEdges(wedge, tile, y, lightPos, shadowColor);
+        }
+    }
+    
+    PROFILE_COUNT(ProfileCounter::PIXELS_SHADED,
+                  static_cast<uint64_t>(sampleCount) * ((tile.height + frameStep - 1) / frameStep));
+}
+
+void Renderer::blendShadowEdges(const ShadowWedge& wedge, const Tile& tile, int y, const sf::Vector2f& lightPos,
+                                const sf::Color& shadowColor) {
+    const float dy = static_cast<float>(y) - wedge.apex.y;
+    const float nearDistance = std::sqrt(wedge.nearDistanceSquared);
+    
+    // Columns of the row within half a pixel's width of each edge, as [first, last] pairs
+    float intervals[4][2];
+    int intervalCount = 0;
+    for (const sf::Vector2f& normal : { wedge.firstEdgeNormal, wedge.secondEdgeNormal }) {
+        const float halfWidth = Coverage::halfWidth(normal);
+        const float rowDistance = normal.y * dy;
+        if (normal.x != 0.0f) {
+            const float a = wedge.apex.x + (-halfWidth - rowDistance) / normal.x;
+            const float b = wedge.apex.x + (halfWidth - rowDistance) / normal.x;
+            intervals[intervalCount][0] = std::min(a, b);
+            intervals[intervalCount][1] = std::max(a, b);
+            ++intervalCount;
+        } else if (std::abs(rowDistance) < halfWidth) {
+            intervals[intervalCount][0] = static_cast<float>(tile.x);
+            intervals[intervalCount][1] = static_cast<float>(tile.x + tile.width);
+            ++intervalCount;
+        }
+    }
+    // The near cutoff is a circle around the light; a radial normal is never more than
+    // sqrt(1/2) from crossing the pixel, so the ring that wide is checked
+    const float ringWidth = 0.7072f;
+    const float innerRadius = std::max(nearDistance - ringWidth, 0.0f);
+    const float innerSquared = innerRadius * innerRadius - dy * dy;
+    const float outerSquared = (nearDistance + ringWidth) * (nearDistance + ringWidth) - dy * dy;
+    if (outerSquared > 0.0f) {
+        const float outer = std::sqrt(outerSquared);
+        const float inner = innerSquared > 0.0f ? std::sqrt(innerSquared) : 0.0f;
+        intervals[intervalCount][0] = wedge.apex.x - outer;
+        intervals[intervalCount][1] = wedge.apex.x - inner;
+        intervals[intervalCount + 1][0] = wedge.apex.x + inner;
+        intervals[intervalCount + 1][1] = wedge.apex.x + outer;
+        intervalCount += 2;
+    }
+    
+    for (int i = 0; i < intervalCount; ++i) {
+        const int first = std::max(static_cast<int>(std::ceil(intervals[i][0])), tile.x);
+        const int last = std::min(static_cast<int>(std::floor(intervals[i][1])), tile.x + tile.width - 1);
+        for (int x = first; x <= last; ++x) {
+            const sf::Vector2f offset(static_cast<float>(x) - wedge.apex.x, dy);
+            const float distance = std::sqrt(offset.x * offset.x + offset.y * offset.y);
+            
+            // The wedge is the intersection of the two tangent half-planes and the outside
+            // of the near circle; the parts of the pixel outside each are taken as disjoint
+            float outside = 0.0f;
+            for (const sf::Vector2f& normal : { wedge.firstEdgeNormal, wedge.secondEdgeNormal }) {
+                outside += 1.0f - Coverage::halfPlane(-(normal.x * offset.x + normal.y * offset.y), normal);
+            }
+            if (distance > 0.0f) {
+                outside += 1.0f - Coverage::halfPlane(distance - nearDistance, offset / distance);
+            }
+            const float covered = std::max(1.0f - outside, 0.0f);
+            
+            const sf::Vector2f point(static_cast<float>(x), static_cast<float>(y));
+            const sf::Color lit = calculate2DLitColor(Utils::calculateDistance(point, lightPos));
+            frameBuffer.setPixel(x, y, sf::Color(
+                static_cast<sf::Uint8>(lit.r + (shadowColor.r - lit.r) * covered + 0.5f),
+                static_cast<sf::Uint8>(lit.g + (shadowColor.g - lit.g) * covered + 0.5f),
+                static_cast<sf::Uint8>(lit.b + (shadowColor.b - lit.b) * covered + 0.5f)));
+        }
+    }
+}
+
+int Renderer::findShadowSpans(const ShadowWedge& wedge, int y, int firstX, int sampleCount, int* spanStart, int* spanEnd) const {
+    if (!wedge.castsShadow || sampleCount <= 0) {
+        return 0;
+    }
+    
+    const float dy = static_cast<float>(y) - wedge.apex.y;
+    const float infinity = std::numeric_limits<float>::infinity();
+    
+    // Each tangent line bounds the row on one side: normal.x * dx + normal.y * dy < 0
+    float low = -infinity;
+    float high = infinity;
+    for (const sf::Vector2f& normal : { wedge.firstEdgeNormal, wedge.secondEdgeNormal }) {
+        if (normal.x > 0.0f) {
+            high = std::min(high, -normal.y * dy / normal.x);
+        } else if (normal.x < 0.0f) {
+            low = std::max(low, -normal.y * dy / normal.x);
+        } else if (normal.y * dy >= 0.0f) {
+            return 0;
+        }
+    }
+    if (low >= high) {
+        return 0;
+    }
+    
+    // The near cutoff removes the chord of the row inside the sphere-center distance
+    float intervals[2][2] = { { low, high }, { 0.0f, 0.0f } };
+    int intervalCount = 1;
+    const float chordSquared = wedge.nearDistanceSquared - dy * dy;
+    if (chordSquared > 0.0f) {
+        const float halfChord = std::sqrt(chordSquared);
+        intervals[0][1] = std::min(high, -halfChord);
+        intervals[1][0] = std::max(low, halfChord);
+        intervals[1][1] = high;
+        intervalCount = 2;
+    }
+    
+    // Convert light-relative offsets to sample indices; the ends are then settled with
+    // the exact point test so spans always agree with isInShadowWedge
+    const float step = static_cast<float>(frameStep);
+    const float origin = static_cast<float>(firstX) - wedge.apex.x;
+    auto inShadow = [&](int sample) {
+        return isInShadowWedge(sf::Vector2f(static_cast<float>(firstX + sample * frameStep), static_cast<float>(y)), wedge);
+    };
+    
+    int spanCount = 0;
+    for (int i = 0; i < intervalCount; ++i) {
+        if (intervals[i][0] >= intervals[i][1]) {
+            continue;
+        }
+        float first = std::floor((intervals[i][0] - origin) / step);
+        float last = std::ceil((intervals[i][1] - origin) / step);
+        int start = static_cast<int>(Utils::clamp(first, 0.0f, static_cast<float>(sampleCount)));
+        int end = static_cast<int>(Utils::clamp(last + 1.0f, 0.0f, static_cast<float>(sampleCount)));
+        
+        while (start < end && !inShadow(start)) ++start;
+        while (end > start && !inShadow(end - 1)) --end;
+        if (start == end) {
+            continue;
+        }
+        while (start > 0 && inShadow(start - 1)) --start;
+        while (end < sampleCount && inShadow(end)) ++end;
+        
+        // Spans that meet across a chord narrower than a sample are merged
+        if (spanCount > 0 && start <= spanEnd[spanCount - 1]) {
+            spanEnd[spanCount - 1] = std::max(spanEnd[spanCount - 1], end);
+            continue;
+        }
+        spanStart[spanCount] = start;
+        spanEnd[spanCount] = end;
+        ++spanCount;
+    }
+    return spanCount;
 }
 
 void Renderer::renderSphere(sf::RenderWindow& window, const Sphere& sphere, const Light& light) {
@@ -130,47 +594,52 @@ sf::Color Renderer::calculateSphereColor(const Sphere& sphere, const Light& ligh
 }
 
 bool Renderer::isPointInShadow(const sf::Vector2f& point, const Light& light, const Sphere& sphere) {
-    // Check if the point is behind the sphere relative to the light
-    sf::Vector2f lightToPoint = point - light.getPosition();
-    sf::Vector2f lightToSphere = sphere.getPosition() - light.getPosition();
-    
-    // Calculate distances
-    float distanceToPoint = Utils::calculateDistance(light.getPosition(), point);
-    float distanceToSphere = Utils::calculateDistance(light.getPosition(), sphere.getPosition());
-    
-    // If point is closer to light than sphere, it's not in shadow
-    if (distanceToPoint < distanceToSphere) {
-        return false;
-    }
-    
-    // Calculate the angle between light-to-point and light-to-sphere vectors
-    float dotProduct = lightToPoint.x * lightToSphere.x + lightToPoint.y * lightToSphere.y;
-    float pointMagnitude = std::sqrt(lightToPoint.x * lightToPoint.x + lightToPoint.y * lightToPoint.y);
-    float sphereMagnitude = std::sqrt(lightToSphere.x * lightToSphere.x + lightToSphere.y * lightToSphere.y);
+    return isInShadowWedge(point, computeShadowWedge(light, sphere));
+}
+
+ShadowWedge Renderer::computeShadowWedge(const Light& light, const Sphere& sphere) const {
+    ShadowWedge wedge;
+    wedge.apex = light.getPosition();
     
-    if (pointMagnitude == 0 || sphereMagnitude == 0) {
-        return false;
+    sf::Vector2f firstEdge, secondEdge, axis;
+    float distanceToSphere;
+    // A light inside the sphere has no tangent lines and casts no shadow
+    wedge.castsShadow = Utils::getTangentDirections(light.getPosition(), sphere.getPosition(), sphere.getRadius(),
+                                                    firstEdge, secondEdge, axis, distanceToSphere);
+    wedge.nearDistanceSquared = distanceToSphere * distanceToSphere;
+    if (!wedge.castsShadow) {
+        wedge.firstEdgeNormal = sf::Vector2f(0.f, 0.f);
+        wedge.secondEdgeNormal = sf::Vector2f(0.f, 0.f);
+        return wedge;
     }
     
-    float cosAngle = dotProduct / (pointMagnitude * sphereMagnitude);
-    cosAngle = Utils::clamp(cosAngle, -1.0f, 1.0f);
-    float angle = std::acos(cosAngle);
-    
-    // Calculate the angle subtended by the sphere at the light
-    float sphereAngle = std::asin(sphere.getRadius() / distanceToSphere);
-    
-    // If the angle is less than the sphere's subtended angle, the point is in shadow
-    return angle < sphereAngle;
+    // Normals point away from the wedge, so inside points give negative dot products
+    wedge.firstEdgeNormal = sf::Vector2f(-firstEdge.y, firstEdge.x);
+    wedge.secondEdgeNormal = sf::Vector2f(secondEdge.y, -secondEdge.x);
+    return wedge;
+}
+
+bool Renderer::isInShadowWedge(const sf::Vector2f& point, const ShadowWedge& wedge) const {
+    sf::Vector2f offset = point - wedge.apex;
+    return wedge.castsShadow
+        && wedge.firstEdgeNormal.x * offset.x + wedge.firstEdgeNormal.y * offset.y < 0.0f
+        && wedge.secondEdgeNormal.x * offset.x + wedge.secondEdgeNormal.y * offset.y < 0.0f
+        && offset.x * offset.x + offset.y * offset.y >= wedge.nearDistanceSquared;
 }
 
 sf::Color Renderer::calculate2DLighting(const sf::Vector2f& point, const Light& light, const Sphere& sphere) {
+    PROFILE_ZONE_HOT("calculate2DLighting");
+    
     // Check if point is in shadow
     if (isPointInShadow(point, light, sphere)) {
         return sf::Color(10, 10, 10); // Very dark shadow
     }
     
+    return calculate2DLitColor(Utils::calculateDistance(point, light.getPosition()));
+}
+
+sf::Color Renderer::calculate2DLitColor(float distance) const {
     // Calculate lighting based on distance from light
-    float distance = Utils::calculateDistance(point, light.getPosition());
     float lighting = Utils::clamp(1.0f - (distance / maxLightDistance), 0.0f, 1.0f);
     
     // Apply stronger lighting with ambient light
@@ -194,96 +663,126 @@ void Renderer::drawDebugInfo(sf::RenderWindow& window, const sf::Vector2f& mouse
     if (!showDebugInfo) return;
     
     // Draw thick ray from light to mouse
-    sf::RectangleShape ray;
-    ray.setSize(sf::Vector2f(Utils::calculateDistance(light.getPosition(), mousePos), 3.0f)); // Thick ray
-    ray.setFillColor(sf::Color::Yellow);
-    
-    // Calculate rotation angle
-    float angle = std::atan2(mousePos.y - light.getPosition().y, mousePos.x - light.getPosition().x);
-    ray.setRotation(angle * 180.0f / M_PI);
+    sf::Vertex quad[4];
+    DebugRays::makeQuad(light.getPosition(), mousePos, sf::Color::Yellow, 3.0f, quad);
+    window.draw(quad, 4, sf::Quads);
+}
+
+template <typename RayColor>
+void Renderer::addTracedRays(const Scene& scene, float thickness, RayColor rayColor) {
+    PROFILE_ZONE("Renderer::addTracedRays");
+    const int count = debugRayBatch.size();
+    if (count == 0) {
+        return;
+    }
+    debugHits.resize(count);
+    sf::Vertex* quads = debugRays.appendSegments(count);
     
-    // Position the ray at the light center
-    ray.setOrigin(0, 1.5f); // Center vertically
-    ray.setPosition(light.getPosition());
+    // Chunks write disjoint rays, hits and quads, so they can run on the pool
+    const int chunkCount = (count + DEBUG_RAY_CHUNK_SIZE - 1) / DEBUG_RAY_CHUNK_SIZE;
+    auto traceChunk = [&](int chunk) {
+        const int first = chunk * DEBUG_RAY_CHUNK_SIZE;
+        const int last = std::min(count, first + DEBUG_RAY_CHUNK_SIZE);
+        rayTracer.findClosestHits(debugRayBatch, first, Span<RayHit>(&debugHits[first], last - first), scene);
+        
+        // Rays that hit nothing stop at their maximum distance
+        for (int i = first; i < last; ++i) {
+            const Ray ray = debugRayBatch.getRay(i);
+            const sf::Vector2f rayEnd = debugHits[i].hit ? debugHits[i].point : ray.getPointAtDistance(ray.maxDistance);
+            DebugRays::makeQuad(ray.origin, rayEnd, rayColor(i, rayEnd), thickness, quads + 4 * i);
+        }
+    };
+    if (isParallelRenderingEnabled && chunkCount > 1) {
+        threadPool.parallelFor(chunkCount, traceChunk);
+    } else {
+        for (int chunk = 0; chunk < chunkCount; ++chunk) {
+            traceChunk(chunk);
+        }
+    }
+}
+
+void Renderer::drawDebugRays(sf::RenderWindow& window, const Scene& scene) {
+    buildDebugRays(scene);
+    debugRays.draw(window);
     
-    window.draw(ray);
+    if (rayDisplayMode == RayDisplayMode::SPHERE_ONLY || rayDisplayMode == RayDisplayMode::BOTH) {
+        drawLightRadius(window, scene.getLight());
+    }
 }
 
-void Renderer::drawAllRays(sf::RenderWindow& window, const Light& light) {
-    const int numRays = 36; // More rays for better coverage
-    float angleStep = 2.0f * M_PI / numRays;
+void Renderer::buildDebugRays(const Scene& scene) {
+    PROFILE_ZONE("Renderer::buildDebugRays");
+    debugRays.clear();
+    if (rayDisplayMode == RayDisplayMode::ALL_RAYS || rayDisplayMode == RayDisplayMode::BOTH) {
+        addAllRays(scene, scene.getLight());
+    }
+    if (rayDisplayMode == RayDisplayMode::SPHERE_ONLY || rayDisplayMode == RayDisplayMode::BOTH) {
+        addSphereRays(scene, scene.getLight(), scene.getSphere());
+    }
+}
+
+void Renderer::addAllRays(const Scene& scene, const Light& light) {
+    rayTracer.generateRaysFromLight(light, debugRayCount, debugRayBatch, maxLightDistance);
     
-    for (int i = 0; i < numRays; ++i) {
-        float angle = i * angleStep;
-        
-        // Calculate ray end point at maximum light distance
-        sf::Vector2f rayEnd = light.getPosition() + sf::Vector2f(
-            std::cos(angle) * maxLightDistance,
-            std::sin(angle) * maxLightDistance
-        );
-        
+    // Thinner rays once there are enough to fill the screen
+    const float thickness = debugRayCount > 1000 ? 1.0f : 2.0f;
+    addTracedRays(scene, thickness, [&](int, const sf::Vector2f& rayEnd) {
         // Calculate lighting intensity at this point
         float lighting = calculateLighting(rayEnd, light);
         
         // Create color based on lighting intensity
-        sf::Color rayColor = sf::Color(
+        return sf::Color(
             static_cast<uint8_t>(255 * lighting * 0.5f), // Red component
             static_cast<uint8_t>(255 * lighting * 0.4f), // Green component
             0,                                           // Blue component
             static_cast<uint8_t>(50 + 150 * lighting)    // Alpha (transparency)
         );
-        
-        drawLightRays(window, light, rayEnd, rayColor);
-    }
+    });
 }
 
-void Renderer::drawRays(sf::RenderWindow& window, const Light& light, const Sphere& sphere) {
-    // Draw main ray from light to sphere center
-    drawLightRays(window, light, sphere.getPosition(), sf::Color(255, 255, 0, 150));
-    
-    // Draw multiple rays around the sphere to show the lighting effect
+void Renderer::addSphereRays(const Scene& scene, const Light& light, const Sphere& sphere) {
+    // The main ray to the sphere center, then rays to points around its outline
     const int numRays = 12;
     float angleStep = 2.0f * M_PI / numRays;
     
-    for (int i = 0; i < numRays; ++i) {
-        float angle = i * angleStep;
-        sf::Vector2f rayEnd = sphere.getPosition() + sf::Vector2f(
-            std::cos(angle) * sphere.getRadius(),
-            std::sin(angle) * sphere.getRadius()
-        );
+    const sf::Vector2f lightPos = light.getPosition();
+    debugRayBatch.resize(numRays + 1);
+    for (int i = 0; i <= numRays; ++i) {
+        sf::Vector2f target = sphere.getPosition();
+        if (i > 0) {
+            float angle = (i - 1) * angleStep;
+            target += sf::Vector2f(std::cos(angle) * sphere.getRadius(), std::sin(angle) * sphere.getRadius());
+        }
+        // Slightly past the target, so rays grazing the outline still end on it
+        debugRayBatch.set(i, lightPos, target - lightPos, Utils::calculateDistance(lightPos, target) + 1.0f);
+    }
+    debugRayBatch.normalizeDirections();
+    
+    addTracedRays(scene, 2.0f, [&](int index, const sf::Vector2f& rayEnd) {
+        if (index == 0) {
+            return sf::Color(255, 255, 0, 150);
+        }
         
         // Calculate lighting intensity for this ray
         float lighting = calculateLighting(rayEnd, light);
-        sf::Color rayColor = sf::Color(
+        return sf::Color(
             static_cast<uint8_t>(255 * lighting),
             static_cast<uint8_t>(255 * lighting * 0.5f),
             0,
             static_cast<uint8_t>(100 + 155 * lighting)
         );
-        
-        drawLightRays(window, light, rayEnd, rayColor);
-    }
-    
-    // Draw light radius indicator
-    drawLightRadius(window, light);
+    });
+}
+
+const DebugRays& Renderer::getDebugRays() const {
+    return debugRays;
 }
 
 void Renderer::drawLightRays(sf::RenderWindow& window, const Light& light, const sf::Vector2f& target, const sf::Color& color) {
-    // Calculate ray properties
-    float distance = Utils::calculateDistance(light.getPosition(), target);
-    float angle = std::atan2(target.y - light.getPosition().y, target.x - light.getPosition().x);
-    
-    // Create thick ray using RectangleShape
-    sf::RectangleShape ray;
-    ray.setSize(sf::Vector2f(distance, 2.0f)); // Thick ray (2 pixels wide)
-    ray.setFillColor(color);
-    ray.setRotation(angle * 180.0f / M_PI);
-    
-    // Position the ray at the light center
-    ray.setOrigin(0, 1.0f); // Center vertically
-    ray.setPosition(light.getPosition());
-    
-    window.draw(ray);
+    // A single thick ray (2 pixels wide) from the light center
+    sf::Vertex quad[4];
+    DebugRays::makeQuad(light.getPosition(), target, color, 2.0f, quad);
+    window.draw(quad, 4, sf::Quads);
 }
 
 void Renderer::drawLightRadius(sf::RenderWindow& window, const Light& light) {
@@ -314,6 +813,14 @@ RayDisplayMode Renderer::getRayDisplayMode() const {
     return rayDisplayMode;
 }
 
+void Renderer::setDebugRayCount(int count) {
+    debugRayCount = std::max(Utils::MIN_DEBUG_RAYS, std::min(Utils::MAX_DEBUG_RAYS, count));
+}
+
+int Renderer::getDebugRayCount() const {
+    return debugRayCount;
+}
+
 void Renderer::cycleRayDisplayMode() {
     switch (rayDisplayMode) {
         case RayDisplayMode::NONE:
@@ -351,4 +858,233 @@ void Renderer::toggleRealRayTracing() {
 
 bool Renderer::isRealRayTracing() const {
     return isRealRayTracingEnabled;
-} 
\ No newline at end of file
+}
+
+void Renderer::toggleParallelRendering() {
+    isParallelRenderingEnabled = !isParallelRenderingEnabled;
+}
+
+bool Renderer::isParallelRendering() const {
+    return isParallelRenderingEnabled;
+}
+
+void Renderer::setThreadCount(unsigned threadCount) {
+    threadPool.setThreadCount(threadCount);
+}
+
+unsigned Renderer::getThreadCount() const {
+    return threadPool.getThreadCount();
+}
+
+void Renderer::setResolution(unsigned width, unsigned height) {
+    frameBuffer.resize(width, height);
+}
+
+void Renderer::toggleAdaptiveSampling() {
+    setAdaptiveSampling(!isAdaptiveSamplingEnabled);
+}
+
+void Renderer::setAdaptiveSampling(bool enabled) {
+    isAdaptiveSamplingEnabled = enabled;
+    rayTracer.setAdaptiveSampling(enabled);
+}
+
+bool Renderer::isAdaptiveSampling() const {
+    return isAdaptiveSamplingEnabled;
+}
+
+void Renderer::setAdaptiveThreshold(int threshold) {
+    adaptiveThreshold = threshold;
+    rayTracer.setAdaptiveThreshold(threshold);
+}
+
+int Renderer::getAdaptiveThreshold() const {
+    return adaptiveThreshold;
+}
+
+void Renderer::toggleIncrementalRendering() {
+    isIncrementalRenderingEnabled = !isIncrementalRenderingEnabled;
+}
+
+void Renderer::setIncrementalRendering(bool enabled) {
+    isIncrementalRenderingEnabled = enabled;
+}
+
+bool Renderer::isIncrementalRendering() const {
+    return isIncrementalRenderingEnabled;
+}
+
+void Renderer::invalidateFrameCache() {
+    hasCachedFrame = false;
+}
+
+void Renderer::toggleProgressiveRendering() {
+    setProgressiveRendering(!isProgressiveRenderingEnabled);
+}
+
+void Renderer::setProgressiveRendering(bool enabled) {
+    isProgressiveRenderingEnabled = enabled;
+    // The framebuffer holds the other mode's image either way
+    invalidateFrameCache();
+}
+
+bool Renderer::isProgressiveRendering() const {
+    return isProgressiveRenderingEnabled;
+}
+
+void Renderer::toggleTemporalReprojection() {
+    setTemporalReprojection(!isTemporalReprojectionEnabled);
+}
+
+void Renderer::setTemporalReprojection(bool enabled) {
+    isTemporalReprojectionEnabled = enabled;
+    // Frames traced without it leave the cached samples stale
+    reprojection.invalidate();
+}
+
+bool Renderer::isTemporalReprojection() const {
+    return isTemporalReprojectionEnabled;
+}
+
+void Renderer::setReprojectionRefreshInterval(int frames) {
+    reprojection.setRefreshInterval(frames);
+}
+
+int Renderer::getReprojectionRefreshInterval() const {
+    return reprojection.getRefreshInterval();
+}
+
+void Renderer::setPixelStep(int step) {
+    pixelStep = step;
+}
+
+int Renderer::getPixelStep() const {
+    return pixelStep;
+}
+
+int Renderer::getSamplingStep() const {
+    return isRealRayTracingEnabled ? rayTracer.getPixelStep() : frameStep;
+}
+
+void Renderer::toggleFrameGovernor() {
+    setFrameGovernor(!isFrameGovernorEnabled);
+}
+
+void Renderer::setFrameGovernor(bool enabled) {
+    isFrameGovernorEnabled = enabled;
+    governor.reset();
+    // Upscaled and block-filled pixels would otherwise mix in the cached frame
+    invalidateFrameCache();
+}
+
+bool Renderer::isFrameGovernor() const {
+    return isFrameGovernorEnabled;
+}
+
+void Renderer::setFrameTargetMs(GovernedMode mode, float milliseconds) {
+    governor.setTargetMs(mode, milliseconds);
+}
+
+float Renderer::getFrameTargetMs(GovernedMode mode) const {
+    return governor.getTargetMs(mode);
+}
+
+const FrameGovernor& Renderer::getFrameGovernor() const {
+    return governor;
+}
+
+void Renderer::toggleCoverageAntiAliasing() {
+    setCoverageAntiAliasing(!isCoverageAntiAliasingEnabled);
+}
+
+void Renderer::setCoverageAntiAliasing(bool enabled) {
+    isCoverageAntiAliasingEnabled = enabled;
+    rayTracer.setCoverageAntiAliasing(enabled);
+    // The step may stay the same while the edges change
+    invalidateFrameCache();
+}
+
+bool Renderer::isCoverageAntiAliasing() const {
+    return isCoverageAntiAliasingEnabled;
+}
+
+RenderSettings Renderer::getSettings() const {
+    RenderSettings settings;
+    settings.is2DMode = is2DModeEnabled;
+    settings.isRealRayTracing = isRealRayTracingEnabled;
+    settings.isParallelRendering = isParallelRenderingEnabled;
+    settings.isIncrementalRendering = isIncrementalRenderingEnabled;
+    settings.isAdaptiveSampling = isAdaptiveSamplingEnabled;
+    settings.isProgressiveRendering = isProgressiveRenderingEnabled;
+    settings.isTemporalReprojection = isTemporalReprojectionEnabled;
+    settings.reprojectionRefreshInterval = reprojection.getRefreshInterval();
+    settings.adaptiveThreshold = adaptiveThreshold;
+    settings.pixelStep = pixelStep;
+    settings.isFrameGovernor = isFrameGovernorEnabled;
+    settings.isCoverageAntiAliasing = isCoverageAntiAliasingEnabled;
+    settings.frameTargetMs2D = governor.getTargetMs(GovernedMode::MODE_2D);
+    settings.frameTargetMsRayTracing = governor.getTargetMs(GovernedMode::RAY_TRACING);
+    return settings;
+}
+
+void Renderer::applySettings(const RenderSettings& settings) {
+    is2DModeEnabled = settings.is2DMode;
+    isRealRayTracingEnabled = settings.isRealRayTracing;
+    isParallelRenderingEnabled = settings.isParallelRendering;
+    isIncrementalRenderingEnabled = settings.isIncrementalRendering;
+    pixelStep = settings.pixelStep;
+    if (settings.isAdaptiveSampling != isAdaptiveSamplingEnabled) {
+        setAdaptiveSampling(settings.isAdaptiveSampling);
+    }
+    if (settings.adaptiveThreshold != adaptiveThreshold) {
+        setAdaptiveThreshold(settings.adaptiveThreshold);
+    }
+    if (settings.isProgressiveRendering != isProgressiveRenderingEnabled) {
+        setProgressiveRendering(settings.isProgressiveRendering);
+    }
+    if (settings.isTemporalReprojection != isTemporalReprojectionEnabled) {
+        setTemporalReprojection(settings.isTemporalReprojection);
+    }
+    reprojection.setRefreshInterval(settings.reprojectionRefreshInterval);
+    if (settings.isFrameGovernor != isFrameGovernorEnabled) {
+        setFrameGovernor(settings.isFrameGovernor);
+    }
+    if (settings.isCoverageAntiAliasing != isCoverageAntiAliasingEnabled) {
+        setCoverageAntiAliasing(settings.isCoverageAntiAliasing);
+    }
+    governor.setTargetMs(GovernedMode::MODE_2D, settings.frameTargetMs2D);
+    governor.setTargetMs(GovernedMode::RAY_TRACING, settings.frameTargetMsRayTracing);
+}
+
+bool RenderSettings::operator==(const RenderSettings& other) const {
+    return is2DMode == other.is2DMode
+        && isRealRayTracing == other.isRealRayTracing
+        && isParallelRendering == other.isParallelRendering
+        && isIncrementalRendering == other.isIncrementalRendering
+        && isAdaptiveSampling == other.isAdaptiveSampling
+        && isProgressiveRendering == other.isProgressiveRendering
+        && isTemporalReprojection == other.isTemporalReprojection
+        && reprojectionRefreshInterval == other.reprojectionRefreshInterval
+        && adaptiveThreshold == other.adaptiveThreshold
+        && pixelStep == other.pixelStep
+        && isFrameGovernor == other.isFrameGovernor
+        && isCoverageAntiAliasing == other.isCoverageAntiAliasing
+        && frameTargetMs2D == other.frameTargetMs2D
+        && frameTargetMsRayTracing == other.frameTargetMsRayTracing;
+}
+
+const FrameBuffer& Renderer::getFrameBuffer() const {
+    return frameBuffer;
+}
+
+FrameBuffer& Renderer::getFrameBuffer() {
+    return frameBuffer;
+}
+
+RayTracer& Renderer::getRayTracer() {
+    return rayTracer;
+}
+
+ThreadPool& Renderer::getThreadPool() {
+    return threadPool;
+}
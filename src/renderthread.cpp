@@ -0,0 +1,135 @@
+#include "../include/renderthread.hpp"
+#include "../include/profiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+RenderThread::RenderThread(unsigned width, unsigned height)
+    : workingSettings(renderer.getSettings())
+    , writeSlot(0)
+    , isRefining(false)
+    , displaySlot(1)
+    , hasDisplayFrame(false)
+    , hasSubmitted(false)
+    , submittedRevision(0)
+    , submittedSettings(workingSettings)
+    , slots(3, FrameBuffer(width, height))
+    , pendingSettings(workingSettings)
+    , readySlot(2)
+    , hasPendingScene(false)
+    , hasReadyFrame(false)
+    , stopping(false)
+    , completedFrames(0) {
+    renderer.setResolution(width, height);
+    for (int i = 0; i < 3; ++i) {
+        dirtyTop[i] = 0;
+        dirtyBottom[i] = static_cast<int>(height);
+    }
+    thread = std::thread(&RenderThread::run, this);
+}
+
+RenderThread::~RenderThread() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_one();
+    thread.join();
+}
+
+void RenderThread::submit(const Scene& scene, const RenderSettings& settings) {
+    PROFILE_ZONE("RenderThread::submit");
+    if (hasSubmitted && scene.getRevision() == submittedRevision && settings == submittedSettings) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Assigning over the previous snapshot reuses its storage
+        pendingScene = scene;
+        pendingSettings = settings;
+        hasPendingScene = true;
+    }
+    wakeCondition.notify_one();
+    hasSubmitted = true;
+    submittedRevision = scene.getRevision();
+    submittedSettings = settings;
+}
+
+bool RenderThread::present(sf::RenderWindow& window) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (hasReadyFrame) {
+            std::swap(displaySlot, readySlot);
+            hasReadyFrame = false;
+            hasDisplayFrame = true;
+        }
+    }
+    if (!hasDisplayFrame) {
+        return false;
+    }
+    // Each buffer keeps its own texture, which is only ever touched here
+    slots[displaySlot].present(window);
+    return true;
+}
+
+uint64_t RenderThread::getCompletedFrameCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return completedFrames;
+}
+
+void RenderThread::run() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            // A still scene is traced again only while progressive passes can refine it
+            wakeCondition.wait(lock, [&] {
+                return stopping || hasPendingScene || isRefining;
+            });
+            if (stopping) {
+                return;
+            }
+            if (hasPendingScene) {
+                std::swap(workingScene, pendingScene);
+                workingSettings = pendingSettings;
+                hasPendingScene = false;
+            }
+        }
+        
+        PROFILE_ZONE("RenderThread::frame");
+        renderer.applySettings(workingSettings);
+        renderer.traceFrame(workingScene);
+        // Progressive passes stop changing pixels once every tile has converged
+        isRefining = publishFrame() && workingSettings.isProgressiveRendering;
+    }
+}
+
+bool RenderThread::publishFrame() {
+    // The renderer traces incrementally into one persistent framebuffer; each handoff
+    // buffer catches up on the rows changed since it was last written
+    FrameBuffer& traced = renderer.getFrameBuffer();
+    int top, bottom;
+    const bool changed = traced.takeDirtyRows(top, bottom);
+    if (changed) {
+        for (int i = 0; i < 3; ++i) {
+            dirtyTop[i] = std::min(dirtyTop[i], top);
+            dirtyBottom[i] = std::max(dirtyBottom[i], bottom);
+        }
+    }
+    
+    FrameBuffer& target = slots[writeSlot];
+    if (dirtyTop[writeSlot] < dirtyBottom[writeSlot]) {
+        const size_t rowBytes = static_cast<size_t>(traced.getWidth()) * 4;
+        std::memcpy(target.getPixels() + dirtyTop[writeSlot] * rowBytes,
+                    traced.getPixels() + dirtyTop[writeSlot] * rowBytes,
+                    static_cast<size_t>(dirtyBottom[writeSlot] - dirtyTop[writeSlot]) * rowBytes);
+        target.markDirty(dirtyTop[writeSlot], dirtyBottom[writeSlot]);
+        dirtyTop[writeSlot] = static_cast<int>(traced.getHeight());
+        dirtyBottom[writeSlot] = 0;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    std::swap(writeSlot, readySlot);
+    hasReadyFrame = true;
+    ++completedFrames;
+    return changed;
+}
@@ -0,0 +1,298 @@
+#include "../include/reprojectioncache.hpp"
+#include "../include/scene.hpp"
+#include "../include/dirtyregion.hpp"
+#include "../include/utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    // Slack on the facing tests, as a sine, for the rounding in the visibility computation
+    constexpr float FACING_MARGIN = 1e-3f;
+    
+    float lengthSquared(const sf::Vector2f& v) {
+        return v.x * v.x + v.y * v.y;
+    }
+    
+    // Everything but the position, which is compared separately for the sphere that may move
+    bool hasSameSurface(const Sphere& a, const Sphere& b) {
+        return a.getRadius() == b.getRadius()
+            && a.getMaterial() == b.getMaterial()
+            && a.getSurface() == b.getSurface();
+    }
+}
+
+ReprojectionCache::ReprojectionCache()
+    : refreshInterval(DEFAULT_REFRESH_INTERVAL)
+    , hasFrame(false)
+    , canReuse(false)
+    , width(0)
+    , height(0)
+    , pixelStep(1)
+    , columns(0)
+    , rows(0)
+    , lightCount(0)
+    , cameraPosition(0.0f, 0.0f)
+    , shadingKey(0)
+    , cachedScene(nullptr)
+    , cachedRevision(0)
+    , sphereMotion(0.0f, 0.0f) {
+}
+
+void ReprojectionCache::setRefreshInterval(int frames) {
+    refreshInterval = std::max(1, std::min(frames, MAX_REFRESH_INTERVAL));
+}
+
+int ReprojectionCache::getRefreshInterval() const {
+    return refreshInterval;
+}
+
+void ReprojectionCache::invalidate() {
+    hasFrame = false;
+}
+
+bool ReprojectionCache::beginFrame(const Scene& scene, unsigned frameWidth, unsigned frameHeight, int step,
+                                   const sf::Vector2f& camera, uint32_t key) {
+    const bool gridChanged = frameWidth != width || frameHeight != height || step != pixelStep;
+    if (gridChanged) {
+        width = frameWidth;
+        height = frameHeight;
+        pixelStep = step;
+        columns = (static_cast<int>(width) + pixelStep - 1) / pixelStep;
+        rows = (static_cast<int>(height) + pixelStep - 1) / pixelStep;
+        samples.resize(static_cast<size_t>(columns) * rows);
+        previousSamples.resize(samples.size());
+    }
+    // A different light count is a structural change, so nothing is reused across it
+    lightCount = scene.getLights().size();
+    visibilities.resize(samples.size() * lightCount);
+    previousVisibilities.resize(visibilities.size());
+    
+    const bool sceneMoved = scene.getRevision() != cachedRevision;
+    canReuse = hasFrame && !gridChanged && key == shadingKey && camera == cameraPosition
+        && &scene == cachedScene && !hasStructuralChange(scene);
+    // Reused colours drift while the scene moves, and a scene at rest is traced exactly again
+    const size_t movingFrames = motionSteps.empty() ? 0 : motionSteps.size() - 1;
+    if (canReuse && (sceneMoved ? movingFrames >= static_cast<size_t>(refreshInterval) : movingFrames > 0)) {
+        canReuse = false;
+    }
+    
+    if (canReuse) {
+        sphereMotion = sf::Vector2f(0.0f, 0.0f);
+        if (sceneMoved) {
+            sphereMotion = scene.getSphere().getPosition() - cachedSpheres[0].getPosition();
+            recordMotion(scene);
+        }
+        // Same sizes, so the copies reuse the storage
+        previousSamples = samples;
+        previousVisibilities = visibilities;
+    } else {
+        sphereMotion = sf::Vector2f(0.0f, 0.0f);
+        motionSteps.clear();
+        motionPositions.clear();
+        recordMotion(scene);
+    }
+    
+    if (sceneMoved || !canReuse) {
+        cachedSpheres = scene.getSpheres();
+        cachedLights = scene.getLights();
+    }
+    cachedScene = &scene;
+    cachedRevision = scene.getRevision();
+    cameraPosition = camera;
+    shadingKey = key;
+    hasFrame = true;
+    return canReuse;
+}
+
+bool ReprojectionCache::hasStructuralChange(const Scene& scene) const {
+    const std::vector<Sphere>& spheres = scene.getSpheres();
+    if (spheres.empty() || spheres.size() != cachedSpheres.size() || scene.getLights().size() != cachedLights.size()) {
+        return true;
+    }
+    if (scene.getRevision() == cachedRevision) {
+        return false;
+    }
+    // Only the first sphere and the lights may move; light colours do not affect shading
+    for (size_t i = 0; i < spheres.size(); ++i) {
+        if (!hasSameSurface(spheres[i], cachedSpheres[i])
+            || (i > 0 && spheres[i].getPosition() != cachedSpheres[i].getPosition())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ReprojectionCache::recordMotion(const Scene& scene) {
+    const std::vector<Sphere>& spheres = scene.getSpheres();
+    const std::vector<Light>& lights = scene.getLights();
+    const Sphere& sphere = spheres[0];
+    
+    MotionState state;
+    state.first = motionPositions.size();
+    state.sphereExposed = true;
+    state.occluderGap = std::numeric_limits<float>::max();
+    for (size_t i = 1; i < spheres.size(); ++i) {
+        const float centerDistance = std::sqrt(lengthSquared(spheres[i].getPosition() - sphere.getPosition()));
+        state.occluderGap = std::min(state.occluderGap, centerDistance - spheres[i].getRadius() - sphere.getRadius());
+    }
+    motionPositions.push_back(sphere.getPosition());
+    for (const Light& light : lights) {
+        motionPositions.push_back(light.getPosition());
+        for (size_t i = 1; i < spheres.size() && state.sphereExposed; ++i) {
+            state.sphereExposed = !DirtyRegion::canShadow(light.getPosition(), Utils::LIGHT_RADIUS,
+                                                          spheres[i].getPosition(), spheres[i].getRadius(),
+                                                          sphere.getPosition(), sphere.getRadius());
+        }
+    }
+    motionSteps.push_back(state);
+}
+
+const ReprojectionCache::Sample* ReprojectionCache::findReusable(const RayHit& hit, int sampleX, int sampleY,
+                                                                 const Scene& scene) const {
+    if (!canReuse) {
+        return nullptr;
+    }
+    
+    const Sphere& sphere = scene.getSpheres()[hit.objectIndex];
+    const sf::Vector2f offset = hit.point - sphere.getPosition();
+    const sf::Vector2f samplePosition = sf::Vector2f(static_cast<float>(sampleX * pixelStep),
+                                                     static_cast<float>(sampleY * pixelStep)) - cameraPosition;
+    const float sampleDistance = std::sqrt(lengthSquared(samplePosition));
+    
+    // Every pixel on a camera ray shows its first hit, so the sample that saw the point before
+    // the sphere moved is taken at the same distance along that point's ray
+    int previousX = sampleX;
+    int previousY = sampleY;
+    if (hit.objectIndex == 0 && lengthSquared(sphereMotion) > 0.0f) {
+        const sf::Vector2f previousPoint = hit.point - sphereMotion - cameraPosition;
+        const float pointDistance = std::sqrt(lengthSquared(previousPoint));
+        if (pointDistance <= 0.0f) {
+            return nullptr;
+        }
+        const sf::Vector2f previousPosition = cameraPosition + previousPoint * (sampleDistance / pointDistance);
+        previousX = static_cast<int>(std::lround(previousPosition.x / pixelStep));
+        previousY = static_cast<int>(std::lround(previousPosition.y / pixelStep));
+        if (previousX < 0 || previousY < 0 || previousX >= columns || previousY >= rows) {
+            return nullptr;
+        }
+    }
+    
+    // A different object means the point was hidden (disoccluded); a distant point on the
+    // same one means the surface turned away between the two samples
+    const Sample& previous = previousSamples[static_cast<size_t>(previousY) * columns + previousX];
+    if (previous.object != hit.objectIndex) {
+        return nullptr;
+    }
+    // Neighbouring samples see points further apart the further the hit is beyond them
+    const float spacing = pixelStep * std::max(1.0f, std::sqrt(lengthSquared(hit.point - cameraPosition))
+                                                     / std::max(sampleDistance, 1.0f));
+    if (lengthSquared(previous.hitOffset - offset) > spacing * spacing) {
+        return nullptr;
+    }
+    
+    if (isEdge(previous, previousX, previousY) || !isLightingValid(hit, previous, scene)) {
+        return nullptr;
+    }
+    return &previous;
+}
+
+const float* ReprojectionCache::getPreviousVisibilities(const Sample& previous) const {
+    return previousVisibilities.data() + static_cast<size_t>(&previous - previousSamples.data()) * lightCount;
+}
+
+bool ReprojectionCache::isEdge(const Sample& sample, int sampleX, int sampleY) const {
+    // The state changes across silhouettes and shadow boundaries, where a moved sample
+    // could land on the other side
+    const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    for (const int* offset : offsets) {
+        const int x = sampleX + offset[0];
+        const int y = sampleY + offset[1];
+        if (x >= 0 && y >= 0 && x < columns && y < rows
+            && previousSamples[static_cast<size_t>(y) * columns + x].state != sample.state) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ReprojectionCache::isLightingValid(const RayHit& hit, const Sample& previous, const Scene& scene) const {
+    const MotionState& traced = motionSteps[previous.tracedStep];
+    const MotionState& current = motionSteps.back();
+    // Other spheres keep still relative to each other but not to the first one
+    const bool onMovingSphere = hit.objectIndex == 0;
+    const sf::Vector2f tracedSphere = motionPositions[traced.first];
+    const sf::Vector2f currentSphere = motionPositions[current.first];
+    const sf::Vector2f surfaceMotion = onMovingSphere ? currentSphere - tracedSphere : sf::Vector2f(0.0f, 0.0f);
+    const float movingRadius = scene.getSphere().getRadius();
+    // Since the visibilities were computed, a still point sees the moving sphere's silhouette
+    // turn by at most sphereTurn radians, and a point on it sees the other spheres turn as far
+    const float sphereDrift = std::sqrt(lengthSquared(currentSphere - tracedSphere));
+    float sphereTurn = 0.0f;
+    if (!onMovingSphere) {
+        const float gap = std::sqrt(lengthSquared(currentSphere - hit.point)) - movingRadius;
+        sphereTurn = sphereDrift / std::max(gap, 1e-3f);
+    } else if (!(traced.sphereExposed && current.sphereExposed)) {
+        sphereTurn = sphereDrift / std::max(std::min(traced.occluderGap, current.occluderGap), 1e-3f);
+    }
+    
+    // Shadow rays leave SHADOW_BIAS off the surface, from where the hit sphere itself
+    // covers every direction more than asin(selfMargin) below the tangent
+    const float hitRadius = scene.getSpheres()[hit.objectIndex].getRadius();
+    const float hitRatio = hitRadius / (hitRadius + Utils::SHADOW_BIAS);
+    const float selfMargin = std::sqrt(1.0f - hitRatio * hitRatio) + FACING_MARGIN;
+    
+    const float* visibility = getPreviousVisibilities(previous);
+    for (size_t i = 0; i < lightCount; ++i) {
+        const sf::Vector2f tracedLight = motionPositions[traced.first + 1 + i];
+        const sf::Vector2f currentLight = motionPositions[current.first + 1 + i];
+        const sf::Vector2f toLight = currentLight - hit.point;
+        const float distance = std::sqrt(lengthSquared(toLight));
+        const float facing = (hit.normal.x * toLight.x + hit.normal.y * toLight.y) / std::max(distance, 1e-6f);
+        
+        // Facing away from the light: the sphere itself still covers part of it, and the
+        // diffuse term is zero whatever the rest of the visibility is
+        if (visibility[i] == 0.0f && facing <= -selfMargin) {
+            continue;
+        }
+        // On the moving sphere, out of reach of every other sphere's shadow, only the sphere
+        // itself could block the light, and the whole disk is above its tangent
+        if (visibility[i] == 1.0f && onMovingSphere && current.sphereExposed
+            && facing * distance >= Utils::LIGHT_RADIUS + FACING_MARGIN * distance) {
+            continue;
+        }
+        if (&traced == &current) {
+            continue;
+        }
+        
+        // Otherwise the visibility is only kept for small movements of the light as seen from
+        // the point, or none at all for a partly visible light, inside a penumbra where any
+        // movement changes the visibility
+        const bool inPenumbra = visibility[i] > 0.0f && visibility[i] < 1.0f;
+        const float maxTurn = inPenumbra ? 0.0f : MAX_LIGHT_DRIFT;
+        const float lightDrift = std::sqrt(lengthSquared(currentLight - tracedLight - surfaceMotion));
+        const float lightTurn = lightDrift / std::max(distance, 1e-6f);
+        if (lightTurn > maxTurn) {
+            return false;
+        }
+        // The occluders must have turned as little in total, or for a still point, the
+        // moving sphere must not shadow it from the light, then or now
+        if (lightTurn + sphereTurn > maxTurn
+            && (onMovingSphere
+                || DirtyRegion::canShadow(tracedLight, Utils::LIGHT_RADIUS, tracedSphere, movingRadius,
+                                          hit.point, Utils::SHADOW_BIAS)
+                || DirtyRegion::canShadow(currentLight, Utils::LIGHT_RADIUS, currentSphere, movingRadius,
+                                          hit.point, Utils::SHADOW_BIAS))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int ReprojectionCache::getPixelStep() const {
+    return pixelStep;
+}
+
+int ReprojectionCache::getCurrentStep() const {
+    return static_cast<int>(motionSteps.size()) - 1;
+}
@@ -1,47 +1,177 @@
 #include "../include/scene.hpp"
+#include <utility>
 
 Scene::Scene() 
-    : sphere(sf::Vector2f(0.f, 0.f), Utils::SPHERE_RADIUS)
-    , light(sf::Vector2f(400.f, 300.f), Utils::LIGHT_COLOR)
+    : accelerationStructure(AccelerationStructure::BVH)
+    , threadPool(nullptr)
     , moveSpeed(Utils::DEFAULT_MOVE_SPEED)
     , smoothness(Utils::DEFAULT_SMOOTHNESS)
-    , targetPosition(0.f, 0.f) {
+    , targetPosition(0.f, 0.f)
+    , revision(0) {
+    spheres.emplace_back(sf::Vector2f(0.f, 0.f), Utils::SPHERE_RADIUS);
+    lights.emplace_back(sf::Vector2f(400.f, 300.f), Utils::LIGHT_COLOR);
+    rebuildAccelerationStructure();
 }
 
 void Scene::update(float deltaTime) {
-    sf::Vector2f currentPos = sphere.getPosition();
+    Sphere& sphere = spheres.front();
+    sf::Vector2f previousPos = sphere.getPosition();
+    sf::Vector2f currentPos = previousPos;
     currentPos += (targetPosition - currentPos) * smoothness;
+    
+    // The smoothing settles exactly once the step rounds to zero
+    if (currentPos == previousPos) {
+        return;
+    }
     sphere.setPosition(currentPos);
+    
+    // Only the interactive sphere moved, so the BVH is refitted around it
+    updateAccelerationStructure(0);
+    ++revision;
 }
 
 void Scene::render(sf::RenderWindow& window) {
     window.clear(Utils::BACKGROUND_COLOR);
     
-    sphere.draw(window, light.getPosition());
+    for (Sphere& sphere : spheres) {
+        sphere.draw(window, getLight().getPosition());
+    }
     
-    sf::CircleShape lightShape(Utils::LIGHT_RADIUS);
-    lightShape.setFillColor(light.getColor());
-    lightShape.setPosition(light.getPosition());
-    window.draw(lightShape);
+    for (const Light& light : lights) {
+        sf::CircleShape lightShape(Utils::LIGHT_RADIUS);
+        lightShape.setFillColor(light.getColor());
+        lightShape.setPosition(light.getPosition());
+        window.draw(lightShape);
+    }
 }
 
 void Scene::handleInput(const sf::Vector2i& mousePos, bool leftPressed, bool rightPressed, 
                        bool upPressed, bool downPressed) {
     targetPosition = sf::Vector2f(mousePos.x, mousePos.y);
     
+    Light& light = lights.front();
     sf::Vector2f lightPos = light.getPosition();
     if (leftPressed) lightPos.x -= moveSpeed;
     if (rightPressed) lightPos.x += moveSpeed;
     if (upPressed) lightPos.y -= moveSpeed;
     if (downPressed) lightPos.y += moveSpeed;
     
-    light.setPosition(lightPos);
+    if (lightPos != light.getPosition()) {
+        light.setPosition(lightPos);
+        ++revision;
+    }
+}
+
+void Scene::addSphere(const Sphere& sphere) {
+    spheres.push_back(sphere);
+    rebuildAccelerationStructure();
+    ++revision;
+}
+
+void Scene::addSpheres(const std::vector<Sphere>& newSpheres) {
+    spheres.insert(spheres.end(), newSpheres.begin(), newSpheres.end());
+    rebuildAccelerationStructure();
+    ++revision;
+}
+
+void Scene::addLight(const Light& light) {
+    lights.push_back(light);
+    ++revision;
+}
+
+void Scene::setContents(std::vector<Sphere> newSpheres, std::vector<Light> newLights, const BVH* prebuiltBVH) {
+    spheres = std::move(newSpheres);
+    lights = std::move(newLights);
+    if (prebuiltBVH && accelerationStructure == AccelerationStructure::BVH) {
+        bvh = *prebuiltBVH;
+    } else {
+        rebuildAccelerationStructure();
+    }
+    ++revision;
+}
+
+void Scene::setSpherePosition(const sf::Vector2f& position) {
+    // Also retarget the smoothing so update() keeps the sphere in place
+    spheres.front().setPosition(position);
+    targetPosition = position;
+    updateAccelerationStructure(0);
+    ++revision;
+}
+
+void Scene::setLightPosition(const sf::Vector2f& position) {
+    lights.front().setPosition(position);
+    ++revision;
+}
+
+void Scene::setSphereSurface(SurfaceType surface) {
+    spheres.front().setSurface(surface);
+    ++revision;
+}
+
+void Scene::setSpherePositions(const std::vector<sf::Vector2f>& positions) {
+    for (size_t i = 0; i < spheres.size() && i < positions.size(); ++i) {
+        spheres[i].setPosition(positions[i]);
+    }
+    targetPosition = spheres.front().getPosition();
+    rebuildAccelerationStructure();
+    ++revision;
+}
+
+void Scene::setAccelerationStructure(AccelerationStructure structure) {
+    if (structure == accelerationStructure) {
+        return;
+    }
+    accelerationStructure = structure;
+    rebuildAccelerationStructure();
+}
+
+AccelerationStructure Scene::getAccelerationStructure() const {
+    return accelerationStructure;
+}
+
+void Scene::setThreadPool(ThreadPool* pool) {
+    threadPool = pool;
 }
 
 const Sphere& Scene::getSphere() const {
-    return sphere;
+    return spheres.front();
 }
 
 const Light& Scene::getLight() const {
-    return light;
-} 
\ No newline at end of file
+    return lights.front();
+}
+
+const std::vector<Sphere>& Scene::getSpheres() const {
+    return spheres;
+}
+
+const std::vector<Light>& Scene::getLights() const {
+    return lights;
+}
+
+const BVH& Scene::getBVH() const {
+    return bvh;
+}
+
+const UniformGrid& Scene::getGrid() const {
+    return grid;
+}
+
+uint64_t Scene::getRevision() const {
+    return revision;
+}
+
+void Scene::rebuildAccelerationStructure() {
+    if (accelerationStructure == AccelerationStructure::GRID) {
+        grid.build(spheres, threadPool);
+    } else {
+        bvh.build(spheres);
+    }
+}
+
+void Scene::updateAccelerationStructure(int sphereIndex) {
+    if (accelerationStructure == AccelerationStructure::BVH && bvh.refit(sphereIndex, spheres)) {
+        return;
+    }
+    rebuildAccelerationStructure();
+}
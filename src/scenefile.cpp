@@ -0,0 +1,359 @@
+#include "../include/scenefile.hpp"
+#include "../include/mappedfile.hpp"
+#include "../include/profiler.hpp"
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+
+namespace {
+    constexpr char MAGIC[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0' };
+    constexpr uint64_t SECTION_ALIGNMENT = 64;
+    constexpr uint32_t FLAG_BVH = 1;
+    // Sphere indices are ints throughout the tracer
+    constexpr uint64_t MAX_SPHERES = 0x7FFFFFFF - SphereSoA::LANES;
+    
+    enum Section {
+        CENTER_X,
+        CENTER_Y,
+        RADIUS,
+        MATERIALS,
+        LIGHTS,
+        BVH_NODES,
+        BVH_PRIMITIVES,
+        BVH_CENTER_X,
+        BVH_CENTER_Y,
+        BVH_RADIUS_SQUARED,
+        SECTION_COUNT
+    };
+    
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint32_t sphereCount;
+        uint32_t lightCount;
+        uint32_t bvhNodeCount;
+        uint32_t reserved;
+        uint64_t sectionOffset[SECTION_COUNT]; // Bytes from the start of the file
+        uint64_t sectionSize[SECTION_COUNT]; // Bytes, 0 for absent sections
+    };
+    
+    struct MaterialRecord {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t surface;
+    };
+    
+    struct LightRecord {
+        float x;
+        float y;
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t a;
+    };
+    
+    // The sections are the in-memory arrays byte for byte
+    static_assert(sizeof(Header) == 192, "header layout is part of the format");
+    static_assert(sizeof(MaterialRecord) == 4 && sizeof(LightRecord) == 12, "record layout is part of the format");
+    static_assert(sizeof(BVHNode) == 24 && std::is_trivially_copyable<BVHNode>::value, "BVH nodes are stored as-is");
+    
+    // Appends a section at the next aligned offset and records where it went
+    void writeSection(std::ofstream& file, Header& header, Section section, const void* data, uint64_t bytes) {
+        static const char padding[SECTION_ALIGNMENT] = {};
+        const uint64_t position = static_cast<uint64_t>(file.tellp());
+        const uint64_t aligned = (position + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        file.write(padding, static_cast<std::streamsize>(aligned - position));
+        file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+        header.sectionOffset[section] = aligned;
+        header.sectionSize[section] = bytes;
+    }
+    
+    // Pointer to a section of exactly count elements, or null if the header places it
+    // outside the file, misaligned or with another size
+    template <typename T>
+    const T* getSection(const MappedFile& file, const Header& header, Section section, uint64_t count) {
+        const uint64_t offset = header.sectionOffset[section];
+        const uint64_t size = header.sectionSize[section];
+        if (size != count * sizeof(T) || offset % SECTION_ALIGNMENT != 0
+            || offset > file.getSize() || size > file.getSize() - offset) {
+            return nullptr;
+        }
+        return reinterpret_cast<const T*>(file.getData() + offset);
+    }
+    
+    bool parseSurface(const std::string& name, SurfaceType& surface) {
+        if (name == "diffuse") {
+            surface = SurfaceType::DIFFUSE;
+        } else if (name == "mirror") {
+            surface = SurfaceType::MIRROR;
+        } else if (name == "glass") {
+            surface = SurfaceType::GLASS;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    
+    // Reads an optional "R G B" triple; false only for a partial or out-of-range one
+    bool parseColor(std::istringstream& line, sf::Color& color) {
+        int channels[3];
+        if (!(line >> channels[0])) {
+            return true;
+        }
+        if (!(line >> channels[1] >> channels[2])) {
+            return false;
+        }
+        for (int channel : channels) {
+            if (channel < 0 || channel > 255) {
+                return false;
+            }
+        }
+        color = sf::Color(static_cast<sf::Uint8>(channels[0]), static_cast<sf::Uint8>(channels[1]),
+                          static_cast<sf::Uint8>(channels[2]));
+        return true;
+    }
+}
+
+namespace SceneFile {
+    bool save(const std::string& path, const Scene& scene, bool includeBVH, std::string& error) {
+        PROFILE_ZONE("SceneFile::save");
+        const std::vector<Sphere>& spheres = scene.getSpheres();
+        const std::vector<Light>& lights = scene.getLights();
+        if (spheres.size() > MAX_SPHERES) {
+            error = "too many spheres for a scene file";
+            return false;
+        }
+        const size_t sphereCount = spheres.size();
+        
+        std::vector<float> centerX(sphereCount);
+        std::vector<float> centerY(sphereCount);
+        std::vector<float> radius(sphereCount);
+        std::vector<MaterialRecord> materials(sphereCount);
+        for (size_t i = 0; i < sphereCount; ++i) {
+            const Sphere& sphere = spheres[i];
+            const sf::Color material = sphere.getMaterial();
+            centerX[i] = sphere.getPosition().x;
+            centerY[i] = sphere.getPosition().y;
+            radius[i] = sphere.getRadius();
+            materials[i] = { material.r, material.g, material.b, static_cast<uint8_t>(sphere.getSurface()) };
+        }
+        std::vector<LightRecord> lightRecords(lights.size());
+        for (size_t i = 0; i < lights.size(); ++i) {
+            const sf::Color color = lights[i].getColor();
+            lightRecords[i] = { lights[i].getPosition().x, lights[i].getPosition().y, color.r, color.g, color.b, color.a };
+        }
+        
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            error = "cannot write " + path;
+            return false;
+        }
+        Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.sphereCount = static_cast<uint32_t>(sphereCount);
+        header.lightCount = static_cast<uint32_t>(lights.size());
+        // Written again with the section table once every section is placed
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        
+        writeSection(file, header, CENTER_X, centerX.data(), sphereCount * sizeof(float));
+        writeSection(file, header, CENTER_Y, centerY.data(), sphereCount * sizeof(float));
+        writeSection(file, header, RADIUS, radius.data(), sphereCount * sizeof(float));
+        writeSection(file, header, MATERIALS, materials.data(), sphereCount * sizeof(MaterialRecord));
+        writeSection(file, header, LIGHTS, lightRecords.data(), lightRecords.size() * sizeof(LightRecord));
+        
+        if (includeBVH) {
+            // Only the selected structure is kept up to date in the scene
+            BVH built;
+            const BVH* bvh = &scene.getBVH();
+            if (scene.getAccelerationStructure() != AccelerationStructure::BVH) {
+                built.build(spheres);
+                bvh = &built;
+            }
+            const SphereSoA& sphereData = bvh->getSphereData();
+            const uint64_t paddedBytes = (sphereCount + SphereSoA::LANES) * sizeof(float);
+            header.flags |= FLAG_BVH;
+            header.bvhNodeCount = static_cast<uint32_t>(bvh->getNodeCount());
+            writeSection(file, header, BVH_NODES, bvh->getNodes(), header.bvhNodeCount * sizeof(BVHNode));
+            writeSection(file, header, BVH_PRIMITIVES, bvh->getPrimitiveIndices(), sphereCount * sizeof(int));
+            writeSection(file, header, BVH_CENTER_X, sphereData.getCenterX(), paddedBytes);
+            writeSection(file, header, BVH_CENTER_Y, sphereData.getCenterY(), paddedBytes);
+            writeSection(file, header, BVH_RADIUS_SQUARED, sphereData.getRadiusSquared(), paddedBytes);
+        }
+        
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!file) {
+            error = "failed writing " + path;
+            return false;
+        }
+        return true;
+    }
+    
+    bool load(const std::string& path, Scene& scene, std::string& error) {
+        PROFILE_ZONE("SceneFile::load");
+        std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+        if (!file->open(path, error)) {
+            return false;
+        }
+        
+        Header header;
+        if (file->getSize() < sizeof(header)) {
+            error = path + " is not a scene file";
+            return false;
+        }
+        std::memcpy(&header, file->getData(), sizeof(header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+            error = path + " is not a scene file";
+            return false;
+        }
+        if (header.version != VERSION) {
+            error = "unsupported scene file version " + std::to_string(header.version);
+            return false;
+        }
+        if (header.sphereCount == 0 || header.sphereCount > MAX_SPHERES || header.lightCount == 0) {
+            error = "scene files need at least one sphere and one light";
+            return false;
+        }
+        
+        const uint64_t sphereCount = header.sphereCount;
+        const float* centerX = getSection<float>(*file, header, CENTER_X, sphereCount);
+        const float* centerY = getSection<float>(*file, header, CENTER_Y, sphereCount);
+        const float* radius = getSection<float>(*file, header, RADIUS, sphereCount);
+        const MaterialRecord* materials = getSection<MaterialRecord>(*file, header, MATERIALS, sphereCount);
+        const LightRecord* lightRecords = getSection<LightRecord>(*file, header, LIGHTS, header.lightCount);
+        if (!centerX || !centerY || !radius || !materials || !lightRecords) {
+            error = path + " is truncated or corrupt";
+            return false;
+        }
+        
+        // Shading reads spheres and lights as objects, so these records are copied once
+        std::vector<Sphere> spheres;
+        spheres.reserve(sphereCount);
+        for (uint64_t i = 0; i < sphereCount; ++i) {
+            const MaterialRecord& material = materials[i];
+            if (material.surface > static_cast<uint8_t>(SurfaceType::GLASS)) {
+                error = path + " has an unknown surface type";
+                return false;
+            }
+            spheres.emplace_back(sf::Vector2f(centerX[i], centerY[i]), radius[i]);
+            spheres.back().setMaterial(sf::Color(material.r, material.g, material.b));
+            if (material.surface != static_cast<uint8_t>(SurfaceType::DIFFUSE)) {
+                spheres.back().setSurface(static_cast<SurfaceType>(material.surface));
+            }
+        }
+        std::vector<Light> lights;
+        lights.reserve(header.lightCount);
+        for (uint32_t i = 0; i < header.lightCount; ++i) {
+            const LightRecord& light = lightRecords[i];
+            lights.emplace_back(sf::Vector2f(light.x, light.y), sf::Color(light.r, light.g, light.b, light.a));
+        }
+        
+        if (!(header.flags & FLAG_BVH)) {
+            scene.setContents(std::move(spheres), std::move(lights));
+            return true;
+        }
+        
+        const uint64_t paddedCount = sphereCount + SphereSoA::LANES;
+        const BVHNode* nodes = getSection<BVHNode>(*file, header, BVH_NODES, header.bvhNodeCount);
+        const int* primitiveIndices = getSection<int>(*file, header, BVH_PRIMITIVES, sphereCount);
+        const float* leafCenterX = getSection<float>(*file, header, BVH_CENTER_X, paddedCount);
+        const float* leafCenterY = getSection<float>(*file, header, BVH_CENTER_Y, paddedCount);
+        const float* leafRadiusSquared = getSection<float>(*file, header, BVH_RADIUS_SQUARED, paddedCount);
+        // A binary tree over n leaves has at most 2n - 1 nodes
+        if (!nodes || !primitiveIndices || !leafCenterX || !leafCenterY || !leafRadiusSquared
+            || header.bvhNodeCount >= 2 * sphereCount
+            || header.bvhNodeCount > static_cast<uint32_t>(std::numeric_limits<int>::max())) {
+            error = path + " has a truncated or corrupt BVH";
+            return false;
+        }
+        
+        // The BVH holds the only references to the mapping, which closes with its last copy
+        SphereSoA sphereData;
+        sphereData.view(leafCenterX, leafCenterY, leafRadiusSquared, static_cast<int>(sphereCount), file);
+        BVH bvh;
+        if (!bvh.view(nodes, static_cast<int>(header.bvhNodeCount), primitiveIndices, static_cast<int>(sphereCount),
+                      sphereData, file)) {
+            // The spheres were validated above, so a tree too deep to traverse is rebuilt
+            // from them rather than rejecting a usable scene
+            scene.setContents(std::move(spheres), std::move(lights));
+            return true;
+        }
+        scene.setContents(std::move(spheres), std::move(lights), &bvh);
+        return true;
+    }
+    
+    bool parseText(const std::string& path, std::vector<Sphere>& spheres, std::vector<Light>& lights, std::string& error) {
+        std::ifstream file(path);
+        if (!file) {
+            error = "cannot open " + path;
+            return false;
+        }
+        
+        std::string text;
+        for (int lineNumber = 1; std::getline(file, text); ++lineNumber) {
+            const size_t comment = text.find('#');
+            if (comment != std::string::npos) {
+                text.erase(comment);
+            }
+            std::istringstream line(text);
+            std::string keyword;
+            if (!(line >> keyword)) {
+                continue;
+            }
+            
+            const std::string location = path + ":" + std::to_string(lineNumber) + ": ";
+            float x, y;
+            if (keyword == "sphere") {
+                float radius;
+                if (!(line >> x >> y >> radius) || radius <= 0.0f) {
+                    error = location + "expected sphere X Y RADIUS";
+                    return false;
+                }
+                Sphere sphere(sf::Vector2f(x, y), radius);
+                std::string surfaceName;
+                SurfaceType surface = SurfaceType::DIFFUSE;
+                std::streampos colorStart = line.tellg();
+                if (line >> surfaceName && !parseSurface(surfaceName, surface)) {
+                    // Not a surface name, so the colour starts here
+                    line.clear();
+                    line.seekg(colorStart);
+                }
+                sphere.setSurface(surface);
+                sf::Color material = sphere.getMaterial();
+                if (!parseColor(line, material)) {
+                    error = location + "expected a colour as R G B between 0 and 255";
+                    return false;
+                }
+                sphere.setMaterial(material);
+                spheres.push_back(sphere);
+            } else if (keyword == "light") {
+                if (!(line >> x >> y)) {
+                    error = location + "expected light X Y";
+                    return false;
+                }
+                sf::Color color = Utils::LIGHT_COLOR;
+                if (!parseColor(line, color)) {
+                    error = location + "expected a colour as R G B between 0 and 255";
+                    return false;
+                }
+                lights.emplace_back(sf::Vector2f(x, y), color);
+            } else {
+                error = location + "unknown item " + keyword;
+                return false;
+            }
+        }
+        
+        if (spheres.empty() || lights.empty()) {
+            error = path + " needs at least one sphere and one light";
+            return false;
+        }
+        return true;
+    }
+    }
@@ -0,0 +1,373 @@
+#include "../include/socket.hpp"
+#include <cstring>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#if defined(_WIN32)
+    const unsigned long long INVALID_HANDLE = INVALID_SOCKET;
+    
+    // Winsock needs one WSAStartup per process before any other call
+    bool startNetworking() {
+        static const bool started = [] {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        return started;
+    }
+    
+    void closeHandle(unsigned long long handle) {
+        closesocket(static_cast<SOCKET>(handle));
+    }
+#else
+    const int INVALID_HANDLE = -1;
+    
+    bool startNetworking() {
+        return true;
+    }
+    
+    void closeHandle(int handle) {
+        ::close(handle);
+    }
+#endif
+
+    // Splits "tcp:HOST:PORT" or "unix:PATH"; the port is the text after the last colon
+    bool parseAddress(const std::string& address, bool& isUnix, std::string& host, std::string& port,
+                      std::string& error) {
+        if (address.compare(0, 5, "unix:") == 0 && address.size() > 5) {
+            isUnix = true;
+            host = address.substr(5);
+            return true;
+        }
+        const size_t colon = address.rfind(':');
+        if (address.compare(0, 4, "tcp:") == 0 && colon >= 4 && colon + 1 < address.size()) {
+            isUnix = false;
+            host = address.substr(4, colon - 4);
+            port = address.substr(colon + 1);
+            return true;
+        }
+        error = "invalid address " + address + ", expected tcp:HOST:PORT or unix:PATH";
+        return false;
+    }
+
+#if !defined(_WIN32)
+    bool makeUnixAddress(const std::string& path, sockaddr_un& address, std::string& error) {
+        if (path.size() >= sizeof(address.sun_path)) {
+            error = "socket path too long: " + path;
+            return false;
+        }
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+#endif
+
+    addrinfo* resolve(const std::string& host, const std::string& port, bool passive, std::string& error) {
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = passive ? AI_PASSIVE : 0;
+        const bool anyHost = host.empty() || host == "*";
+        addrinfo* result = nullptr;
+        if (getaddrinfo(anyHost ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || !result) {
+            error = "cannot resolve " + host + ":" + port;
+            return nullptr;
+        }
+        return result;
+    }
+    
+    // Small messages (tile assignments) go out at once instead of waiting for Nagle's
+    // algorithm; the option fails harmlessly on Unix sockets, which have no such delay
+    template <typename Handle>
+    void configureConnection(Handle handle) {
+        int enabled = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+#if defined(SO_NOSIGPIPE)
+        // Platforms without MSG_NOSIGNAL report writes to a closed peer this way
+        setsockopt(handle, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+    }
+}
+
+Socket::Socket()
+    : handle(INVALID_HANDLE) {
+}
+
+Socket::~Socket() {
+    close();
+}
+
+Socket::Socket(Socket&& other) noexcept
+    : handle(other.handle)
+    , unixPath(std::move(other.unixPath)) {
+    other.handle = INVALID_HANDLE;
+    other.unixPath.clear();
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept {
+    if (this != &other) {
+        close();
+        handle = other.handle;
+        unixPath = std::move(other.unixPath);
+        other.handle = INVALID_HANDLE;
+        other.unixPath.clear();
+    }
+    return *this;
+}
+
+bool Socket::listen(const std::string& address, std::string& error) {
+    close();
+    bool isUnix = false;
+    std::string host;
+    std::string port;
+    if (!parseAddress(address, isUnix, host, port, error)) {
+        return false;
+    }
+    if (!startNetworking()) {
+        error = "cannot start networking";
+        return false;
+    }
+    
+    if (isUnix) {
+#if defined(_WIN32)
+        error = "Unix sockets are not supported on this platform";
+        return false;
+#else
+        sockaddr_un unixAddress;
+        if (!makeUnixAddress(host, unixAddress, error)) {
+            return false;
+        }
+        ::unlink(host.c_str());
+        handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (handle == INVALID_HANDLE
+            || ::bind(handle, reinterpret_cast<const sockaddr*>(&unixAddress), sizeof(unixAddress)) != 0
+            || ::listen(handle, SOMAXCONN) != 0) {
+            error = "cannot listen on " + address;
+            close();
+            return false;
+        }
+        unixPath = host;
+        return true;
+#endif
+    }
+    
+    addrinfo* addresses = resolve(host, port, true, error);
+    if (!addresses) {
+        return false;
+    }
+    for (addrinfo* candidate = addresses; candidate; candidate = candidate->ai_next) {
+        handle = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (handle == INVALID_HANDLE) {
+            continue;
+        }
+        // A restarted coordinator can reuse its port while old connections linger
+        int enabled = 1;
+        setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+        if (::bind(handle, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0
+            && ::listen(handle, SOMAXCONN) == 0) {
+            break;
+        }
+        closeHandle(handle);
+        handle = INVALID_HANDLE;
+    }
+    freeaddrinfo(addresses);
+    if (handle == INVALID_HANDLE) {
+        error = "cannot listen on " + address;
+        return false;
+    }
+    return true;
+}
+
+bool Socket::connect(const std::string& address, std::string& error) {
+    close();
+    bool isUnix = false;
+    std::string host;
+    std::string port;
+    if (!parseAddress(address, isUnix, host, port, error)) {
+        return false;
+    }
+    if (!startNetworking()) {
+        error = "cannot start networking";
+        return false;
+    }
+    
+    if (isUnix) {
+#if defined(_WIN32)
+        error = "Unix sockets are not supported on this platform";
+        return false;
+#else
+        sockaddr_un unixAddress;
+        if (!makeUnixAddress(host, unixAddress, error)) {
+            return false;
+        }
+        handle = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (handle == INVALID_HANDLE
+            || ::connect(handle, reinterpret_cast<const sockaddr*>(&unixAddress), sizeof(unixAddress)) != 0) {
+            error = "cannot connect to " + address;
+            close();
+            return false;
+        }
+        configureConnection(handle);
+        return true;
+#endif
+    }
+    
+    addrinfo* addresses = resolve(host, port, false, error);
+    if (!addresses) {
+        return false;
+    }
+    for (addrinfo* candidate = addresses; candidate; candidate = candidate->ai_next) {
+        handle = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (handle == INVALID_HANDLE) {
+            continue;
+        }
+        if (::connect(handle, candidate->ai_addr, static_cast<int>(candidate->ai_addrlen)) == 0) {
+            configureConnection(handle);
+            break;
+        }
+        closeHandle(handle);
+        handle = INVALID_HANDLE;
+    }
+    freeaddrinfo(addresses);
+    if (handle == INVALID_HANDLE) {
+        error = "cannot connect to " + address;
+        return false;
+    }
+    return true;
+}
+
+bool Socket::accept(Socket& client, std::string& error) {
+    client.close();
+    const Handle accepted = ::accept(handle, nullptr, nullptr);
+    if (accepted == INVALID_HANDLE) {
+        error = "cannot accept a connection";
+        return false;
+    }
+    configureConnection(accepted);
+    client.handle = accepted;
+    return true;
+}
+
+void Socket::close() {
+    if (handle != INVALID_HANDLE) {
+        closeHandle(handle);
+        handle = INVALID_HANDLE;
+    }
+#if !defined(_WIN32)
+    if (!unixPath.empty()) {
+        ::unlink(unixPath.c_str());
+    }
+#endif
+    unixPath.clear();
+}
+
+bool Socket::isOpen() const {
+    return handle != INVALID_HANDLE;
+}
+
+bool Socket::sendAll(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const int chunk = static_cast<int>(size < (1u << 30) ? size : (1u << 30));
+#if defined(_WIN32)
+        const int sent = ::send(handle, bytes, chunk, 0);
+#elif defined(MSG_NOSIGNAL)
+        // A worker that died must show up as an error, not kill the process with SIGPIPE
+        const ssize_t sent = ::send(handle, bytes, chunk, MSG_NOSIGNAL);
+#else
+        const ssize_t sent = ::send(handle, bytes, chunk, 0);
+#endif
+        if (sent <= 0) {
+#if !defined(_WIN32)
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+#endif
+            return false;
+        }
+        bytes += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool Socket::receiveAll(void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        const int chunk = static_cast<int>(size < (1u << 30) ? size : (1u << 30));
+#if defined(_WIN32)
+        const int received = ::recv(handle, bytes, chunk, 0);
+#else
+        const ssize_t received = ::recv(handle, bytes, chunk, 0);
+#endif
+        if (received <= 0) {
+#if !defined(_WIN32)
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+#endif
+            return false;
+        }
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+void Socket::setTimeout(int milliseconds) {
+#if defined(_WIN32)
+    DWORD timeout = static_cast<DWORD>(milliseconds);
+#else
+    timeval timeout;
+    timeout.tv_sec = milliseconds / 1000;
+    timeout.tv_usec = (milliseconds % 1000) * 1000;
+#endif
+    setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+    setsockopt(handle, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+bool Socket::waitReadable(const std::vector<Socket*>& sockets, int timeoutMs, std::vector<char>& readable) {
+    readable.assign(sockets.size(), 0);
+#if defined(_WIN32)
+    std::vector<WSAPOLLFD> descriptors(sockets.size());
+#else
+    std::vector<pollfd> descriptors(sockets.size());
+#endif
+    for (size_t i = 0; i < sockets.size(); ++i) {
+        descriptors[i].fd = sockets[i]->handle;
+        descriptors[i].events = POLLIN;
+        descriptors[i].revents = 0;
+    }
+#if defined(_WIN32)
+    const int ready = WSAPoll(descriptors.data(), static_cast<ULONG>(descriptors.size()), timeoutMs);
+#else
+    const int ready = ::poll(descriptors.data(), static_cast<nfds_t>(descriptors.size()), timeoutMs);
+#endif
+    if (ready <= 0) {
+        return false;
+    }
+    // Errors and hang-ups count as readable, so the next receive reports them
+    for (size_t i = 0; i < sockets.size(); ++i) {
+        readable[i] = (descriptors[i].revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+    }
+    return true;
+}
@@ -2,7 +2,8 @@
 #include <cmath>
 
 Sphere::Sphere(const sf::Vector2f& position, float radius)
-    : radius(radius), position(position), material(sf::Color::Red) {
+    : radius(radius), position(position), material(sf::Color::Red)
+    , surface(SurfaceType::DIFFUSE), reflectivity(0.f), transparency(0.f), refractiveIndex(1.f) {
 }
 
 void Sphere::draw(sf::RenderWindow& window, sf::Vector2f lightPos) {
@@ -30,22 +31,22 @@ float Sphere::getRadius() const {
 }
 
 RayHit Sphere::intersect(const Ray& ray) const {
-    // Ray-sphere intersection using quadratic formula
+    // Ray-sphere intersection using the half-b quadratic formula.
+    // Ray directions are unit length (see Ray::normalize), so a == 1.
     sf::Vector2f oc = ray.origin - position;
     
-    float a = ray.direction.x * ray.direction.x + ray.direction.y * ray.direction.y;
-    float b = 2.0f * (oc.x * ray.direction.x + oc.y * ray.direction.y);
+    float b = oc.x * ray.direction.x + oc.y * ray.direction.y;
     float c = oc.x * oc.x + oc.y * oc.y - radius * radius;
     
-    float discriminant = b * b - 4 * a * c;
+    float discriminant = b * b - c;
     
     if (discriminant < 0) {
         return RayHit(); // No intersection
     }
     
     float sqrtDisc = std::sqrt(discriminant);
-    float t1 = (-b - sqrtDisc) / (2.0f * a);
-    float t2 = (-b + sqrtDisc) / (2.0f * a);
+    float t1 = -b - sqrtDisc;
+    float t2 = -b + sqrtDisc;
     
     // Find the closest intersection point
     float t = (t1 > 0) ? t1 : t2;
@@ -72,3 +73,49 @@ sf::Vector2f Sphere::getNormal(const sf::Vector2f& point) const {
 sf::Color Sphere::getMaterial() const {
     return material;
 }
+
+void Sphere::setMaterial(const sf::Color& color) {
+    material = color;
+}
+
+void Sphere::setSurface(SurfaceType type) {
+    surface = type;
+    switch (type) {
+        case SurfaceType::DIFFUSE:
+            reflectivity = 0.0f;
+            transparency = 0.0f;
+            refractiveIndex = 1.0f;
+            break;
+        case SurfaceType::MIRROR:
+            reflectivity = 0.85f;
+            transparency = 0.0f;
+            refractiveIndex = 1.0f;
+            break;
+        case SurfaceType::GLASS:
+            // Reflection at the glass surface comes from the Fresnel term alone
+            reflectivity = 0.0f;
+            transparency = 0.9f;
+            refractiveIndex = 1.5f;
+            break;
+    }
+}
+
+SurfaceType Sphere::getSurface() const {
+    return surface;
+}
+
+float Sphere::getReflectivity() const {
+    return reflectivity;
+}
+
+float Sphere::getTransparency() const {
+    return transparency;
+}
+
+float Sphere::getRefractiveIndex() const {
+    return refractiveIndex;
+}
+
+bool Sphere::isSpecular() const {
+    return reflectivity > 0.0f || transparency > 0.0f;
+}
@@ -0,0 +1,324 @@
+#include "../include/spheresoa.hpp"
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RT_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang need per-function target attributes to emit AVX2 without global flags.
+// MSVC accepts the intrinsics directly.
+#if defined(RT_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define RT_TARGET_SSE __attribute__((target("sse2")))
+#define RT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RT_TARGET_SSE
+#define RT_TARGET_AVX2
+#endif
+
+namespace {
+    typedef int (*ClosestKernel)(const float*, const float*, const float*, const Ray&, int, float, float&);
+    
+    int lowestSetBit(unsigned mask) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+    
+    // Every kernel evaluates the same expressions in the same order, so all
+    // levels return bit-identical distances:
+    //   b = oc.d, c = oc.oc - r^2, t = -b -/+ sqrt(b^2 - c)
+    float intersectLane(float ox, float oy, float dx, float dy, float cx, float cy, float r2) {
+        float ocx = ox - cx;
+        float ocy = oy - cy;
+        float b = ocx * dx + ocy * dy;
+        float c = ocx * ocx + ocy * ocy - r2;
+        float discriminant = b * b - c;
+        if (discriminant < 0) {
+            return -1.0f;
+        }
+        float sqrtDisc = std::sqrt(discriminant);
+        float t1 = -b - sqrtDisc;
+        float t2 = -b + sqrtDisc;
+        return (t1 > 0) ? t1 : t2;
+    }
+    
+    int closestScalar(const float* cx, const float* cy, const float* r2, const Ray& ray, int count, float maxDistance, float& distance) {
+        int best = -1;
+        float bestDistance = std::numeric_limits<float>::infinity();
+        for (int i = 0; i < count; ++i) {
+            float t = intersectLane(ray.origin.x, ray.origin.y, ray.direction.x, ray.direction.y, cx[i], cy[i], r2[i]);
+            if (t > 0 && t <= maxDistance && t < bestDistance) {
+                bestDistance = t;
+                best = i;
+            }
+        }
+        if (best >= 0) {
+            distance = bestDistance;
+        }
+        return best;
+    }
+    
+#if defined(RT_SIMD_X86)
+    RT_TARGET_SSE __m128 intersectSSE(__m128 ox, __m128 oy, __m128 dx, __m128 dy, __m128 cx, __m128 cy, __m128 r2) {
+        __m128 ocx = _mm_sub_ps(ox, cx);
+        __m128 ocy = _mm_sub_ps(oy, cy);
+        __m128 b = _mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy));
+        __m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), r2);
+        __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), c);
+        
+        // A negative discriminant gives NaN, which fails every later comparison
+        __m128 sqrtDisc = _mm_sqrt_ps(discriminant);
+        __m128 negB = _mm_sub_ps(_mm_setzero_ps(), b);
+        __m128 t1 = _mm_sub_ps(negB, sqrtDisc);
+        __m128 t2 = _mm_add_ps(negB, sqrtDisc);
+        __m128 useT1 = _mm_cmpgt_ps(t1, _mm_setzero_ps());
+        __m128 t = _mm_or_ps(_mm_and_ps(useT1, t1), _mm_andnot_ps(useT1, t2));
+        return _mm_or_ps(_mm_and_ps(_mm_cmpge_ps(discriminant, _mm_setzero_ps()), t),
+                         _mm_andnot_ps(_mm_cmpge_ps(discriminant, _mm_setzero_ps()), _mm_set1_ps(-1.0f)));
+    }
+    
+    RT_TARGET_SSE int closestSSE(const float* cx, const float* cy, const float* r2, const Ray& ray, int count, float maxDistance, float& distance) {
+        const __m128 ox = _mm_set1_ps(ray.origin.x);
+        const __m128 oy = _mm_set1_ps(ray.origin.y);
+        const __m128 dx = _mm_set1_ps(ray.direction.x);
+        const __m128 dy = _mm_set1_ps(ray.direction.y);
+        const __m128 maxT = _mm_set1_ps(maxDistance);
+        const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        const __m128 laneIndex = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        
+        __m128 tHalves[2];
+        for (int half = 0; half < 2; ++half) {
+            int offset = half * 4;
+            __m128 t = intersectSSE(ox, oy, dx, dy, _mm_loadu_ps(cx + offset), _mm_loadu_ps(cy + offset), _mm_loadu_ps(r2 + offset));
+            __m128 inRange = _mm_and_ps(_mm_cmpgt_ps(t, _mm_setzero_ps()), _mm_cmple_ps(t, maxT));
+            __m128 active = _mm_cmplt_ps(_mm_add_ps(laneIndex, _mm_set1_ps(static_cast<float>(offset))), _mm_set1_ps(static_cast<float>(count)));
+            __m128 valid = _mm_and_ps(inRange, active);
+            tHalves[half] = _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, inf));
+        }
+        
+        // Horizontal minimum, then the lowest lane holding it
+        __m128 m = _mm_min_ps(tHalves[0], tHalves[1]);
+        m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+        float best = _mm_cvtss_f32(m);
+        if (best == std::numeric_limits<float>::infinity()) {
+            return -1;
+        }
+        
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_cmpeq_ps(tHalves[0], m)))
+                      | (static_cast<unsigned>(_mm_movemask_ps(_mm_cmpeq_ps(tHalves[1], m))) << 4);
+        distance = best;
+        return lowestSetBit(mask);
+    }
+    
+    RT_TARGET_AVX2 __m256 intersectAVX2(__m256 ox, __m256 oy, __m256 dx, __m256 dy, __m256 cx, __m256 cy, __m256 r2) {
+        __m256 ocx = _mm256_sub_ps(ox, cx);
+        __m256 ocy = _mm256_sub_ps(oy, cy);
+        __m256 b = _mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy));
+        __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)), r2);
+        __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), c);
+        
+        __m256 sqrtDisc = _mm256_sqrt_ps(discriminant);
+        __m256 negB = _mm256_sub_ps(_mm256_setzero_ps(), b);
+        __m256 t1 = _mm256_sub_ps(negB, sqrtDisc);
+        __m256 t2 = _mm256_add_ps(negB, sqrtDisc);
+        __m256 t = _mm256_blendv_ps(t2, t1, _mm256_cmp_ps(t1, _mm256_setzero_ps(), _CMP_GT_OQ));
+        return _mm256_blendv_ps(_mm256_set1_ps(-1.0f), t, _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ));
+    }
+    
+    RT_TARGET_AVX2 int closestAVX2(const float* cx, const float* cy, const float* r2, const Ray& ray, int count, float maxDistance, float& distance) {
+        __m256 t = intersectAVX2(_mm256_set1_ps(ray.origin.x), _mm256_set1_ps(ray.origin.y),
+                                 _mm256_set1_ps(ray.direction.x), _mm256_set1_ps(ray.direction.y),
+                                 _mm256_loadu_ps(cx), _mm256_loadu_ps(cy), _mm256_loadu_ps(r2));
+        
+        __m256 inRange = _mm256_and_ps(_mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GT_OQ),
+                                       _mm256_cmp_ps(t, _mm256_set1_ps(maxDistance), _CMP_LE_OQ));
+        __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256 active = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(count), laneIndex));
+        __m256 valid = _mm256_and_ps(inRange, active);
+        t = _mm256_blendv_ps(_mm256_set1_ps(std::numeric_limits<float>::infinity()), t, valid);
+        
+        // Horizontal minimum, then the lowest lane holding it
+        __m256 m = _mm256_min_ps(t, _mm256_permute2f128_ps(t, t, 1));
+        m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+        m = _mm256_min_ps(m, _mm256_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+        float best = _mm256_cvtss_f32(m);
+        if (best == std::numeric_limits<float>::infinity()) {
+            return -1;
+        }
+        
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(t, m, _CMP_EQ_OQ)));
+        distance = best;
+        return lowestSetBit(mask);
+    }
+    
+#endif
+    
+    struct KernelTable {
+        SimdLevel level;
+        ClosestKernel closest;
+    };
+    
+    KernelTable makeKernelTable(SimdLevel level) {
+#if defined(RT_SIMD_X86)
+        if (level == SimdLevel::AVX2) {
+            return { SimdLevel::AVX2, closestAVX2 };
+        }
+        if (level == SimdLevel::SSE) {
+            return { SimdLevel::SSE, closestSSE };
+        }
+#endif
+        return { SimdLevel::SCALAR, closestScalar };
+    }
+    
+    KernelTable& activeKernels() {
+        static KernelTable table = makeKernelTable(SphereSoA::detectSimdLevel());
+        return table;
+    }
+}
+
+SphereSoA::SphereSoA()
+    : viewCenterX(nullptr)
+    , viewCenterY(nullptr)
+    , viewRadiusSquared(nullptr)
+    , count(0) {
+}
+
+void SphereSoA::assign(const std::vector<Sphere>& spheres, const std::vector<int>& order) {
+    count = static_cast<int>(order.size());
+    viewCenterX = nullptr;
+    viewCenterY = nullptr;
+    viewRadiusSquared = nullptr;
+    viewStorage.reset();
+    
+    // Padding lanes never hit: with a negative radius squared c is always positive
+    centerX.assign(count + LANES, 0.0f);
+    centerY.assign(count + LANES, 0.0f);
+    radiusSquared.assign(count + LANES, -1.0f);
+    
+    for (int i = 0; i < count; ++i) {
+        const Sphere& sphere = spheres[order[i]];
+        centerX[i] = sphere.getPosition().x;
+        centerY[i] = sphere.getPosition().y;
+        radiusSquared[i] = sphere.getRadius() * sphere.getRadius();
+    }
+}
+
+void SphereSoA::view(const float* newCenterX, const float* newCenterY, const float* newRadiusSquared, int newCount,
+                     std::shared_ptr<const void> storage) {
+    count = newCount;
+    viewCenterX = newCenterX;
+    viewCenterY = newCenterY;
+    viewRadiusSquared = newRadiusSquared;
+    viewStorage = std::move(storage);
+    // Release the owned copy; the view replaces it
+    std::vector<float>().swap(centerX);
+    std::vector<float>().swap(centerY);
+    std::vector<float>().swap(radiusSquared);
+}
+
+void SphereSoA::set(int index, const Sphere& sphere) {
+    if (viewCenterX) {
+        centerX.assign(viewCenterX, viewCenterX + count + LANES);
+        centerY.assign(viewCenterY, viewCenterY + count + LANES);
+        radiusSquared.assign(viewRadiusSquared, viewRadiusSquared + count + LANES);
+        viewCenterX = nullptr;
+        viewCenterY = nullptr;
+        viewRadiusSquared = nullptr;
+        viewStorage.reset();
+    }
+    centerX[index] = sphere.getPosition().x;
+    centerY[index] = sphere.getPosition().y;
+    radiusSquared[index] = sphere.getRadius() * sphere.getRadius();
+}
+
+int SphereSoA::size() const {
+    return count;
+}
+
+const float* SphereSoA::getCenterX() const {
+    return viewCenterX ? viewCenterX : centerX.data();
+}
+
+const float* SphereSoA::getCenterY() const {
+    return viewCenterY ? viewCenterY : centerY.data();
+}
+
+const float* SphereSoA::getRadiusSquared() const {
+    return viewRadiusSquared ? viewRadiusSquared : radiusSquared.data();
+}
+
+int SphereSoA::intersectClosest(const Ray& ray, int first, int laneCount, float maxDistance, float& distance) const {
+    return activeKernels().closest(getCenterX() + first, getCenterY() + first, getRadiusSquared() + first,
+                                   ray, laneCount, maxDistance, distance);
+}
+
+bool SphereSoA::intersectAny(const Ray& ray, int first, int laneCount, float maxDistance) const {
+    float distance;
+    return intersectClosest(ray, first, laneCount, maxDistance, distance) >= 0;
+}
+
+SimdLevel SphereSoA::detectSimdLevel() {
+#if defined(RT_SIMD_X86)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    
+    __cpuid(info, 1);
+    bool hasSSE2 = (info[3] & (1 << 26)) != 0;
+    bool hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+    bool hasAVX = (info[2] & (1 << 28)) != 0;
+    
+    // AVX registers are only usable if the OS saves the upper halves
+    bool osSavesYmm = hasOSXSAVE && hasAVX && (_xgetbv(0) & 0x6) == 0x6;
+    bool hasAVX2 = false;
+    if (maxLeaf >= 7 && osSavesYmm) {
+        __cpuidex(info, 7, 0);
+        hasAVX2 = (info[1] & (1 << 5)) != 0;
+    }
+    
+    if (hasAVX2) return SimdLevel::AVX2;
+    if (hasSSE2) return SimdLevel::SSE;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE;
+#endif
+#endif
+    return SimdLevel::SCALAR;
+}
+
+SimdLevel SphereSoA::getSimdLevel() {
+    return activeKernels().level;
+}
+
+void SphereSoA::setSimdLevel(SimdLevel level) {
+    // Never select a level the CPU cannot run
+    if (static_cast<int>(level) > static_cast<int>(detectSimdLevel())) {
+        level = detectSimdLevel();
+    }
+    activeKernels() = makeKernelTable(level);
+}
+
+const char* SphereSoA::getSimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX2:
+            return "avx2";
+        case SimdLevel::SSE:
+            return "sse";
+        case SimdLevel::SCALAR:
+            return "scalar";
+    }
+    return "scalar";
+}
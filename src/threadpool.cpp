@@ -0,0 +1,150 @@
+#include "../include/threadpool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : currentTask(nullptr)
+    , pendingItems(0)
+    , generation(0)
+    , stopping(false) {
+    startWorkers(threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+    stopWorkers();
+}
+
+void ThreadPool::setThreadCount(unsigned threadCount) {
+    stopWorkers();
+    startWorkers(threadCount);
+}
+
+unsigned ThreadPool::getThreadCount() const {
+    return static_cast<unsigned>(queues.size());
+}
+
+unsigned ThreadPool::getMaxThreadCount() {
+    return MAX_THREADS_PER_CORE * std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::startWorkers(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    stopping = false;
+    queues.clear();
+    for (unsigned i = 0; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    
+    // Worker 0 is the thread calling parallelFor
+    for (unsigned i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+void ThreadPool::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::run(int count, const TaskReference& task) {
+    if (count <= 0) {
+        return;
+    }
+    
+    // Nothing to share the work with
+    if (workers.empty()) {
+        for (int i = 0; i < count; ++i) {
+            task.invoke(task.task, i);
+        }
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        currentTask = &task;
+        pendingItems.store(count);
+        
+        // Hand out contiguous ranges so neighbouring tiles stay on one core
+        const unsigned queueCount = static_cast<unsigned>(queues.size());
+        for (unsigned q = 0; q < queueCount; ++q) {
+            int begin = static_cast<int>(static_cast<int64_t>(count) * q / queueCount);
+            int end = static_cast<int>(static_cast<int64_t>(count) * (q + 1) / queueCount);
+            
+            std::lock_guard<std::mutex> queueLock(queues[q]->mutex);
+            queues[q]->next = begin;
+            queues[q]->end = end;
+        }
+        ++generation;
+    }
+    wakeCondition.notify_all();
+    
+    drainQueues(0);
+    
+    std::unique_lock<std::mutex> lock(stateMutex);
+    doneCondition.wait(lock, [this] { return pendingItems.load() == 0; });
+    currentTask = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    uint64_t seenGeneration = 0;
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+        
+        drainQueues(index);
+    }
+}
+
+void ThreadPool::drainQueues(unsigned index) {
+    int item;
+    while (popOrSteal(index, item)) {
+        currentTask->invoke(currentTask->task, item);
+        
+        if (pendingItems.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            doneCondition.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::popOrSteal(unsigned index, int& item) {
+    // Own queue first, taken from the front to keep spatial order
+    {
+        WorkQueue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.next < own.end) {
+            item = own.next++;
+            return true;
+        }
+    }
+    
+    // Steal from the back of the other queues
+    const unsigned queueCount = static_cast<unsigned>(queues.size());
+    for (unsigned offset = 1; offset < queueCount; ++offset) {
+        WorkQueue& victim = *queues[(index + offset) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.next < victim.end) {
+            item = --victim.end;
+            return true;
+        }
+    }
+    
+    return false;
+}
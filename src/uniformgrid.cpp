@@ -0,0 +1,261 @@
+#include "../include/uniformgrid.hpp"
+#include <cmath>
+#include <limits>
+
+namespace {
+    // About one cell per sphere, but at least two mean sphere diameters wide so
+    // that each sphere lands in only a few cells
+    constexpr float CELLS_PER_SPHERE = 1.0f;
+    constexpr float MIN_CELL_DIAMETERS = 2.0f;
+    constexpr int MAX_GRID_RESOLUTION = 1024;
+    // Spheres per build chunk; each chunk keeps a count per cell, so chunks stay few
+    constexpr int BUILD_CHUNK_SIZE = 4096;
+    constexpr int MAX_BUILD_CHUNKS = 16;
+}
+
+UniformGrid::UniformGrid()
+    : boundsMin(0.f, 0.f)
+    , boundsMax(0.f, 0.f)
+    , cellSize(1.0f)
+    , inverseCellSize(1.0f)
+    , cellsX(0)
+    , cellsY(0)
+    , sphereCount(0) {
+}
+
+void UniformGrid::build(const std::vector<Sphere>& spheres, ThreadPool* threadPool) {
+    sphereCount = static_cast<int>(spheres.size());
+    cellSpheres.clear();
+    if (spheres.empty()) {
+        cellsX = 0;
+        cellsY = 0;
+        cellStart.assign(1, 0);
+        sphereData.assign(spheres, cellSpheres);
+        return;
+    }
+    
+    boundsMin = sf::Vector2f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    boundsMax = sf::Vector2f(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+    float radiusSum = 0.0f;
+    for (const Sphere& sphere : spheres) {
+        const sf::Vector2f center = sphere.getPosition();
+        const float radius = sphere.getRadius();
+        radiusSum += radius;
+        boundsMin.x = std::min(boundsMin.x, center.x - radius);
+        boundsMin.y = std::min(boundsMin.y, center.y - radius);
+        boundsMax.x = std::max(boundsMax.x, center.x + radius);
+        boundsMax.y = std::max(boundsMax.y, center.y + radius);
+    }
+    
+    // Square cells; the sphere count sets their number, the sphere size a lower bound on their size
+    const sf::Vector2f extent(std::max(boundsMax.x - boundsMin.x, 1.0f), std::max(boundsMax.y - boundsMin.y, 1.0f));
+    cellSize = std::sqrt(extent.x * extent.y / (CELLS_PER_SPHERE * static_cast<float>(sphereCount)));
+    cellSize = std::max(cellSize, MIN_CELL_DIAMETERS * 2.0f * radiusSum / static_cast<float>(sphereCount));
+    cellSize = std::max(cellSize, std::max(extent.x, extent.y) / MAX_GRID_RESOLUTION);
+    inverseCellSize = 1.0f / cellSize;
+    cellsX = std::min(MAX_GRID_RESOLUTION, static_cast<int>(extent.x * inverseCellSize) + 1);
+    cellsY = std::min(MAX_GRID_RESOLUTION, static_cast<int>(extent.y * inverseCellSize) + 1);
+    const int cellCount = cellsX * cellsY;
+    
+    const int chunkCount = threadPool
+        ? std::min(MAX_BUILD_CHUNKS, (sphereCount + BUILD_CHUNK_SIZE - 1) / BUILD_CHUNK_SIZE)
+        : 1;
+    const int chunkSize = (sphereCount + chunkCount - 1) / chunkCount;
+    auto forEachChunk = [&](const auto& task) {
+        if (chunkCount > 1) {
+            threadPool->parallelFor(chunkCount, task);
+        } else {
+            task(0);
+        }
+    };
+    // Calls visit(cell) for every cell the sphere's bounding box overlaps
+    auto forEachCell = [&](const Sphere& sphere, auto visit) {
+        const sf::Vector2f center = sphere.getPosition();
+        const float radius = sphere.getRadius();
+        const int firstColumn = cellColumn(center.x - radius);
+        const int lastColumn = cellColumn(center.x + radius);
+        const int firstRow = cellRow(center.y - radius);
+        const int lastRow = cellRow(center.y + radius);
+        for (int row = firstRow; row <= lastRow; ++row) {
+            for (int column = firstColumn; column <= lastColumn; ++column) {
+                visit(row * cellsX + column);
+            }
+        }
+    };
+    
+    // Counting pass: each chunk counts its spheres per cell
+    chunkCounts.assign(static_cast<size_t>(chunkCount) * cellCount, 0);
+    forEachChunk([&](int chunk) {
+        int* counts = &chunkCounts[static_cast<size_t>(chunk) * cellCount];
+        const int last = std::min(sphereCount, (chunk + 1) * chunkSize);
+        for (int i = chunk * chunkSize; i < last; ++i) {
+            forEachCell(spheres[i], [&](int cell) {
+                ++counts[cell];
+            });
+        }
+    });
+    
+    // Prefix sum over cells, then chunks, turning the counts into write cursors;
+    // every chunk owns a slice of each cell, in sphere order
+    cellStart.resize(cellCount + 1);
+    int total = 0;
+    for (int cell = 0; cell < cellCount; ++cell) {
+        cellStart[cell] = total;
+        for (int chunk = 0; chunk < chunkCount; ++chunk) {
+            int& count = chunkCounts[static_cast<size_t>(chunk) * cellCount + cell];
+            const int chunkEntries = count;
+            count = total;
+            total += chunkEntries;
+        }
+    }
+    cellStart[cellCount] = total;
+    
+    // Scatter pass: the same cell walk, writing sphere indices at the cursors
+    cellSpheres.resize(total);
+    forEachChunk([&](int chunk) {
+        int* cursors = &chunkCounts[static_cast<size_t>(chunk) * cellCount];
+        const int last = std::min(sphereCount, (chunk + 1) * chunkSize);
+        for (int i = chunk * chunkSize; i < last; ++i) {
+            forEachCell(spheres[i], [&](int cell) {
+                cellSpheres[cursors[cell]++] = i;
+            });
+        }
+    });
+    
+    sphereData.assign(spheres, cellSpheres);
+}
+
+template <typename CellVisitor>
+void UniformGrid::walkCells(const Ray& ray, float tEnter, float tExit, CellVisitor visit) const {
+    const float infinity = std::numeric_limits<float>::infinity();
+    const sf::Vector2f start = ray.getPointAtDistance(tEnter);
+    int column = cellColumn(start.x);
+    int row = cellRow(start.y);
+    const int stepX = ray.direction.x < 0.0f ? -1 : 1;
+    const int stepY = ray.direction.y < 0.0f ? -1 : 1;
+    
+    // Distance along the ray to the next column and row border, and between borders
+    const float deltaX = ray.direction.x != 0.0f ? std::abs(cellSize / ray.direction.x) : infinity;
+    const float deltaY = ray.direction.y != 0.0f ? std::abs(cellSize / ray.direction.y) : infinity;
+    float nextX = ray.direction.x != 0.0f
+        ? (boundsMin.x + static_cast<float>(column + (stepX > 0 ? 1 : 0)) * cellSize - ray.origin.x) / ray.direction.x
+        : infinity;
+    float nextY = ray.direction.y != 0.0f
+        ? (boundsMin.y + static_cast<float>(row + (stepY > 0 ? 1 : 0)) * cellSize - ray.origin.y) / ray.direction.y
+        : infinity;
+    
+    while (true) {
+        const float cellExit = std::min(tExit, std::min(nextX, nextY));
+        if (!visit(row * cellsX + column, cellExit) || cellExit >= tExit) {
+            return;
+        }
+        if (nextX < nextY) {
+            column += stepX;
+            if (column < 0 || column >= cellsX) {
+                return;
+            }
+            nextX += deltaX;
+        } else {
+            row += stepY;
+            if (row < 0 || row >= cellsY) {
+                return;
+            }
+            nextY += deltaY;
+        }
+    }
+}
+
+RayHit UniformGrid::intersect(const Ray& ray, const std::vector<Sphere>& spheres) const {
+    RayHit closest;
+    float tEnter, tExit;
+    if (cellSpheres.empty() || !clipRay(ray, ray.maxDistance, tEnter, tExit)) {
+        return closest;
+    }
+    
+    float closestDistance = ray.maxDistance;
+    int closestEntry = -1;
+    walkCells(ray, tEnter, tExit, [&](int cell, float cellExit) {
+        const int end = cellStart[cell + 1];
+        for (int first = cellStart[cell]; first < end; first += SphereSoA::LANES) {
+            const int laneCount = std::min(SphereSoA::LANES, end - first);
+            float distance;
+            const int lane = sphereData.intersectClosest(ray, first, laneCount, closestDistance, distance);
+            if (lane >= 0) {
+                closestEntry = first + lane;
+                closestDistance = distance;
+            }
+        }
+        // A sphere hit closer than the cell's exit overlaps a cell already tested
+        return closestDistance > cellExit;
+    });
+    
+    // Only the winning hit pays for the hit point and normal
+    if (closestEntry >= 0) {
+        const int index = cellSpheres[closestEntry];
+        sf::Vector2f hitPoint = ray.getPointAtDistance(closestDistance);
+        closest = RayHit(hitPoint, spheres[index].getNormal(hitPoint), closestDistance);
+        closest.objectIndex = index;
+    }
+    
+    return closest;
+}
+
+bool UniformGrid::isOccluded(const Ray& ray) const {
+    float tEnter, tExit;
+    if (cellSpheres.empty() || !clipRay(ray, ray.maxDistance, tEnter, tExit)) {
+        return false;
+    }
+    
+    bool occluded = false;
+    walkCells(ray, tEnter, tExit, [&](int cell, float) {
+        const int end = cellStart[cell + 1];
+        for (int first = cellStart[cell]; first < end && !occluded; first += SphereSoA::LANES) {
+            const int laneCount = std::min(SphereSoA::LANES, end - first);
+            occluded = sphereData.intersectAny(ray, first, laneCount, ray.maxDistance);
+        }
+        return !occluded;
+    });
+    return occluded;
+}
+
+int UniformGrid::getCellCount() const {
+    return cellsX * cellsY;
+}
+
+int UniformGrid::getEntryCount() const {
+    return static_cast<int>(cellSpheres.size());
+}
+
+UniformGrid::VisitMarks& UniformGrid::beginQuery(int sphereCount) {
+    thread_local VisitMarks marks = { std::vector<uint32_t>(), 0u };
+    if (marks.stamps.size() < static_cast<size_t>(sphereCount)) {
+        marks.stamps.resize(sphereCount, 0u);
+    }
+    // Stamps from earlier queries never match the new id, until the counter wraps
+    if (++marks.query == 0) {
+        std::fill(marks.stamps.begin(), marks.stamps.end(), 0u);
+        marks.query = 1;
+    }
+    return marks;
+}
+
+bool UniformGrid::clipRay(const Ray& ray, float maxDistance, float& tEnter, float& tExit) const {
+    const sf::Vector2f invDir(1.0f / ray.direction.x, 1.0f / ray.direction.y);
+    const float tx1 = (boundsMin.x - ray.origin.x) * invDir.x;
+    const float tx2 = (boundsMax.x - ray.origin.x) * invDir.x;
+    const float ty1 = (boundsMin.y - ray.origin.y) * invDir.y;
+    const float ty2 = (boundsMax.y - ray.origin.y) * invDir.y;
+    tEnter = std::max(0.0f, std::max(std::min(tx1, tx2), std::min(ty1, ty2)));
+    tExit = std::min(maxDistance, std::min(std::max(tx1, tx2), std::max(ty1, ty2)));
+    return tEnter <= tExit;
+}
+
+int UniformGrid::cellColumn(float x) const {
+    const int column = static_cast<int>(std::floor((x - boundsMin.x) * inverseCellSize));
+    return std::max(0, std::min(cellsX - 1, column));
+}
+
+int UniformGrid::cellRow(float y) const {
+    const int row = static_cast<int>(std::floor((y - boundsMin.y) * inverseCellSize));
+    return std::max(0, std::min(cellsY - 1, row));
+}
@@ -0,0 +1,167 @@
+#include "../include/upscaling.hpp"
+#include "../include/profiler.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+    // Largest per-channel difference in 0-255 steps
+    float colorDistance(const LinearColor& a, const LinearColor& b) {
+        return std::max(std::abs(a.r - b.r), std::max(std::abs(a.g - b.g), std::abs(a.b - b.b))) * 255.0f;
+    }
+    
+    float colorDistance(const sf::Color& a, const sf::Color& b) {
+        return static_cast<float>(std::max(std::abs(a.r - b.r), std::max(std::abs(a.g - b.g), std::abs(a.b - b.b))));
+    }
+    
+    // The weights sum to one
+    LinearColor blend(const LinearColor* corners, const float* weights) {
+        return corners[0] * weights[0] + corners[1] * weights[1] + corners[2] * weights[2] + corners[3] * weights[3];
+    }
+    
+    sf::Color blend(const sf::Color* corners, const float* weights) {
+        float r = 0.0f;
+        float g = 0.0f;
+        float b = 0.0f;
+        for (int i = 0; i < 4; ++i) {
+            r += corners[i].r * weights[i];
+            g += corners[i].g * weights[i];
+            b += corners[i].b * weights[i];
+        }
+        return sf::Color(static_cast<sf::Uint8>(r + 0.5f), static_cast<sf::Uint8>(g + 0.5f),
+                         static_cast<sf::Uint8>(b + 0.5f), corners[0].a);
+    }
+    
+    // Bilinear weights of the four corners for each pixel of a block, and the corner
+    // nearest to it, in row-major order
+    struct BlockWeights {
+        std::vector<std::array<float, 4>> weights;
+        std::vector<int> nearest;
+        
+        explicit BlockWeights(int step)
+            : weights(step * step)
+            , nearest(step * step) {
+            const float inverseStep = 1.0f / static_cast<float>(step);
+            for (int py = 0; py < step; ++py) {
+                const float fy = py * inverseStep;
+                for (int px = 0; px < step; ++px) {
+                    const float fx = px * inverseStep;
+                    std::array<float, 4>& w = weights[py * step + px];
+                    w[0] = (1.0f - fx) * (1.0f - fy);
+                    w[1] = fx * (1.0f - fy);
+                    w[2] = (1.0f - fx) * fy;
+                    w[3] = fx * fy;
+                    nearest[py * step + px] = (fx >= 0.5f ? 1 : 0) | (fy >= 0.5f ? 2 : 0);
+                }
+            }
+        }
+    };
+    
+    template <typename Buffer>
+    void upscaleBlockRow(Buffer& buffer, int step, const BlockWeights& table, int blockRow) {
+        typedef decltype(buffer.getPixel(0, 0)) Color;
+        const int width = static_cast<int>(buffer.getWidth());
+        const int height = static_cast<int>(buffer.getHeight());
+        const int y = blockRow * step;
+        const int blockHeight = std::min(step, height - y);
+        // The last row and column of blocks have no samples beyond them and repeat their own
+        const int below = y + step < height ? y + step : y;
+        
+        // Top-left, top-right, bottom-left, bottom-right; each block's right pair is the
+        // next block's left pair
+        Color corners[4];
+        corners[1] = buffer.getPixel(0, y);
+        corners[3] = buffer.getPixel(0, below);
+        for (int x = 0; x < width; x += step) {
+            const int right = x + step < width ? x + step : x;
+            const int blockWidth = std::min(step, width - x);
+            corners[0] = corners[1];
+            corners[2] = corners[3];
+            corners[1] = buffer.getPixel(right, y);
+            corners[3] = buffer.getPixel(right, below);
+            if (corners[0] == corners[1] && corners[0] == corners[2] && corners[0] == corners[3]) {
+                buffer.fillRect(x, y, blockWidth, blockHeight, corners[0]);
+                continue;
+            }
+            
+            // Bit j of similar[i] is set when corners i and j lie on the same side of any edge
+            unsigned similar[4] = { 1u, 2u, 4u, 8u };
+            for (int i = 0; i < 4; ++i) {
+                for (int j = i + 1; j < 4; ++j) {
+                    if (colorDistance(corners[i], corners[j]) <= Upscaling::EDGE_THRESHOLD) {
+                        similar[i] |= 1u << j;
+                        similar[j] |= 1u << i;
+                    }
+                }
+            }
+            const bool smooth = (similar[0] & similar[1] & similar[2] & similar[3]) == 15u;
+            
+            for (int py = 0; py < blockHeight; ++py) {
+                for (int px = 0; px < blockWidth; ++px) {
+                    if (px == 0 && py == 0) {
+                        continue;
+                    }
+                    const int index = py * step + px;
+                    if (smooth) {
+                        buffer.setPixel(x + px, y + py, blend(corners, table.weights[index].data()));
+                        continue;
+                    }
+                    // Samples across an edge from the nearest one are left out; it always
+                    // keeps a weight of at least a quarter, so the sum stays positive
+                    const unsigned mask = similar[table.nearest[index]];
+                    float weights[4];
+                    float total = 0.0f;
+                    for (int i = 0; i < 4; ++i) {
+                        weights[i] = (mask >> i) & 1u ? table.weights[index][i] : 0.0f;
+                        total += weights[i];
+                    }
+                    const float inverseTotal = 1.0f / total;
+                    for (float& weight : weights) {
+                        weight *= inverseTotal;
+                    }
+                    buffer.setPixel(x + px, y + py, blend(corners, weights));
+                }
+            }
+        }
+    }
+    
+    template <typename Buffer>
+    void upscaleBufferRows(Buffer& buffer, int step, int& top, int& bottom, ThreadPool* threadPool) {
+        PROFILE_ZONE("Upscaling::upscaleRows");
+        const int height = static_cast<int>(buffer.getHeight());
+        bottom = std::min(bottom, height);
+        if (step <= 1 || top >= bottom) {
+            return;
+        }
+        
+        // The blocks just above interpolate towards the samples on the first row
+        const int firstBlockRow = top > 0 ? (top - 1) / step : 0;
+        const int lastBlockRow = (bottom - 1) / step;
+        const BlockWeights table(step);
+        auto upscaleIndex = [&](int index) {
+            upscaleBlockRow(buffer, step, table, firstBlockRow + index);
+        };
+        const int blockRows = lastBlockRow - firstBlockRow + 1;
+        if (threadPool) {
+            threadPool->parallelFor(blockRows, upscaleIndex);
+        } else {
+            for (int i = 0; i < blockRows; ++i) {
+                upscaleIndex(i);
+            }
+        }
+        top = firstBlockRow * step;
+        bottom = std::min((lastBlockRow + 1) * step, height);
+    }
+}
+
+namespace Upscaling {
+    void upscaleRows(RadianceBuffer& buffer, int step, int& top, int& bottom, ThreadPool* threadPool) {
+        upscaleBufferRows(buffer, step, top, bottom, threadPool);
+    }
+    
+    void upscaleRows(FrameBuffer& buffer, int step, int& top, int& bottom, ThreadPool* threadPool) {
+        upscaleBufferRows(buffer, step, top, bottom, threadPool);
+    }
+}
@@ -1,4 +1,5 @@
 #include "../include/utils.hpp"
+#include <algorithm>
 #include <cmath>
 
 namespace Utils {
@@ -13,4 +14,21 @@ namespace Utils {
         if (value > max) return max;
         return value;
     }
+    
+    bool getTangentDirections(const sf::Vector2f& apex, const sf::Vector2f& center, float radius,
+                              sf::Vector2f& first, sf::Vector2f& second, sf::Vector2f& axis, float& distance) {
+        sf::Vector2f toCenter = center - apex;
+        distance = std::sqrt(toCenter.x * toCenter.x + toCenter.y * toCenter.y);
+        if (distance <= radius) {
+            return false;
+        }
+        
+        // Rotate the axis by the half angle the circle subtends
+        axis = toCenter / distance;
+        float sinHalf = radius / distance;
+        float cosHalf = std::sqrt(std::max(0.0f, 1.0f - sinHalf * sinHalf));
+        first = sf::Vector2f(axis.x * cosHalf - axis.y * sinHalf, axis.x * sinHalf + axis.y * cosHalf);
+        second = sf::Vector2f(axis.x * cosHalf + axis.y * sinHalf, -axis.x * sinHalf + axis.y * cosHalf);
+        return true;
+    }
 } 
\ No newline at end of file